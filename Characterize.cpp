@@ -0,0 +1,486 @@
+// Machine characterization: measures the ceilings the README used to derive
+// by hand (peak FLOPS, L1/L2/L3/DRAM bandwidth) and writes them to a machine
+// profile (gapbs/machine_profile.h) that Main.cpp and the BFS drivers read
+// to print percent-of-roofline.
+//
+//   compute    independent FMA chains, enough of them to cover FMA latency
+//   bandwidth  read / write / copy over a working set that doubles from
+//              16 KiB to past the last-level cache; each level's ceiling is
+//              the best point that fits comfortably in it (at most half its
+//              capacity, above the previous level), DRAM is the largest set
+//
+// Both are run on one core and on every allowed core, each thread pinned
+// with sched_setaffinity and working on its own first-touched buffer. Cache
+// sizes come from sysfs. Copy counts both the source and the destination
+// bytes; write does not count the read-for-ownership traffic.
+//
+// Usage: ./characterize [--out=FILE] [--threads=N] [--max-mb=MB] [--quick]
+
+#include <sched.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gapbs/machine_profile.h"
+
+typedef float Vec8f __attribute__((vector_size(32)));
+typedef float Vec4f __attribute__((vector_size(16)));
+
+constexpr int kAccumulators = 12;
+constexpr int kTrials = 5;
+
+static volatile float g_sink;
+
+struct CacheLevel
+{
+	size_t bytes;
+	int sharers;
+};
+
+static int CountCpuList(const std::string& list)
+{
+	int count = 0;
+	size_t pos = 0;
+	while (pos < list.size())
+	{
+		size_t comma = list.find(',', pos);
+		std::string range = list.substr(pos, comma == std::string::npos ? std::string::npos : comma - pos);
+		size_t dash = range.find('-');
+		if (dash == std::string::npos)
+			count += 1;
+		else
+			count += atoi(range.c_str() + dash + 1) - atoi(range.c_str()) + 1;
+		if (comma == std::string::npos)
+			break;
+		pos = comma + 1;
+	}
+	return count;
+}
+
+// Data/unified caches of cpu0 indexed by level (1..3); missing levels fall
+// back to typical sizes so the sweep still classifies something
+static std::vector<CacheLevel> ReadCacheLevels()
+{
+	std::vector<CacheLevel> levels = { { 0, 1 }, { 32 << 10, 1 }, { 1 << 20, 1 }, { 32 << 20, 64 } };
+	for (int index = 0; index < 8; ++index)
+	{
+		std::string dir = "/sys/devices/system/cpu/cpu0/cache/index" + std::to_string(index) + "/";
+		std::ifstream level_file(dir + "level"), type_file(dir + "type"), size_file(dir + "size"), shared_file(dir + "shared_cpu_list");
+		int level;
+		std::string type, size, shared;
+		if (!(level_file >> level) || !(type_file >> type) || !(size_file >> size))
+			continue;
+		if (type == "Instruction" || level < 1 || level > 3)
+			continue;
+		size_t bytes = strtoull(size.c_str(), nullptr, 10);
+		if (size.back() == 'K')
+			bytes <<= 10;
+		else if (size.back() == 'M')
+			bytes <<= 20;
+		levels[level].bytes = bytes;
+		levels[level].sharers = (shared_file >> shared) ? std::max(1, CountCpuList(shared)) : 1;
+	}
+	return levels;
+}
+
+static std::vector<int> AllowedCpus()
+{
+	cpu_set_t set;
+	std::vector<int> cpus;
+	if (sched_getaffinity(0, sizeof(set), &set) != 0)
+		return std::vector<int>(1, 0);
+	for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+		if (CPU_ISSET(cpu, &set))
+			cpus.push_back(cpu);
+	return cpus;
+}
+
+static void PinToCpu(int cpu)
+{
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	sched_setaffinity(0, sizeof(set), &set);
+}
+
+static double Now()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+class SpinBarrier
+{
+public:
+	explicit SpinBarrier(int count) : m_count(count), m_waiting(0), m_generation(0) {}
+
+	void Wait()
+	{
+		int generation = m_generation.load();
+		if (m_waiting.fetch_add(1) + 1 == m_count)
+		{
+			m_waiting.store(0);
+			m_generation.fetch_add(1);
+			return;
+		}
+		while (m_generation.load() == generation)
+			std::this_thread::yield();
+	}
+private:
+	int m_count;
+	std::atomic<int> m_waiting;
+	std::atomic<int> m_generation;
+};
+
+// Kernels, written once over the vector type and instantiated per ISA
+
+template<typename V>
+static inline __attribute__((always_inline)) double FmaLoop(int64_t iterations)
+{
+	constexpr int lanes = sizeof(V) / sizeof(float);
+	V acc[kAccumulators];
+	V mul = V{} + 0.9999f;
+	V add = V{} + 0.0001f;
+	for (int a = 0; a < kAccumulators; ++a)
+		acc[a] = V{} + float(a);
+	for (int64_t it = 0; it < iterations; ++it)
+	{
+#pragma GCC unroll 16
+		for (int a = 0; a < kAccumulators; ++a)
+			acc[a] = acc[a] * mul + add;
+	}
+	V total = V{};
+	for (int a = 0; a < kAccumulators; ++a)
+		total += acc[a];
+	g_sink = total[0];
+	return 2.0 * lanes * kAccumulators * iterations;
+}
+
+template<typename V>
+static inline __attribute__((always_inline)) void ReadLoop(const V* src, size_t n)
+{
+	V s0 = V{}, s1 = V{}, s2 = V{}, s3 = V{};
+	for (size_t i = 0; i + 4 <= n; i += 4)
+	{
+		s0 += src[i];
+		s1 += src[i + 1];
+		s2 += src[i + 2];
+		s3 += src[i + 3];
+	}
+	V total = s0 + s1 + s2 + s3;
+	g_sink = total[0];
+}
+
+template<typename V>
+static inline __attribute__((always_inline)) void WriteLoop(V* dst, size_t n)
+{
+	V value = V{} + 1.5f;
+	for (size_t i = 0; i < n; ++i)
+		dst[i] = value;
+}
+
+template<typename V>
+static inline __attribute__((always_inline)) void CopyLoop(V* dst, const V* src, size_t n)
+{
+	for (size_t i = 0; i < n; ++i)
+		dst[i] = src[i];
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+#define TARGET_AVX2 __attribute__((target("avx2,fma"), noinline))
+static bool UseAvx2()
+{
+	return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+}
+TARGET_AVX2 static double FmaAvx2(int64_t iterations) { return FmaLoop<Vec8f>(iterations); }
+TARGET_AVX2 static void ReadAvx2(const void* src, size_t bytes) { ReadLoop((const Vec8f*)src, bytes / sizeof(Vec8f)); }
+TARGET_AVX2 static void WriteAvx2(void* dst, size_t bytes) { WriteLoop((Vec8f*)dst, bytes / sizeof(Vec8f)); }
+TARGET_AVX2 static void CopyAvx2(void* dst, const void* src, size_t bytes) { CopyLoop((Vec8f*)dst, (const Vec8f*)src, bytes / sizeof(Vec8f)); }
+#else
+static bool UseAvx2() { return false; }
+static double FmaAvx2(int64_t) { return 0; }
+static void ReadAvx2(const void*, size_t) {}
+static void WriteAvx2(void*, size_t) {}
+static void CopyAvx2(void*, const void*, size_t) {}
+#endif
+
+__attribute__((noinline)) static double FmaGeneric(int64_t iterations) { return FmaLoop<Vec4f>(iterations); }
+__attribute__((noinline)) static void ReadGeneric(const void* src, size_t bytes) { ReadLoop((const Vec4f*)src, bytes / sizeof(Vec4f)); }
+__attribute__((noinline)) static void WriteGeneric(void* dst, size_t bytes) { WriteLoop((Vec4f*)dst, bytes / sizeof(Vec4f)); }
+__attribute__((noinline)) static void CopyGeneric(void* dst, const void* src, size_t bytes) { CopyLoop((Vec4f*)dst, (const Vec4f*)src, bytes / sizeof(Vec4f)); }
+
+static bool g_avx2 = false;
+
+static double RunFma(int64_t iterations)
+{
+	return g_avx2 ? FmaAvx2(iterations) : FmaGeneric(iterations);
+}
+
+// One pass of pattern p over a working set of `bytes` (copy: two halves)
+static void RunPass(MachineProfile::Pattern p, uint8_t* buffer, size_t bytes)
+{
+	if (p == MachineProfile::kRead)
+		g_avx2 ? ReadAvx2(buffer, bytes) : ReadGeneric(buffer, bytes);
+	else if (p == MachineProfile::kWrite)
+		g_avx2 ? WriteAvx2(buffer, bytes) : WriteGeneric(buffer, bytes);
+	else
+		g_avx2 ? CopyAvx2(buffer, buffer + bytes / 2, bytes / 2) : CopyGeneric(buffer, buffer + bytes / 2, bytes / 2);
+}
+
+// Runs body(thread, trial) on every cpu, trials in lockstep; returns the
+// best (shortest) per-trial wall time, the slowest thread setting each trial
+template<typename Body>
+static double RunPinned(const std::vector<int>& cpus, Body body)
+{
+	int threads = int(cpus.size());
+	SpinBarrier barrier(threads);
+	std::vector<double> start(threads * kTrials), end(threads * kTrials);
+	std::vector<std::thread> workers;
+	for (int t = 0; t < threads; ++t)
+	{
+		workers.emplace_back([&, t]()
+		{
+			PinToCpu(cpus[t]);
+			body(t, -1);
+			for (int trial = 0; trial < kTrials; ++trial)
+			{
+				barrier.Wait();
+				start[t * kTrials + trial] = Now();
+				body(t, trial);
+				end[t * kTrials + trial] = Now();
+			}
+		});
+	}
+	for (std::thread& w : workers)
+		w.join();
+	double best = 0;
+	for (int trial = 0; trial < kTrials; ++trial)
+	{
+		double first = start[trial], last = end[trial];
+		for (int t = 1; t < threads; ++t)
+		{
+			first = std::min(first, start[t * kTrials + trial]);
+			last = std::max(last, end[t * kTrials + trial]);
+		}
+		if (trial == 0 || last - first < best)
+			best = last - first;
+	}
+	return best;
+}
+
+static double MeasureGflops(const std::vector<int>& cpus, int64_t iterations)
+{
+	std::vector<double> flops(cpus.size());
+	double seconds = RunPinned(cpus, [&](int t, int trial)
+	{
+		flops[t] = RunFma(trial < 0 ? iterations / 10 : iterations);
+	});
+	double total = 0;
+	for (double f : flops)
+		total += f;
+	return total / seconds / 1e9;
+}
+
+struct SweepPoint
+{
+	size_t bytes;
+	double gbs[MachineProfile::kNumPatterns];
+};
+
+// Bandwidth for every pattern at per-thread working sets min_bytes..max_bytes
+static std::vector<SweepPoint> Sweep(const std::vector<int>& cpus, size_t min_bytes, size_t max_bytes, double target_bytes)
+{
+	int threads = int(cpus.size());
+	std::vector<SweepPoint> points;
+	std::vector<uint8_t*> buffers(threads, nullptr);
+	for (size_t bytes = min_bytes; bytes <= max_bytes; bytes *= 2)
+	{
+		SweepPoint point;
+		point.bytes = bytes;
+		int64_t passes = std::max<int64_t>(1, int64_t(target_bytes / bytes));
+		for (int p = 0; p < MachineProfile::kNumPatterns; ++p)
+		{
+			MachineProfile::Pattern pattern = MachineProfile::Pattern(p);
+			double seconds = RunPinned(cpus, [&](int t, int trial)
+			{
+				if (trial < 0)
+				{
+					// Allocate and first-touch on the pinned cpu
+					if (buffers[t] == nullptr)
+					{
+						void* mem = nullptr;
+						if (posix_memalign(&mem, 4096, bytes) != 0)
+							abort();
+						buffers[t] = static_cast<uint8_t*>(mem);
+						memset(buffers[t], 1, bytes);
+					}
+					RunPass(pattern, buffers[t], bytes);
+					return;
+				}
+				for (int64_t pass = 0; pass < passes; ++pass)
+					RunPass(pattern, buffers[t], bytes);
+			});
+			point.gbs[p] = double(threads) * passes * bytes / seconds / 1e9;
+		}
+		for (uint8_t*& b : buffers)
+		{
+			free(b);
+			b = nullptr;
+		}
+		points.push_back(point);
+	}
+	return points;
+}
+
+static std::string FormatBytes(size_t bytes)
+{
+	if (bytes >= (size_t(1) << 30))
+		return std::to_string(bytes >> 30) + " GiB";
+	if (bytes >= (size_t(1) << 20))
+		return std::to_string(bytes >> 20) + " MiB";
+	return std::to_string(bytes >> 10) + " KiB";
+}
+
+static void PrintSweep(const std::vector<SweepPoint>& points)
+{
+	std::cout << std::setw(12) << "Working set" << std::setw(12) << "read GB/s" << std::setw(12) << "write GB/s" << std::setw(12) << "copy GB/s" << std::endl;
+	for (const SweepPoint& point : points)
+	{
+		std::cout << std::setw(12) << FormatBytes(point.bytes) << std::fixed << std::setprecision(2);
+		for (int p = 0; p < MachineProfile::kNumPatterns; ++p)
+			std::cout << std::setw(12) << point.gbs[p];
+		std::cout << std::endl;
+	}
+}
+
+// Per-level ceilings from a sweep. capacity[l] is the per-thread share of
+// cache level l; a level takes the best point in (capacity[l-1], capacity[l]/2],
+// or the largest point at or below capacity[l]/2 if that window is empty
+static void Classify(const std::vector<SweepPoint>& points, const size_t capacity[3], MachineProfile& profile, MachineProfile::Scope scope)
+{
+	for (int p = 0; p < MachineProfile::kNumPatterns; ++p)
+	{
+		MachineProfile::Pattern pattern = MachineProfile::Pattern(p);
+		for (int l = 0; l < 3; ++l)
+		{
+			size_t low = l == 0 ? 0 : capacity[l - 1];
+			size_t high = capacity[l] / 2;
+			double best = 0, fallback = 0;
+			for (const SweepPoint& point : points)
+			{
+				if (point.bytes > high)
+					continue;
+				fallback = point.gbs[p];
+				if (point.bytes > low)
+					best = std::max(best, point.gbs[p]);
+			}
+			profile.set_bandwidth_gbs(pattern, MachineProfile::Level(l), scope, best > 0 ? best : fallback);
+		}
+		profile.set_bandwidth_gbs(pattern, MachineProfile::kDRAM, scope, points.back().gbs[p]);
+	}
+}
+
+static void PrintSummary(const MachineProfile& profile, MachineProfile::Scope scope)
+{
+	double peak = profile.peak_gflops(scope);
+	std::cout << "Peak GFLOPS (FMA): " << std::fixed << std::setprecision(2) << peak << std::endl;
+	std::cout << std::setw(8) << "Level" << std::setw(12) << "read GB/s" << std::setw(12) << "write GB/s" << std::setw(12) << "copy GB/s" << std::setw(14) << "ridge flop/B" << std::endl;
+	for (int l = 0; l < MachineProfile::kNumLevels; ++l)
+	{
+		MachineProfile::Level level = MachineProfile::Level(l);
+		std::cout << std::setw(8) << MachineProfile::LevelName(l);
+		for (int p = 0; p < MachineProfile::kNumPatterns; ++p)
+			std::cout << std::setw(12) << profile.bandwidth_gbs(MachineProfile::Pattern(p), level, scope);
+		double read = profile.bandwidth_gbs(MachineProfile::kRead, level, scope);
+		std::cout << std::setw(14) << (read > 0 ? peak / read : 0.0) << std::endl;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::string out = MachineProfile::DefaultPath();
+	int threads = 0;
+	size_t max_mb = 1024;
+	bool quick = false;
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string a = argv[i];
+		if (a.compare(0, 6, "--out=") == 0)
+			out = a.substr(6);
+		else if (a.compare(0, 10, "--threads=") == 0)
+			threads = atoi(a.c_str() + 10);
+		else if (a.compare(0, 9, "--max-mb=") == 0)
+			max_mb = strtoull(a.c_str() + 9, nullptr, 10);
+		else if (a == "--quick")
+			quick = true;
+		else
+		{
+			std::cerr << "Usage: " << argv[0] << " [--out=FILE] [--threads=N] [--max-mb=MB] [--quick]" << std::endl;
+			return 1;
+		}
+	}
+	if (max_mb == 0)
+	{
+		std::cerr << "--max-mb must be at least 1" << std::endl;
+		return 1;
+	}
+
+	g_avx2 = UseAvx2();
+	std::vector<int> all_cpus = AllowedCpus();
+	if (threads > 0 && threads < int(all_cpus.size()))
+		all_cpus.resize(threads);
+	std::vector<CacheLevel> caches = ReadCacheLevels();
+	std::cout << "Kernels: " << (g_avx2 ? "avx2+fma (256-bit)" : "generic (128-bit)") << std::endl;
+	std::cout << "Cpus: " << all_cpus.size() << std::endl;
+	for (int l = 1; l <= 3; ++l)
+		std::cout << "L" << l << ": " << FormatBytes(caches[l].bytes) << " shared by " << caches[l].sharers << std::endl;
+
+	MachineProfile profile;
+	profile.set_threads(int(all_cpus.size()));
+	const int64_t fma_iterations = quick ? 2000000 : 20000000;
+	const double target_bytes = quick ? double(64 << 20) : double(512 << 20);
+	size_t dram_bytes = std::max(caches[3].bytes * 4, size_t(64) << 20);
+
+	for (int s = 0; s < MachineProfile::kNumScopes; ++s)
+	{
+		MachineProfile::Scope scope = MachineProfile::Scope(s);
+		std::vector<int> cpus = scope == MachineProfile::kOneCore ? std::vector<int>(1, all_cpus[0]) : all_cpus;
+		int n = int(cpus.size());
+		std::cout << std::endl << "== " << (scope == MachineProfile::kOneCore ? "1 core" : "all cores") << " (" << n << " threads) ==" << std::endl;
+
+		profile.set_peak_gflops(scope, MeasureGflops(cpus, fma_iterations));
+
+		// Per-thread share of each cache when n threads spread over its sharers
+		size_t capacity[3];
+		for (int l = 0; l < 3; ++l)
+			capacity[l] = caches[l + 1].bytes / std::max(1, std::min(n, caches[l + 1].sharers));
+		// At least one point even when --max-mb split over n threads is tiny
+		const size_t min_bytes = 16 << 10;
+		size_t max_bytes = std::min(std::max(dram_bytes / n, capacity[2] * 4), (max_mb << 20) / n);
+		max_bytes = std::max(max_bytes, min_bytes);
+		std::vector<SweepPoint> points = Sweep(cpus, min_bytes, max_bytes, target_bytes);
+		PrintSweep(points);
+		Classify(points, capacity, profile, scope);
+		if (points.back().bytes < capacity[2] * 4)
+			std::cout << "Note: largest working set is under 4x L3, DRAM numbers may include cache hits (raise --max-mb)" << std::endl;
+		std::cout << std::endl;
+		PrintSummary(profile, scope);
+	}
+
+	if (!profile.Save(out))
+	{
+		std::cerr << "Could not write " << out << std::endl;
+		return 1;
+	}
+	std::cout << std::endl << "Profile written to " << out << std::endl;
+	return 0;
+}
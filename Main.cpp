@@ -1,12 +1,108 @@
 #include <iostream>
+#include <string>
 
 #include "utils.h"
 #include "matmul.h"
+#include "gapbs/bench_runner.h"
+#include "gapbs/cache_sim.h"
+#include "gapbs/machine_profile.h"
 
-int main()
+// Replays every element access of a matmul loop into a cache model
+struct CacheTrace
 {
-	constexpr int N = 4096;
+	CacheHierarchy* sim;
+	void Read(const float* p) { sim->Access(p, sizeof(float), false); }
+	void Write(const float* p) { sim->Access(p, sizeof(float), true); }
+};
 
+// Runs ijk and stride_kij once each on n x n inputs through the cache model
+// and prints what the hierarchy moves. No timing: the model runs ~100x slower
+void RunCacheModel(const CacheSimConfig& config, int n)
+{
+	float** A;
+	float** B;
+	float** C;
+	InitArray2D(A, n);
+	InitArray2D(B, n);
+	InitArray2D(C, n);
+	RandomArrayGenerator2D(B, n);
+	RandomArrayGenerator2D(C, n);
+
+	std::cout << "Cache model: " << config.Describe() << ", n = " << n << std::endl;
+	const double flops = 2.0 * n * n * n;
+	for (int variant = 0; variant < 2; ++variant)
+	{
+		LOOP2D(i, j, n)
+			A[i][j] = 0.0f;
+		CacheHierarchy sim(config);
+		if (variant == 0)
+			matmul_ijk(A, B, C, n, CacheTrace{ &sim });
+		else
+			matmul_stride_kij(A, B, C, n, 4, CacheTrace{ &sim });
+		std::cout << (variant == 0 ? "ijk" : "stride_kij") << std::endl;
+		sim.stats().Print(std::cout);
+		double bytes = sim.stats().dram_bytes();
+		std::cout << "  flops per DRAM byte: " << (bytes > 0 ? flops / bytes : 0.0) << std::endl;
+	}
+
+	delete[] A;
+	delete[] B;
+	delete[] C;
+}
+
+int main(int argc, char** argv)
+{
+	int N = 4096;
+	bool cache_sim = false;
+	bool regions = false;
+	std::string regions_file;
+	int sim_n = 256;
+	CacheSimConfig cache_config;
+
+	// One warmup and three samples by default: a 4096 ijk run takes minutes
+	RunnerOptions runner;
+	runner.warmup = 1;
+	runner.min_reps = 3;
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string a = argv[i];
+		if (a.compare(0, 4, "--n=") == 0)
+			N = atoi(a.c_str() + 4);
+		else if (a == "--cache-sim" || a.compare(0, 12, "--cache-sim=") == 0)
+		{
+			cache_sim = true;
+			if (!CacheSimConfig::Parse(a.size() > 12 ? a.substr(12) : "host", cache_config))
+			{
+				std::cerr << "Bad cache spec " << a << ", expected host or SIZE/WAYS,... (e.g. 48K/12,2M/16)" << std::endl;
+				return 1;
+			}
+		}
+		else if (a.compare(0, 8, "--sim-n=") == 0)
+			sim_n = atoi(a.c_str() + 8);
+		else if (a == "--regions")
+			regions = true;
+		else if (a.compare(0, 10, "--regions=") == 0)
+		{
+			regions = true;
+			regions_file = a.substr(10);
+		}
+		else if (!ParseRunnerArg(a, runner))
+		{
+			std::cerr << "Usage: " << argv[0] << " [--n=N] [--cache-sim[=host|SIZE/WAYS,...]] [--sim-n=N] [--regions[=TRACE.json]] (runner defaults here: --warmup=1 --min-reps=3)" << std::endl << RunnerUsage();
+			return 1;
+		}
+	}
+	if (cache_sim)
+	{
+		RunCacheModel(cache_config, sim_n);
+		return 0;
+	}
+	ScopedSchedule schedule(runner);
+	// Enabling calibrates the TSC, which must not land in a timed call
+	if (regions)
+		RegionTracer::SetEnabled(true);
+
+	TraceRegion init_region("init");
 	float** A;
 	float** B;
 	float** C;
@@ -32,17 +128,42 @@ int main()
 
 	LOOP2D(i, j, N)
 		C_new[i][j] = 0.0f;
+	init_region.End();
+
+	// Percent of peak needs a profile from ./characterize
+	MachineProfile profile;
+	if (!profile.Load(MachineProfile::DefaultPath()))
+		std::cout << "No machine profile at " << MachineProfile::DefaultPath() << ", run characterize for percent of peak" << std::endl;
+	const double flops = 2.0 * N * N * N;
+
+	BenchResult ijk = RunBenchmark("ijk", runner, [&]() { TraceRegion r("ijk"); matmul_ijk(A, B, C, N); });
+	// stride_kij accumulates into its first argument, so clear it before every call
+	BenchResult kij = RunBenchmark("stride_kij", runner,
+		[&]() { TraceRegion r("stride_kij"); matmul_stride_kij(A_new, B_new, C_new, N, 4); },
+		[&]() { LOOP2D(i, j, N) A_new[i][j] = 0.0f; });
 
+	std::vector<BenchResult> results = { ijk, kij };
+	for (BenchResult& r : results)
 	{
-		Timer timer;
-		matmul_ijk(A, B, C, N);
+		r.AddParam("n", std::to_string(N));
+		PrintBenchResult(std::cout, r);
+		PrintComputeRoofline(std::cout, profile, flops, r.median_ns * 1e-9, 1);
 	}
+	if (!runner.json_path.empty() && !WriteBenchJson(runner.json_path, runner, results))
+		std::cerr << "Could not write " << runner.json_path << std::endl;
+
 	{
-		Timer timer;
-		matmul_stride_kij(A_new, B_new, C_new, N, 4);
+		TraceRegion r("check");
+		std::cout << CheckEqual2D(C, C_new, N) << std::endl;
 	}
 
-	std::cout << CheckEqual2D(C, C_new, N) << std::endl;
+	// Every call, warmups included; per-sample statistics are in the runner output
+	if (regions)
+	{
+		RegionTracer::PrintSummary(std::cout);
+		if (!regions_file.empty() && !RegionTracer::WriteChromeTrace(regions_file))
+			std::cerr << "Could not write " << regions_file << std::endl;
+	}
 
 	delete[] A;
 	delete[] B;
@@ -0,0 +1,330 @@
+#include <iostream>
+#include <vector>
+#include <iomanip>
+#include <algorithm>
+#include <cinttypes>
+#include <cmath>
+#include <string>
+#include <utility>
+
+#include "benchmark.h"
+#include "builder.h"
+#include "command_line.h"
+#include "graph.h"
+#include "graph_snapshot.h"
+#include "platform_atomics.h"
+#include "pvector.h"
+#include "sliding_queue.h"
+#include "timer.h"
+#include "word_bitmap.h"
+
+/*
+Brandes betweenness centrality over k sampled sources
+
+Each source runs two phases:
+  forward   level-synchronous parallel BFS. A vertex's depth is claimed
+            with CAS; its shortest-path count is the sum of the counts of
+            its parents, added atomically. Every edge (u, v) with
+            depth[v] == depth[u] + 1 sets bit (u's edge index) in a
+            successor bitmap, one bit per directed edge
+  backward  levels in reverse: delta[u] = sum over successors v of
+            paths[u] / paths[v] * (1 + delta[v]), then score[u] += delta[u].
+            Each level is a parallel loop; successors are read from the
+            bitmap, so no edge is compared on depth twice
+
+The BFS queue doubles as the level order: it is never reset within a
+source, and depth_index records where each level starts, so the backward
+phase walks it from the back.
+
+-i K sets the number of sources (default 1). They come from SourcePicker,
+so -r picks a fixed start and the verifier sees the same sequence. All
+per-source state (depth, paths, delta, successor bitmap, queue) lives in
+one BCWorkspace allocated once per run and cleared in parallel between
+sources, so a trial's only allocations are the scores it returns. Scores
+are normalized by the largest one, as in the reference bc.
+
+Traversed edges counts forward edges examined plus backward successor
+bits tested, per trial.
+
+Extra flags (stripped before CLApp sees them):
+  --snapshot=F, --snapshot-prefault=none|populate|background
+*/
+
+using namespace std;
+
+typedef float ScoreT;
+typedef double CountT;
+
+// Graph snapshot (graph_snapshot.h): mmap if present, else build and save
+static string g_snapshot = "";
+static SnapshotPrefault g_prefault = kPrefaultNone;
+
+static void StripCustomArgs(int& argc, char** argv) {
+  int out = 1;
+  for (int i = 1; i < argc; ++i) {
+    string a = argv[i];
+    if (a.compare(0, 11, "--snapshot=") == 0) g_snapshot = a.substr(11);
+    else if (a.compare(0, 20, "--snapshot-prefault=") == 0) {
+      if (!ParseSnapshotPrefault(a.substr(20), g_prefault))
+        cout << "Unknown prefault mode " << a.substr(20) << endl;
+    }
+    else argv[out++] = argv[i];
+  }
+  argc = out;
+}
+
+// Totals for the report, summed over trials
+struct BCStats {
+  int64_t sources = 0;
+  int64_t forward_edges = 0;
+  int64_t backward_edges = 0;
+  double forward_sec = 0;
+  double backward_sec = 0;
+};
+
+static BCStats g_bc;
+
+// Per-source buffers, reused for every source of every trial
+class BCWorkspace {
+ public:
+  explicit BCWorkspace(const Graph &g)
+      : g_(g), depths(g.num_nodes()), path_counts(g.num_nodes()),
+        deltas(g.num_nodes()), succ(g.num_edges_directed()),
+        queue(g.num_nodes()) {
+    depth_index.reserve(64);
+  }
+
+  void Reset() {
+    #pragma omp parallel for
+    for (NodeID n = 0; n < g_.num_nodes(); n++) {
+      depths[n] = -1;
+      path_counts[n] = 0;
+      deltas[n] = 0;
+    }
+    succ.reset();
+    queue.reset();
+    depth_index.clear();
+  }
+
+  const Graph &g_;
+  pvector<NodeID> depths;
+  pvector<CountT> path_counts;
+  pvector<ScoreT> deltas;
+  WordBitmap succ;
+  SlidingQueue<NodeID> queue;
+  vector<SlidingQueue<NodeID>::iterator> depth_index;
+};
+
+// Returns edges examined
+int64_t PBFS(const Graph &g, NodeID source, BCWorkspace &ws) {
+  pvector<NodeID> &depths = ws.depths;
+  pvector<CountT> &path_counts = ws.path_counts;
+  SlidingQueue<NodeID> &queue = ws.queue;
+  const NodeID* g_out_start = g.out_neigh(0).begin();
+  depths[source] = 0;
+  path_counts[source] = 1;
+  queue.push_back(source);
+  ws.depth_index.push_back(queue.begin());
+  queue.slide_window();
+  int64_t edges = 0;
+  #pragma omp parallel reduction(+ : edges)
+  {
+    NodeID depth = 0;
+    QueueBuffer<NodeID> lqueue(queue);
+    while (!queue.empty()) {
+      depth++;
+      #pragma omp for schedule(dynamic, 64) nowait
+      for (auto q_iter = queue.begin(); q_iter < queue.end(); q_iter++) {
+        NodeID u = *q_iter;
+        edges += g.out_degree(u);
+        for (const NodeID &v : g.out_neigh(u)) {
+          if ((depths[v] == -1) &&
+              (compare_and_swap(depths[v], static_cast<NodeID>(-1), depth))) {
+            lqueue.push_back(v);
+          }
+          if (depths[v] == depth) {
+            ws.succ.set_bit_atomic(&v - g_out_start);
+            #pragma omp atomic
+            path_counts[v] += path_counts[u];
+          }
+        }
+      }
+      lqueue.flush();
+      #pragma omp barrier
+      #pragma omp single
+      {
+        ws.depth_index.push_back(queue.begin());
+        queue.slide_window();
+      }
+    }
+  }
+  ws.depth_index.push_back(queue.begin());
+  return edges;
+}
+
+// Returns successor bits tested
+int64_t Accumulate(const Graph &g, BCWorkspace &ws, pvector<ScoreT> &scores) {
+  const NodeID* g_out_start = g.out_neigh(0).begin();
+  const pvector<CountT> &path_counts = ws.path_counts;
+  pvector<ScoreT> &deltas = ws.deltas;
+  int64_t edges = 0;
+  for (int d = ws.depth_index.size() - 2; d >= 0; d--) {
+    auto level_begin = ws.depth_index[d];
+    auto level_end = ws.depth_index[d + 1];
+    #pragma omp parallel for reduction(+ : edges) schedule(dynamic, 64)
+    for (auto it = level_begin; it < level_end; it++) {
+      NodeID u = *it;
+      ScoreT delta_u = 0;
+      edges += g.out_degree(u);
+      for (const NodeID &v : g.out_neigh(u)) {
+        if (ws.succ.get_bit(&v - g_out_start))
+          delta_u += static_cast<ScoreT>(path_counts[u] / path_counts[v]) *
+                     (1 + deltas[v]);
+      }
+      deltas[u] = delta_u;
+      scores[u] += delta_u;
+    }
+  }
+  return edges;
+}
+
+void Normalize(pvector<ScoreT> &scores) {
+  ScoreT biggest_score = 0;
+  #pragma omp parallel for reduction(max : biggest_score)
+  for (size_t n = 0; n < scores.size(); n++)
+    biggest_score = max(biggest_score, scores[n]);
+  if (biggest_score == 0)
+    return;
+  #pragma omp parallel for
+  for (size_t n = 0; n < scores.size(); n++)
+    scores[n] = scores[n] / biggest_score;
+}
+
+pvector<ScoreT> Brandes(const Graph &g, SourcePicker<Graph> &sp,
+                        NodeID num_iters, BCWorkspace &ws,
+                        bool logging_enabled = false) {
+  Timer t;
+  pvector<ScoreT> scores(g.num_nodes(), 0);
+  for (NodeID iter = 0; iter < num_iters; iter++) {
+    NodeID source = sp.PickNext();
+    if (logging_enabled)
+      PrintStep("Source", static_cast<int64_t>(source));
+    ws.Reset();
+    t.Start();
+    int64_t forward = PBFS(g, source, ws);
+    t.Stop();
+    g_bc.forward_sec += t.Seconds();
+    g_bc.forward_edges += forward;
+    if (logging_enabled)
+      PrintStep("f", t.Seconds(), forward);
+    t.Start();
+    int64_t backward = Accumulate(g, ws, scores);
+    t.Stop();
+    g_bc.backward_sec += t.Seconds();
+    g_bc.backward_edges += backward;
+    if (logging_enabled)
+      PrintStep("b", t.Seconds(), backward);
+    g_bc.sources++;
+  }
+  Normalize(scores);
+  return scores;
+}
+
+void PrintTopScores(const Graph &g, const pvector<ScoreT> &scores) {
+  vector<pair<NodeID, ScoreT>> score_pairs(g.num_nodes());
+  for (NodeID n : g.vertices())
+    score_pairs[n] = make_pair(n, scores[n]);
+  int k = min<int64_t>(5, g.num_nodes());
+  partial_sort(score_pairs.begin(), score_pairs.begin() + k,
+               score_pairs.end(),
+               [](const pair<NodeID, ScoreT> &a,
+                  const pair<NodeID, ScoreT> &b) {
+                 return a.second > b.second;
+               });
+  for (int i = 0; i < k; i++)
+    cout << score_pairs[i].first << ": " << score_pairs[i].second << endl;
+}
+
+// Serial Brandes from the same sources; scores must match to 1e-4
+bool BCVerifier(const Graph &g, SourcePicker<Graph> &sp, NodeID num_iters,
+                const pvector<ScoreT> &scores_to_test) {
+  pvector<ScoreT> scores(g.num_nodes(), 0);
+  for (int iter = 0; iter < num_iters; iter++) {
+    NodeID source = sp.PickNext();
+    pvector<int> depths(g.num_nodes(), -1);
+    depths[source] = 0;
+    vector<CountT> path_counts(g.num_nodes(), 0);
+    path_counts[source] = 1;
+    vector<NodeID> to_visit;
+    to_visit.reserve(g.num_nodes());
+    to_visit.push_back(source);
+    for (auto it = to_visit.begin(); it != to_visit.end(); it++) {
+      NodeID u = *it;
+      for (NodeID v : g.out_neigh(u)) {
+        if (depths[v] == -1) {
+          depths[v] = depths[u] + 1;
+          to_visit.push_back(v);
+        }
+        if (depths[v] == depths[u] + 1)
+          path_counts[v] += path_counts[u];
+      }
+    }
+    vector<ScoreT> deltas(g.num_nodes(), 0);
+    for (auto it = to_visit.rbegin(); it != to_visit.rend(); it++) {
+      NodeID u = *it;
+      for (NodeID v : g.out_neigh(u)) {
+        if (depths[v] == depths[u] + 1)
+          deltas[u] += static_cast<ScoreT>(path_counts[u] / path_counts[v]) *
+                       (1 + deltas[v]);
+      }
+      scores[u] += deltas[u];
+    }
+  }
+  Normalize(scores);
+  bool all_ok = true;
+  for (NodeID n : g.vertices()) {
+    if (fabs(scores[n] - scores_to_test[n]) > 1e-4) {
+      cout << n << ": " << scores[n] << " != " << scores_to_test[n] << endl;
+      all_ok = false;
+    }
+  }
+  return all_ok;
+}
+
+int main(int argc, char* argv[]) {
+  StripCustomArgs(argc, argv);
+  CLIterApp cli(argc, argv, "betweenness-centrality", 1);
+  if (!cli.ParseArgs()) return -1;
+  if (cli.num_iters() > 1 && cli.start_vertex() != -1)
+    cout << "Warning: iterating from same source (-r & -i)" << endl;
+
+  GraphProvider provider;
+  const Graph &g = provider.Get(cli, g_snapshot, g_prefault);
+  BCWorkspace ws(g);
+  SourcePicker<Graph> sp(g, cli.start_vertex());
+  auto BCBound = [&sp, &cli, &ws] (const Graph &g) {
+    return Brandes(g, sp, cli.num_iters(), ws, cli.logging_en());
+  };
+  SourcePicker<Graph> vsp(g, cli.start_vertex());
+  auto VerifierBound = [&vsp, &cli] (const Graph &g,
+                                     const pvector<ScoreT> &scores) {
+    return BCVerifier(g, vsp, cli.num_iters(), scores);
+  };
+  BenchmarkKernel(cli, g, BCBound, PrintTopScores, VerifierBound);
+
+  const int trials = cli.num_trials();
+  const int64_t edges = g_bc.forward_edges + g_bc.backward_edges;
+  const double seconds = g_bc.forward_sec + g_bc.backward_sec;
+  cout << "Sources: " << g_bc.sources / trials << endl;
+  cout << "Traversed edges: " << edges / trials << " (forward "
+       << g_bc.forward_edges / trials << ", backward "
+       << g_bc.backward_edges / trials << ")" << endl;
+  cout << "BC Time (s): " << fixed << setprecision(6) << seconds / trials
+       << " (forward " << g_bc.forward_sec / trials << ", backward "
+       << g_bc.backward_sec / trials << ")" << endl;
+  cout << "Time per source (s): "
+       << seconds / max<int64_t>(g_bc.sources, 1) << endl;
+  cout << "TEPS: " << setprecision(3)
+       << (seconds > 0 ? edges / seconds : 0.0) << endl;
+  return 0;
+}
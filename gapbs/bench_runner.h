@@ -0,0 +1,342 @@
+#ifndef BENCH_RUNNER_H_
+#define BENCH_RUNNER_H_
+
+#include <errno.h>
+#include <sched.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+/*
+Statistical benchmark runner
+
+Replaces "sudo nice -n -20 taskset -c 7" plus one wall-clock sample per
+run. The process pins and prioritizes itself, and each benchmark is
+repeated until its timing is stable:
+
+  pinning   --pin=LIST sets the affinity of the calling thread (a cpu list
+            like "7" or "0-3,8"). Threads created afterwards, including the
+            OpenMP pool, inherit it, so set it before the first parallel
+            region, as taskset would
+  priority  --fifo=PRIO switches to SCHED_FIFO at that priority. It needs
+            CAP_SYS_NICE; without it a warning is printed and the run goes
+            on at normal priority. A busy FIFO thread on a single pinned
+            cpu starves everything else on that cpu, so keep runs short
+  warmup    --warmup=N untimed calls first (caches, page faults, turbo)
+  repeats   at least --min-reps=N timed calls, then stop once the 95%
+            confidence interval of the mean is within --ci=F of the mean
+            (default 2%), or at --max-reps=N, or after --max-time=S seconds
+
+Each benchmark reports median, p5/p95, mean, coefficient of variation and
+the CI half-width, all in nanoseconds from steady_clock. --json=FILE writes
+every benchmark of the run, with its raw samples, as one JSON document:
+
+  {"pin": "7", "fifo_priority": 0,
+   "benchmarks": [{"name": "ijk", "params": {...}, "reps": 12, ...,
+                   "median_ns": ..., "samples_ns": [...]}, ...]}
+
+which the notebooks load with json.load() and pandas.json_normalize.
+Header-only and independent of the rest of gapbs, so the top-level matmul
+driver (Main.cpp) uses it as well.
+*/
+
+struct RunnerOptions {
+  std::string pin;           // cpu list, empty leaves affinity alone
+  int fifo_priority = 0;     // 0 keeps the normal policy
+  int warmup = 2;
+  int min_reps = 5;
+  int max_reps = 200;
+  double ci = 0.02;          // target CI half-width relative to the mean
+  double max_seconds = 60;
+  std::string json_path;
+  bool enabled = false;      // any runner flag given
+};
+
+// Returns true if a was a runner flag (and applies it)
+inline bool ParseRunnerArg(const std::string &a, RunnerOptions &opts) {
+  if (a.compare(0, 6, "--pin=") == 0)
+    opts.pin = a.substr(6);
+  else if (a.compare(0, 7, "--fifo=") == 0)
+    opts.fifo_priority = atoi(a.c_str() + 7);
+  else if (a.compare(0, 9, "--warmup=") == 0)
+    opts.warmup = std::max(0, atoi(a.c_str() + 9));
+  else if (a.compare(0, 11, "--min-reps=") == 0)
+    opts.min_reps = std::max(2, atoi(a.c_str() + 11));
+  else if (a.compare(0, 11, "--max-reps=") == 0)
+    opts.max_reps = std::max(2, atoi(a.c_str() + 11));
+  else if (a.compare(0, 5, "--ci=") == 0)
+    opts.ci = atof(a.c_str() + 5);
+  else if (a.compare(0, 11, "--max-time=") == 0)
+    opts.max_seconds = atof(a.c_str() + 11);
+  else if (a.compare(0, 7, "--json=") == 0)
+    opts.json_path = a.substr(7);
+  else
+    return false;
+  opts.enabled = true;
+  return true;
+}
+
+inline const char* RunnerUsage() {
+  return "  --pin=LIST       pin to cpus (e.g. 7 or 0-3)\n"
+         "  --fifo=PRIO      SCHED_FIFO at PRIO (needs CAP_SYS_NICE)\n"
+         "  --warmup=N       untimed calls before sampling [2]\n"
+         "  --min-reps=N     timed calls at least [5]\n"
+         "  --max-reps=N     timed calls at most [200]\n"
+         "  --ci=F           stop when 95% CI is within F of the mean [0.02]\n"
+         "  --max-time=S     stop sampling after S seconds [60]\n"
+         "  --json=FILE      write results as JSON\n";
+}
+
+// Applies pinning and scheduling policy for its lifetime
+class ScopedSchedule {
+ public:
+  explicit ScopedSchedule(const RunnerOptions &opts)
+      : pinned_(false), fifo_(false) {
+    if (!opts.pin.empty()) {
+      cpu_set_t set;
+      if (!ParseList(opts.pin, set)) {
+        std::cerr << "Bad cpu list " << opts.pin << std::endl;
+      } else if (sched_getaffinity(0, sizeof(old_set_), &old_set_) != 0 ||
+                 sched_setaffinity(0, sizeof(set), &set) != 0) {
+        std::cerr << "Could not pin to " << opts.pin << ": "
+                  << strerror(errno) << std::endl;
+      } else {
+        pinned_ = true;
+      }
+    }
+    if (opts.fifo_priority > 0) {
+      old_policy_ = sched_getscheduler(0);
+      sched_getparam(0, &old_param_);
+      sched_param param;
+      memset(&param, 0, sizeof(param));
+      param.sched_priority = opts.fifo_priority;
+      if (sched_setscheduler(0, SCHED_FIFO, &param) != 0) {
+        std::cerr << "Could not set SCHED_FIFO " << opts.fifo_priority << ": "
+                  << strerror(errno) << " (running at normal priority)"
+                  << std::endl;
+      } else {
+        fifo_ = true;
+      }
+    }
+  }
+
+  ~ScopedSchedule() {
+    if (fifo_)
+      sched_setscheduler(0, old_policy_, &old_param_);
+    if (pinned_)
+      sched_setaffinity(0, sizeof(old_set_), &old_set_);
+  }
+
+  ScopedSchedule(const ScopedSchedule &) = delete;
+  ScopedSchedule &operator=(const ScopedSchedule &) = delete;
+
+  bool pinned() const { return pinned_; }
+  bool fifo() const { return fifo_; }
+
+ private:
+  static bool ParseList(const std::string &list, cpu_set_t &set) {
+    CPU_ZERO(&set);
+    const char *p = list.c_str();
+    while (*p != '\0') {
+      char *end;
+      long lo = strtol(p, &end, 10);
+      if (end == p)
+        return false;
+      long hi = lo;
+      if (*end == '-') {
+        p = end + 1;
+        hi = strtol(p, &end, 10);
+        if (end == p)
+          return false;
+      }
+      for (long c = lo; c <= hi && c < CPU_SETSIZE; c++)
+        CPU_SET(c, &set);
+      p = *end == ',' ? end + 1 : end;
+      if (*end != ',' && *end != '\0')
+        return false;
+    }
+    return CPU_COUNT(&set) > 0;
+  }
+
+  bool pinned_, fifo_;
+  cpu_set_t old_set_;
+  int old_policy_ = SCHED_OTHER;
+  sched_param old_param_;
+};
+
+struct BenchResult {
+  std::string name;
+  std::vector<std::pair<std::string, std::string>> params;
+  int warmup = 0;
+  std::vector<double> samples_ns;
+  double median_ns = 0, p5_ns = 0, p95_ns = 0;
+  double mean_ns = 0, stddev_ns = 0, cv = 0, ci95_ns = 0;
+  bool converged = false;
+
+  void AddParam(const std::string &key, const std::string &value) {
+    params.emplace_back(key, value);
+  }
+};
+
+// Two-sided 95% Student t quantile for df degrees of freedom
+inline double StudentT95(int64_t df) {
+  static const double table[] = {
+    12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+    2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+    2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+  return df >= 1 && df <= 30 ? table[df - 1] : 1.960;
+}
+
+// Linear interpolation between closest ranks; sorted must be non-empty
+inline double Percentile(const std::vector<double> &sorted, double p) {
+  double pos = p * (sorted.size() - 1);
+  size_t lo = static_cast<size_t>(pos);
+  size_t hi = std::min(lo + 1, sorted.size() - 1);
+  return sorted[lo] + (pos - lo) * (sorted[hi] - sorted[lo]);
+}
+
+inline void ComputeStats(BenchResult &r) {
+  const std::vector<double> &s = r.samples_ns;
+  if (s.empty())
+    return;
+  std::vector<double> sorted(s);
+  std::sort(sorted.begin(), sorted.end());
+  r.median_ns = Percentile(sorted, 0.5);
+  r.p5_ns = Percentile(sorted, 0.05);
+  r.p95_ns = Percentile(sorted, 0.95);
+  double sum = 0;
+  for (double x : s)
+    sum += x;
+  r.mean_ns = sum / s.size();
+  double sq = 0;
+  for (double x : s)
+    sq += (x - r.mean_ns) * (x - r.mean_ns);
+  r.stddev_ns = s.size() > 1 ? std::sqrt(sq / (s.size() - 1)) : 0;
+  r.cv = r.mean_ns > 0 ? r.stddev_ns / r.mean_ns : 0;
+  r.ci95_ns = s.size() > 1 ?
+      StudentT95(s.size() - 1) * r.stddev_ns / std::sqrt(double(s.size())) : 0;
+}
+
+// Collects sample() (one duration in ns per call) until the stopping rule
+// holds; for kernels that time themselves, e.g. without their setup
+template <typename SampleFunc>
+BenchResult RunSampled(const std::string &name, const RunnerOptions &opts,
+                       SampleFunc sample) {
+  typedef std::chrono::steady_clock Clock;
+  BenchResult r;
+  r.name = name;
+  r.warmup = opts.warmup;
+  for (int i = 0; i < opts.warmup; i++)
+    sample();
+  Clock::time_point first = Clock::now();
+  while (true) {
+    r.samples_ns.push_back(sample());
+    int reps = static_cast<int>(r.samples_ns.size());
+    if (reps < opts.min_reps)
+      continue;
+    ComputeStats(r);
+    r.converged = r.ci95_ns <= opts.ci * r.mean_ns;
+    double elapsed =
+        std::chrono::duration<double>(Clock::now() - first).count();
+    if (r.converged || reps >= opts.max_reps || elapsed >= opts.max_seconds)
+      break;
+  }
+  return r;
+}
+
+// Times kernel() with steady_clock; setup() runs untimed before every call
+// (warmup included), for kernels that consume their input
+template <typename KernelFunc, typename SetupFunc>
+BenchResult RunBenchmark(const std::string &name, const RunnerOptions &opts,
+                         KernelFunc kernel, SetupFunc setup) {
+  return RunSampled(name, opts, [&]() {
+    setup();
+    std::chrono::steady_clock::time_point start =
+        std::chrono::steady_clock::now();
+    kernel();
+    return std::chrono::duration<double, std::nano>(
+        std::chrono::steady_clock::now() - start).count();
+  });
+}
+
+template <typename KernelFunc>
+BenchResult RunBenchmark(const std::string &name, const RunnerOptions &opts,
+                         KernelFunc kernel) {
+  return RunBenchmark(name, opts, kernel, [] {});
+}
+
+inline void PrintBenchResult(std::ostream &out, const BenchResult &r) {
+  const std::ios::fmtflags flags = out.flags();
+  const std::streamsize precision = out.precision();
+  out << std::fixed << std::setprecision(0);
+  out << r.name << ": median " << r.median_ns << " ns  p5 " << r.p5_ns
+      << "  p95 " << r.p95_ns << "  cv " << std::setprecision(2)
+      << 100 * r.cv << "%  ci95 +/-" << std::setprecision(0) << r.ci95_ns
+      << " ns  reps " << r.samples_ns.size()
+      << (r.converged ? "" : " (not converged)") << std::endl;
+  out.flags(flags);
+  out.precision(precision);
+}
+
+inline std::string JsonString(const std::string &s) {
+  std::string out = "\"";
+  for (char c : s) {
+    if (c == '"' || c == '\\') {
+      out += '\\';
+      out += c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      char buf[8];
+      snprintf(buf, sizeof(buf), "\\u%04x", c);
+      out += buf;
+    } else {
+      out += c;
+    }
+  }
+  return out + "\"";
+}
+
+inline bool WriteBenchJson(const std::string &path, const RunnerOptions &opts,
+                           const std::vector<BenchResult> &results) {
+  std::ofstream out(path.c_str(), std::ios::trunc);
+  out << std::setprecision(1) << std::fixed;
+  out << "{\"pin\": " << JsonString(opts.pin)
+      << ", \"fifo_priority\": " << opts.fifo_priority
+      << ", \"ci_target\": " << std::setprecision(4) << opts.ci
+      << std::setprecision(1) << ",\n \"benchmarks\": [";
+  for (size_t i = 0; i < results.size(); i++) {
+    const BenchResult &r = results[i];
+    out << (i == 0 ? "\n" : ",\n") << "  {\"name\": " << JsonString(r.name)
+        << ", \"params\": {";
+    for (size_t p = 0; p < r.params.size(); p++) {
+      out << (p == 0 ? "" : ", ") << JsonString(r.params[p].first) << ": "
+          << JsonString(r.params[p].second);
+    }
+    out << "}, \"warmup\": " << r.warmup
+        << ", \"reps\": " << r.samples_ns.size()
+        << ", \"converged\": " << (r.converged ? "true" : "false")
+        << ",\n   \"median_ns\": " << r.median_ns
+        << ", \"p5_ns\": " << r.p5_ns << ", \"p95_ns\": " << r.p95_ns
+        << ", \"mean_ns\": " << r.mean_ns << ", \"stddev_ns\": " << r.stddev_ns
+        << ", \"ci95_ns\": " << r.ci95_ns
+        << ", \"cv\": " << std::setprecision(6) << r.cv << std::setprecision(1)
+        << ",\n   \"samples_ns\": [";
+    for (size_t s = 0; s < r.samples_ns.size(); s++)
+      out << (s == 0 ? "" : ", ") << r.samples_ns[s];
+    out << "]}";
+  }
+  out << "\n]}\n";
+  return static_cast<bool>(out);
+}
+
+#endif  // BENCH_RUNNER_H_
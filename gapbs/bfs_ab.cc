@@ -0,0 +1,203 @@
+#include <iostream>
+#include <vector>
+#include <iomanip>
+#include <cstdint>
+#include <sstream>
+#include <string>
+
+#include "bench_runner.h"
+#include "benchmark.h"
+#include "bfs_kernel.h"
+#include "bfs_variants.h"
+#include "builder.h"
+#include "command_line.h"
+#include "graph.h"
+#include "graph_snapshot.h"
+#include "pvector.h"
+
+/*
+In-process A/B runner for BFS variants
+
+Builds the graph once and runs every selected variant (bfs_variants.h) on
+the same source sequence from SourcePicker. Trials are interleaved: each
+trial picks one source and runs all variants on it, starting from a
+different variant every trial, so drift (thermal, page cache, other load)
+is spread evenly instead of landing on whichever variant runs last.
+
+Extra flags (stripped before CLApp sees them):
+  --variants=a,b,c   variants to run, in table order (default: all)
+  --list-variants    print the registry and exit
+  --snapshot=F       mmap graph snapshot F (built and written if missing)
+  --snapshot-prefault=none|populate|background
+  --verify=serial|parallel|sampled, --verify-samples=K  -v checker
+                      (bfs_verify.h, default parallel)
+  --numa-parts=P, --numa-bind=0|1  partitions and thread pinning for the
+                      numa variant (bfs_numa.h)
+  --pin, --fifo, --warmup, --min-reps, --max-reps, --ci, --max-time, --json
+                      process pinning/priority; with any of them, every
+                      variant is also sampled until its timing is stable,
+                      after the interleaved table (bench_runner.h)
+
+-n trials, -r source, -v verify and -l logging behave as in bfs.
+*/
+
+using namespace std;
+
+static string g_variant_list = "";
+static bool g_list_variants = false;
+
+// Graph snapshot (graph_snapshot.h): mmap if present, else build and save
+static string g_snapshot = "";
+static SnapshotPrefault g_prefault = kPrefaultNone;
+
+static RunnerOptions g_runner;
+
+static void StripCustomArgs(int& argc, char** argv) {
+  int out = 1;
+  for (int i = 1; i < argc; ++i) {
+    string a = argv[i];
+    if (a.compare(0, 11, "--variants=") == 0) g_variant_list = a.substr(11);
+    else if (a == "--list-variants") g_list_variants = true;
+    else if (a.compare(0, 11, "--snapshot=") == 0) g_snapshot = a.substr(11);
+    else if (a.compare(0, 20, "--snapshot-prefault=") == 0) {
+      if (!ParseSnapshotPrefault(a.substr(20), g_prefault))
+        cout << "Unknown prefault mode " << a.substr(20) << endl;
+    }
+    else if (ParseVerifyArg(a, g_verify)) continue;
+    else if (ParseNumaArg(a, g_numa)) continue;
+    else if (ParseRunnerArg(a, g_runner)) continue;
+    else argv[out++] = argv[i];
+  }
+  argc = out;
+}
+
+struct VariantTally {
+  const BFSVariant *variant;
+  int runs = 0;
+  int failures = 0;
+  double total_sec = 0;
+  double min_sec = -1;
+  int64_t edges = 0;
+  bool has_metrics = false;
+  BfsMemMetrics metrics;
+};
+
+static bool SelectVariants(vector<VariantTally> &tallies) {
+  vector<string> names;
+  if (g_variant_list == "") {
+    for (const BFSVariant &v : BFSVariants())
+      names.push_back(v.name);
+  } else {
+    stringstream ss(g_variant_list);
+    string name;
+    while (getline(ss, name, ','))
+      if (!name.empty()) names.push_back(name);
+  }
+  for (const string &name : names) {
+    const BFSVariant *v = FindBFSVariant(name);
+    if (v == nullptr) {
+      cout << "Unknown variant " << name << " (see --list-variants)" << endl;
+      return false;
+    }
+    VariantTally tally;
+    tally.variant = v;
+    tallies.push_back(tally);
+  }
+  return !tallies.empty();
+}
+
+static void PrintTable(const vector<VariantTally> &tallies) {
+  const double ref = tallies[0].runs > 0
+                       ? tallies[0].total_sec / tallies[0].runs : 0;
+  cout << endl << left << setw(14) << "variant" << right
+       << setw(12) << "avg (s)" << setw(12) << "min (s)"
+       << setw(16) << "TEPS" << setw(12) << "Ie" << setw(10) << "speedup"
+       << setw(8) << "fail" << endl;
+  for (const VariantTally &t : tallies) {
+    double avg = t.runs > 0 ? t.total_sec / t.runs : 0;
+    double teps = t.total_sec > 0 ? t.edges / t.total_sec : 0;
+    cout << left << setw(14) << t.variant->name << right << fixed
+         << setprecision(6) << setw(12) << avg << setw(12) << t.min_sec
+         << setprecision(0) << setw(16) << teps;
+    if (t.has_metrics) {
+      double bytes = t.metrics.BytesEstimate(sizeof(NodeID));
+      cout << setprecision(6) << setw(12) << (bytes > 0 ? t.edges / bytes : 0);
+    } else {
+      cout << setw(12) << "-";
+    }
+    cout << setprecision(2) << setw(9) << (avg > 0 ? ref / avg : 0) << "x"
+         << setw(8) << t.failures << endl;
+  }
+  if (g_balancer.steps() > 0)
+    g_balancer.PrintStats(cout);
+  g_numa_stats.Print();
+}
+
+int main(int argc, char* argv[]) {
+  Timer t_startup;
+  t_startup.Start();
+  StripCustomArgs(argc, argv);
+  RegisterBuiltinBFSVariants();
+  if (g_list_variants) {
+    for (const BFSVariant &v : BFSVariants())
+      cout << left << setw(14) << v.name << v.description << endl;
+    return 0;
+  }
+
+  CLApp cli(argc, argv, "breadth-first search A/B");
+  if (!cli.ParseArgs()) return -1;
+  ScopedSchedule schedule(g_runner);
+
+  vector<VariantTally> tallies;
+  if (!SelectVariants(tallies)) return -1;
+
+  GraphProvider provider;
+  const Graph &g = provider.Get(cli, g_snapshot, g_prefault);
+  g.PrintStats();
+
+  SourcePicker<Graph> sp(g, cli.start_vertex());
+  const size_t num_variants = tallies.size();
+  for (int trial = 0; trial < cli.num_trials(); trial++) {
+    NodeID source = sp.PickNext();
+    PrintStep("Source", static_cast<int64_t>(source));
+    for (size_t k = 0; k < num_variants; k++) {
+      VariantTally &t = tallies[(trial + k) % num_variants];
+      BFSRun run = t.variant->run(g, source, cli.logging_en());
+      t.runs++;
+      t.total_sec += run.seconds;
+      if (t.min_sec < 0 || run.seconds < t.min_sec) t.min_sec = run.seconds;
+      t.edges += run.traversed_edges;
+      if (run.has_metrics) {
+        t.has_metrics = true;
+        t.metrics.AddScaled(run.metrics, 1);
+      }
+      PrintTime(t.variant->name, run.seconds);
+      if (trial == 0 && k == 0) {
+        t_startup.Stop();
+        PrintTime("Time to First BFS", t_startup.Seconds());
+      }
+      if (cli.do_verify() && !BFSVerifier(g, source, run.parent)) {
+        t.failures++;
+        PrintLabel("Verification", "FAIL");
+      }
+    }
+  }
+  PrintTable(tallies);
+
+  // Per-variant stable timings, each over the same source sequence
+  if (g_runner.enabled) {
+    vector<BenchResult> results;
+    for (const VariantTally &t : tallies) {
+      SourcePicker<Graph> rsp(g, cli.start_vertex());
+      results.push_back(RunSampled(t.variant->name, g_runner, [&]() {
+        return t.variant->run(g, rsp.PickNext(), false).seconds * 1e9;
+      }));
+      results.back().AddParam("variants", g_variant_list);
+      PrintBenchResult(cout, results.back());
+    }
+    if (!g_runner.json_path.empty() &&
+        !WriteBenchJson(g_runner.json_path, g_runner, results))
+      cout << "Could not write " << g_runner.json_path << endl;
+  }
+  return 0;
+}
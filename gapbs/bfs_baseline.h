@@ -0,0 +1,176 @@
+// Copyright (c) 2015,
+// The Regents of the University of California (Regents)
+// See LICENSE.txt for license details
+
+#ifndef BFS_BASELINE_H_
+#define BFS_BASELINE_H_
+
+#include <cinttypes>
+
+#include "benchmark.h"
+#include "bitmap.h"
+#include "graph.h"
+#include "platform_atomics.h"
+#include "pvector.h"
+#include "sliding_queue.h"
+#include "timer.h"
+
+/*
+Baseline single-threaded DOBFS (the bfs_treps.cc kernel)
+
+These are the loops bfs_treps.cc has always timed: per-trial allocation of
+parent, queue and both Bitmaps, vertex-at-a-time frontier conversions and
+serial td/bu steps. They live in a header so the A/B runner's "baseline"
+variant (bfs_variants.h) runs exactly this code rather than a DOBFS
+configuration that merely resembles it. Names carry a Baseline prefix so
+they can sit next to bfs_kernel.h in one translation unit.
+
+BaselineDOBFS reports edges and search time through its out-parameters
+instead of globals; the parent initialization is not timed.
+*/
+
+inline int64_t BaselineBUStep(const Graph &g, pvector<NodeID> &parent,
+                              Bitmap &front, Bitmap &next,
+                              int64_t &edges_visited) {
+  int64_t awake_count = 0;
+  next.reset();
+  for (NodeID u = 0; u < g.num_nodes(); u++) {
+    if (parent[u] < 0) {
+      for (NodeID v : g.in_neigh(u)) {
+        edges_visited++;                 // count each in-neighbor check
+        if (front.get_bit(v)) {
+          parent[u] = v;
+          awake_count++;
+          next.set_bit(u);
+          break;                         // stop after finding one parent
+        }
+      }
+    }
+  }
+  return awake_count;
+}
+
+inline int64_t BaselineTDStep(const Graph &g, pvector<NodeID> &parent,
+                              SlidingQueue<NodeID> &queue,
+                              int64_t &edges_visited) {
+  int64_t scout_count = 0;
+  QueueBuffer<NodeID> lqueue(queue);
+  for (auto q_iter = queue.begin(); q_iter < queue.end(); q_iter++) {
+    NodeID u = *q_iter;
+    for (NodeID v : g.out_neigh(u)) {
+      edges_visited++;                   // count each out-neighbor check
+      NodeID curr_val = parent[v];
+      if (curr_val < 0) {
+        if (compare_and_swap(parent[v], curr_val, u)) {
+          lqueue.push_back(v);
+          scout_count += -curr_val;      // degree stored as negative
+        }
+      }
+    }
+  }
+  lqueue.flush();
+  return scout_count;
+}
+
+inline void BaselineQueueToBitmap(const SlidingQueue<NodeID> &queue,
+                                  Bitmap &bm) {
+  for (auto q_iter = queue.begin(); q_iter < queue.end(); q_iter++) {
+    NodeID u = *q_iter;
+    bm.set_bit_atomic(u);
+  }
+}
+
+inline void BaselineBitmapToQueue(const Graph &g, const Bitmap &bm,
+                                  SlidingQueue<NodeID> &queue) {
+  QueueBuffer<NodeID> lqueue(queue);
+  for (NodeID n = 0; n < g.num_nodes(); n++)
+    if (bm.get_bit(n))
+      lqueue.push_back(n);
+  lqueue.flush();
+  queue.slide_window();
+}
+
+inline pvector<NodeID> BaselineInitParent(const Graph &g) {
+  pvector<NodeID> parent(g.num_nodes());
+  for (NodeID n = 0; n < g.num_nodes(); n++)
+    parent[n] = g.out_degree(n) != 0 ? -g.out_degree(n) : -1;
+  return parent;
+}
+
+inline pvector<NodeID> BaselineDOBFS(const Graph &g, NodeID source,
+                                     bool logging_enabled,
+                                     int64_t &traversed_edges_out,
+                                     double &seconds_out,
+                                     int alpha = 15, int beta = 18) {
+  if (logging_enabled)
+    PrintStep("Source", static_cast<int64_t>(source));
+
+  // Initialize parents (not counted in BFS time)
+  Timer t;
+  t.Start();
+  pvector<NodeID> parent = BaselineInitParent(g);
+  t.Stop();
+  if (logging_enabled)
+    PrintStep("i", t.Seconds());
+
+  parent[source] = source;
+
+  // Start BFS-only timing and set traversal counter
+  Timer t_total;
+  t_total.Start();
+  int64_t traversed_edges = 0;
+
+  SlidingQueue<NodeID> queue(g.num_nodes());
+  queue.push_back(source);
+  queue.slide_window();
+  Bitmap curr(g.num_nodes());
+  curr.reset();
+  Bitmap front(g.num_nodes());
+  front.reset();
+  int64_t edges_to_check = g.num_edges_directed();
+  int64_t scout_count = g.out_degree(source);
+  while (!queue.empty()) {
+    if (scout_count > edges_to_check / alpha) {
+      int64_t awake_count, old_awake_count;
+      TIME_OP(t, BaselineQueueToBitmap(queue, front));
+      if (logging_enabled)
+        PrintStep("e", t.Seconds());
+      awake_count = queue.size();
+      queue.slide_window();
+      do {
+        t.Start();
+        old_awake_count = awake_count;
+        awake_count = BaselineBUStep(g, parent, front, curr, traversed_edges);
+        front.swap(curr);
+        t.Stop();
+        if (logging_enabled)
+          PrintStep("bu", t.Seconds(), awake_count);
+      } while ((awake_count >= old_awake_count) ||
+               (awake_count > g.num_nodes() / beta));
+      TIME_OP(t, BaselineBitmapToQueue(g, front, queue));
+      if (logging_enabled)
+        PrintStep("c", t.Seconds());
+      scout_count = 1;
+    } else {
+      t.Start();
+      edges_to_check -= scout_count;
+      scout_count = BaselineTDStep(g, parent, queue, traversed_edges);
+      queue.slide_window();
+      t.Stop();
+      if (logging_enabled)
+        PrintStep("td", t.Seconds(), queue.size());
+    }
+  }
+
+  for (NodeID n = 0; n < g.num_nodes(); n++)
+    if (parent[n] < -1)
+      parent[n] = -1;
+
+  // Stop BFS-only timing and hand the totals back
+  t_total.Stop();
+  traversed_edges_out = traversed_edges;
+  seconds_out = t_total.Seconds();
+  return parent;
+}
+
+#endif  // BFS_BASELINE_H_
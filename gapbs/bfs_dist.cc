@@ -0,0 +1,649 @@
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <iostream>
+#include <vector>
+#include <iomanip>
+#include <algorithm>
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include "benchmark.h"
+#include "bfs_kernel.h"
+#include "builder.h"
+#include "command_line.h"
+#include "dist_transport.h"
+#include "graph.h"
+#include "graph_snapshot.h"
+#include "pvector.h"
+#include "timer.h"
+
+/*
+Multi-process direction-optimizing BFS with a 2D partitioned adjacency
+
+P processes form an R x C grid (R the largest divisor of P not above
+sqrt(P)). The vertices are cut into P pieces on 64-vertex boundaries and
+rank r = i * C + j owns piece r: its parent values and its slice of the
+frontier. Rank (i, j) holds the block of edges u -> v with v in row block
+i (the pieces of ranks i*C .. i*C + C-1) and u in column block j (the
+pieces of ranks j, C + j, 2C + j, ...), once by source for top-down and
+once by destination for bottom-up.
+
+  td  expand: the owned frontier queues are allgathered along the grid
+      column, so every rank sees the frontier of its column block. Each
+      rank walks its block's out-edges from those vertices.
+      fold: (v, parent) candidates go to v's owner along the grid row,
+      which claims the unvisited ones. A rank skips any v its copy of
+      visited already has and marks each v it sends, so it sends a
+      vertex at most once per BFS
+  bu  the owned front bitmap slices are allgathered along the column and
+      the owned visited slices along the row. Each rank checks the
+      unvisited vertices of its row block against its column block's
+      in-edges and folds the first hit per vertex to the owner
+Direction switching uses DOBFS's alpha/beta rules on globally reduced
+counts, so every rank takes the same path.
+
+Bitmap slices are compressed before bottom-up exchanges: a slice goes out
+raw or as (word index, word) pairs for its non-zero words, whichever is
+smaller. Front slices are sent as they are; they are sparse at the start
+and end of a bottom-up phase. Visited slices only grow, so they are sent
+as the XOR against the previous exchange, which holds just the vertices
+claimed since then, and are ORed into the receiver's copy, which may
+already hold vertices it sent as td candidates.
+
+Ranks talk only through a Transport (dist_transport.h). The one provided
+is ShmTransport, shared memory between processes forked from the driver.
+The graph is built (or mapped) once before the fork and each rank copies
+out its own blocks, so the per-rank memory is what a distributed
+deployment would hold, but the build itself is not distributed.
+
+Rank 0 runs the usual BenchmarkKernel loop and broadcasts each source to
+the other ranks; parents are gathered to rank 0 after the timer stops,
+for -v. The report gives, per BFS, bytes sent between ranks (every
+message to another rank, summed over ranks) and TEPS. -l adds a per-level
+table of direction, frontier, communication volume and bitmap compression.
+Run with several --procs to see how both scale.
+
+Extra flags (stripped before CLApp sees them):
+  --procs=P             process count (default 4)
+  --slot-kb=K           shared-memory slot per rank pair (default 256)
+  --compress=0|1        compress bottom-up bitmap slices (default 1)
+  --snapshot=F          graph snapshot (graph_snapshot.h), never prefaulted
+                        in the background since the driver forks
+  --verify=serial|parallel|sampled, --verify-samples=K  -v checker
+                        (bfs_verify.h, default parallel)
+*/
+
+using namespace std;
+
+static int g_procs = 4;
+static size_t g_slot_bytes = 256 << 10;
+static bool g_compress = true;
+static string g_snapshot = "";
+
+static void StripCustomArgs(int& argc, char** argv) {
+  int out = 1;
+  for (int i = 1; i < argc; ++i) {
+    string a = argv[i];
+    if (a.compare(0, 8, "--procs=") == 0) g_procs = atoi(a.c_str() + 8);
+    else if (a.compare(0, 10, "--slot-kb=") == 0)
+      g_slot_bytes = atol(a.c_str() + 10) << 10;
+    else if (a.compare(0, 11, "--compress=") == 0)
+      g_compress = atoi(a.c_str() + 11) != 0;
+    else if (a.compare(0, 11, "--snapshot=") == 0) g_snapshot = a.substr(11);
+    else if (ParseVerifyArg(a, g_verify)) continue;
+    else argv[out++] = argv[i];
+  }
+  argc = out;
+}
+
+template <typename T>
+vector<uint8_t> ToBytes(const T *data, size_t n) {
+  vector<uint8_t> bytes(n * sizeof(T));
+  if (n > 0) memcpy(bytes.data(), data, bytes.size());
+  return bytes;
+}
+
+template <typename T>
+size_t NumElems(const vector<uint8_t> &bytes) {
+  return bytes.size() / sizeof(T);
+}
+
+template <typename T>
+const T* Elems(const vector<uint8_t> &bytes) {
+  return reinterpret_cast<const T*>(bytes.data());
+}
+
+// Slice words [lo, hi): tag 0 + raw words, or tag 1 + (index, word) pairs
+vector<uint8_t> EncodeBitmap(const uint64_t *words, int64_t lo, int64_t hi,
+                             bool compress) {
+  int64_t nonzero = 0;
+  if (compress)
+    for (int64_t w = lo; w < hi; w++) nonzero += words[w] != 0;
+  const size_t raw_bytes = 8 + (hi - lo) * sizeof(uint64_t);
+  const size_t sparse_bytes = 8 + nonzero * (sizeof(uint32_t) +
+                                             sizeof(uint64_t));
+  vector<uint8_t> out;
+  if (!compress || raw_bytes <= sparse_bytes) {
+    out.resize(raw_bytes, 0);
+    if (hi > lo)
+      memcpy(out.data() + 8, words + lo, (hi - lo) * sizeof(uint64_t));
+    return out;
+  }
+  out.resize(sparse_bytes, 0);
+  out[0] = 1;
+  uint8_t *p = out.data() + 8;
+  for (int64_t w = lo; w < hi; w++) {
+    if (words[w] == 0) continue;
+    uint32_t idx = w - lo;
+    memcpy(p, &idx, sizeof(idx));
+    memcpy(p + sizeof(idx), &words[w], sizeof(uint64_t));
+    p += sizeof(idx) + sizeof(uint64_t);
+  }
+  return out;
+}
+
+// Writes the slice into words[lo, hi), or ORs it in when delta is set
+void DecodeBitmap(const vector<uint8_t> &in, uint64_t *words, int64_t lo,
+                  int64_t hi, bool delta) {
+  if (in[0] == 0) {
+    const uint64_t *src = Elems<uint64_t>(in) + 1;
+    for (int64_t w = lo; w < hi; w++)
+      words[w] = delta ? words[w] | src[w - lo] : src[w - lo];
+    return;
+  }
+  if (!delta)
+    fill(words + lo, words + hi, 0);
+  const uint8_t *p = in.data() + 8;
+  const uint8_t *end = in.data() + in.size();
+  for (; p < end; p += sizeof(uint32_t) + sizeof(uint64_t)) {
+    uint32_t idx;
+    uint64_t bits;
+    memcpy(&idx, p, sizeof(idx));
+    memcpy(&bits, p + sizeof(idx), sizeof(bits));
+    words[lo + idx] |= bits;
+  }
+}
+
+struct DistCandidate {
+  NodeID v;
+  NodeID parent;
+};
+
+// One level as seen by this rank
+struct DistLevel {
+  bool bottom_up;
+  int64_t frontier;           // global, after the level
+  int64_t bytes;              // sent by this rank
+  int64_t bitmap_raw;         // bitmap slice bytes before compression
+  int64_t bitmap_sent;
+};
+
+// Report totals on rank 0, summed over trials
+struct DistStats {
+  int64_t edges = 0;
+  int64_t bytes = 0;
+  int64_t levels = 0;
+  int64_t bitmap_raw = 0;
+  int64_t bitmap_sent = 0;
+  double seconds = 0;
+};
+
+static DistStats g_dist;
+
+class DistBFS {
+ public:
+  DistBFS(const Graph &g, Transport &tr, bool compress)
+      : g_(g), tr_(tr), compress_(compress) {
+    const int p = tr.size();
+    rows_ = 1;
+    for (int r = 1; r * r <= p; r++)
+      if (p % r == 0) rows_ = r;
+    cols_ = p / rows_;
+    row_ = tr.rank() / cols_;
+    col_ = tr.rank() % cols_;
+    bounds_.resize(p + 1);
+    for (int k = 0; k < p; k++)
+      bounds_[k] = (g.num_nodes() * k / p) / 64 * 64;
+    bounds_[p] = g.num_nodes();
+    lo_ = bounds_[tr.rank()];
+    hi_ = bounds_[tr.rank() + 1];
+    for (int j = 0; j < cols_; j++)
+      row_group_.push_back(row_ * cols_ + j);
+    for (int i = 0; i < rows_; i++)
+      col_group_.push_back(i * cols_ + col_);
+    row_lo_ = bounds_[row_ * cols_];
+    row_hi_ = bounds_[row_ * cols_ + cols_];
+    BuildBlocks();
+    num_words_ = (g.num_nodes() + 63) / 64;
+    parent_.resize(hi_ - lo_);
+    front_.assign(num_words_, 0);
+    next_.assign(num_words_, 0);
+    visited_.assign(num_words_, 0);
+    visited_sent_.assign(num_words_, 0);
+  }
+
+  int rows() const { return rows_; }
+  int cols() const { return cols_; }
+  int64_t local_edges() const {
+    return out_neigh_.size() + in_neigh_.size();
+  }
+
+  // Collective; returns the gathered parent array on rank 0
+  pvector<NodeID> Run(NodeID source, bool logging_enabled,
+                      const BFSOptions &opts) {
+    Timer t_total, t;
+    tr_.Barrier();
+    t_total.Start();
+    fill(parent_.begin(), parent_.end(), -1);
+    fill(front_.begin(), front_.end(), 0);
+    fill(visited_.begin(), visited_.end(), 0);
+    fill(visited_sent_.begin(), visited_sent_.end(), 0);
+    queue_.clear();
+    if (source >= lo_ && source < hi_) {
+      parent_[source - lo_] = source;
+      queue_.push_back(source);
+      SetBit(visited_, source);
+    }
+    levels_.clear();
+    edges_ = 0;
+
+    int64_t edges_to_check = g_.num_edges_directed();
+    int64_t scout_count = g_.out_degree(source);
+    int64_t frontier = 1;
+    while (frontier > 0) {
+      if (scout_count > edges_to_check / opts.alpha) {
+        QueueToBitmap();
+        int64_t awake_count = frontier, old_awake_count;
+        do {
+          old_awake_count = awake_count;
+          awake_count = BUStep();
+        } while ((awake_count >= old_awake_count) ||
+                 (awake_count > g_.num_nodes() / opts.beta));
+        BitmapToQueue();
+        frontier = awake_count;
+        scout_count = 1;
+      } else {
+        edges_to_check -= scout_count;
+        vector<int64_t> counts = TDStep();
+        frontier = counts[0];
+        scout_count = counts[1];
+      }
+    }
+    t_total.Stop();
+
+    // Level statistics, summed over ranks
+    vector<int64_t> sums(3 * levels_.size() + 1);
+    for (size_t l = 0; l < levels_.size(); l++) {
+      sums[3 * l] = levels_[l].bytes;
+      sums[3 * l + 1] = levels_[l].bitmap_raw;
+      sums[3 * l + 2] = levels_[l].bitmap_sent;
+    }
+    sums.back() = edges_;
+    tr_.AllReduceSum(sums);
+    if (tr_.rank() == 0) {
+      int64_t bytes = 0, raw = 0, sent = 0;
+      for (size_t l = 0; l < levels_.size(); l++) {
+        bytes += sums[3 * l];
+        raw += sums[3 * l + 1];
+        sent += sums[3 * l + 2];
+      }
+      if (logging_enabled)
+        PrintLevels(sums);
+      g_dist.edges += sums.back();
+      g_dist.bytes += bytes;
+      g_dist.levels += levels_.size();
+      g_dist.bitmap_raw += raw;
+      g_dist.bitmap_sent += sent;
+      g_dist.seconds += t_total.Seconds();
+      g_traversed_edges = sums.back();
+      g_bfs_time_sec = t_total.Seconds();
+    }
+
+    // Parents to rank 0
+    vector<vector<uint8_t>> pieces =
+        tr_.Gather(ToBytes(parent_.data(), parent_.size()));
+    pvector<NodeID> parent;
+    if (tr_.rank() == 0) {
+      parent = pvector<NodeID>(g_.num_nodes());
+      for (int k = 0; k < tr_.size(); k++)
+        copy(Elems<NodeID>(pieces[k]),
+             Elems<NodeID>(pieces[k]) + NumElems<NodeID>(pieces[k]),
+             parent.begin() + bounds_[k]);
+    }
+    return parent;
+  }
+
+ private:
+  int Owner(NodeID v) const {
+    return upper_bound(bounds_.begin(), bounds_.end(), v) -
+           bounds_.begin() - 1;
+  }
+
+  bool InColBlock(NodeID u) const { return Owner(u) % cols_ == col_; }
+
+  static void SetBit(vector<uint64_t> &bm, NodeID v) {
+    bm[v >> 6] |= uint64_t(1) << (v & 63);
+  }
+  static bool GetBit(const vector<uint64_t> &bm, NodeID v) {
+    return (bm[v >> 6] >> (v & 63)) & 1;
+  }
+
+  int64_t lo_word(int k) const { return bounds_[k] / 64; }
+  int64_t hi_word(int k) const { return (bounds_[k + 1] + 63) / 64; }
+
+  // Out-edges by column-block source, in-edges by row-block destination
+  void BuildBlocks() {
+    col_start_.push_back(0);
+    for (int i = 0; i < rows_; i++) {
+      int k = i * cols_ + col_;
+      col_start_.push_back(col_start_.back() + bounds_[k + 1] - bounds_[k]);
+    }
+    out_index_.push_back(0);
+    for (int i = 0; i < rows_; i++) {
+      int k = i * cols_ + col_;
+      for (NodeID u = bounds_[k]; u < bounds_[k + 1]; u++) {
+        auto neigh = g_.out_neigh(u);
+        NodeID *first = lower_bound(neigh.begin(), neigh.end(), row_lo_);
+        NodeID *last = lower_bound(first, neigh.end(), row_hi_);
+        out_neigh_.insert(out_neigh_.end(), first, last);
+        out_index_.push_back(out_neigh_.size());
+      }
+    }
+    in_index_.push_back(0);
+    for (NodeID v = row_lo_; v < row_hi_; v++) {
+      if (g_.directed()) {
+        for (NodeID u : g_.in_neigh(v))
+          if (InColBlock(u)) in_neigh_.push_back(u);
+      } else {
+        for (NodeID u : g_.out_neigh(v))
+          if (InColBlock(u)) in_neigh_.push_back(u);
+      }
+      in_index_.push_back(in_neigh_.size());
+    }
+  }
+
+  int64_t ColIndex(NodeID u) const {
+    int k = Owner(u);
+    return col_start_[k / cols_] + (u - bounds_[k]);
+  }
+
+  // Returns {global frontier, global scout count}
+  vector<int64_t> TDStep() {
+    DistLevel level = DistLevel();
+    const int64_t bytes_before = tr_.bytes_sent();
+    // Expand along the column
+    vector<vector<uint8_t>> frontiers;
+    tr_.AllGather(col_group_, ToBytes(queue_.data(), queue_.size()),
+                  frontiers);
+    // Local SpMSpV, candidates bucketed by owner in this row
+    vector<vector<DistCandidate>> out(cols_);
+    for (const vector<uint8_t> &f : frontiers) {
+      const NodeID *us = Elems<NodeID>(f);
+      for (size_t i = 0; i < NumElems<NodeID>(f); i++) {
+        NodeID u = us[i];
+        int64_t idx = ColIndex(u);
+        for (int64_t e = out_index_[idx]; e < out_index_[idx + 1]; e++) {
+          NodeID v = out_neigh_[e];
+          edges_++;
+          // Visited only grows and the owner claims every v sent, so
+          // marking v here is safe
+          if (GetBit(visited_, v))
+            continue;
+          SetBit(visited_, v);
+          out[Owner(v) - row_ * cols_].push_back(DistCandidate{v, u});
+        }
+      }
+    }
+    // Fold along the row
+    vector<vector<uint8_t>> send(cols_), recv;
+    for (int j = 0; j < cols_; j++)
+      send[j] = ToBytes(out[j].data(), out[j].size());
+    tr_.Exchange(row_group_, send, recv);
+    queue_.clear();
+    int64_t scout_count = 0;
+    for (const vector<uint8_t> &r : recv) {
+      const DistCandidate *c = Elems<DistCandidate>(r);
+      for (size_t i = 0; i < NumElems<DistCandidate>(r); i++) {
+        NodeID &slot = parent_[c[i].v - lo_];
+        if (slot == -1) {
+          slot = c[i].parent;
+          SetBit(visited_, c[i].v);
+          queue_.push_back(c[i].v);
+          scout_count += g_.out_degree(c[i].v);
+        }
+      }
+    }
+    level.bytes = tr_.bytes_sent() - bytes_before;
+    vector<int64_t> counts = {static_cast<int64_t>(queue_.size()),
+                              scout_count};
+    tr_.AllReduceSum(counts);
+    level.frontier = counts[0];
+    levels_.push_back(level);
+    return counts;
+  }
+
+  // Allgathers this rank's words of bm within group (owners are pieces).
+  // With base, sends bm XOR base and then sets base to bm.
+  void ShareSlices(vector<uint64_t> &bm, vector<uint64_t> *base,
+                   const vector<int> &group, DistLevel &level) {
+    const int me = tr_.rank();
+    const int64_t lo = lo_word(me), hi = hi_word(me);
+    vector<uint8_t> enc;
+    if (base != nullptr) {
+      vector<uint64_t> diff(num_words_, 0);
+      for (int64_t w = lo; w < hi; w++)
+        diff[w] = bm[w] ^ (*base)[w];
+      enc = EncodeBitmap(diff.data(), lo, hi, compress_);
+      copy(bm.begin() + lo, bm.begin() + hi, base->begin() + lo);
+    } else {
+      enc = EncodeBitmap(bm.data(), lo, hi, compress_);
+    }
+    int peers = group.size() - 1;
+    level.bitmap_raw += peers * (hi - lo) * int64_t(sizeof(uint64_t));
+    level.bitmap_sent += peers * int64_t(enc.size());
+    vector<vector<uint8_t>> recv;
+    tr_.AllGather(group, enc, recv);
+    for (size_t k = 0; k < group.size(); k++) {
+      if (group[k] == me) continue;
+      // Slices share no words: pieces start on 64-vertex boundaries
+      DecodeBitmap(recv[k], bm.data(), lo_word(group[k]), hi_word(group[k]),
+                   base != nullptr);
+    }
+  }
+
+  // Returns the global number of vertices woken up
+  int64_t BUStep() {
+    DistLevel level = DistLevel();
+    level.bottom_up = true;
+    const int64_t bytes_before = tr_.bytes_sent();
+    ShareSlices(front_, nullptr, col_group_, level);
+    ShareSlices(visited_, &visited_sent_, row_group_, level);
+    vector<vector<DistCandidate>> out(cols_);
+    for (NodeID v = row_lo_; v < row_hi_; v++) {
+      if (GetBit(visited_, v))
+        continue;
+      for (int64_t e = in_index_[v - row_lo_]; e < in_index_[v - row_lo_ + 1];
+           e++) {
+        NodeID u = in_neigh_[e];
+        edges_++;
+        if (GetBit(front_, u)) {
+          out[Owner(v) - row_ * cols_].push_back(DistCandidate{v, u});
+          break;
+        }
+      }
+    }
+    vector<vector<uint8_t>> send(cols_), recv;
+    for (int j = 0; j < cols_; j++)
+      send[j] = ToBytes(out[j].data(), out[j].size());
+    tr_.Exchange(row_group_, send, recv);
+    const int me = tr_.rank();
+    fill(next_.begin() + lo_word(me), next_.begin() + hi_word(me), 0);
+    int64_t awake_count = 0;
+    for (const vector<uint8_t> &r : recv) {
+      const DistCandidate *c = Elems<DistCandidate>(r);
+      for (size_t i = 0; i < NumElems<DistCandidate>(r); i++) {
+        NodeID &slot = parent_[c[i].v - lo_];
+        if (slot == -1) {
+          slot = c[i].parent;
+          SetBit(visited_, c[i].v);
+          SetBit(next_, c[i].v);
+          awake_count++;
+        }
+      }
+    }
+    copy(next_.begin() + lo_word(me), next_.begin() + hi_word(me),
+         front_.begin() + lo_word(me));
+    level.bytes = tr_.bytes_sent() - bytes_before;
+    awake_count = tr_.AllReduceSum(awake_count);
+    level.frontier = awake_count;
+    levels_.push_back(level);
+    return awake_count;
+  }
+
+  void QueueToBitmap() {
+    const int me = tr_.rank();
+    fill(front_.begin() + lo_word(me), front_.begin() + hi_word(me), 0);
+    for (NodeID v : queue_)
+      SetBit(front_, v);
+  }
+
+  void BitmapToQueue() {
+    const int me = tr_.rank();
+    queue_.clear();
+    for (int64_t w = lo_word(me); w < hi_word(me); w++) {
+      uint64_t bits = front_[w];
+      while (bits != 0) {
+        queue_.push_back(static_cast<NodeID>(w * 64 + __builtin_ctzll(bits)));
+        bits &= bits - 1;
+      }
+    }
+  }
+
+  void PrintLevels(const vector<int64_t> &sums) const {
+    printf("%5s %4s %12s %12s %10s\n", "level", "dir", "frontier",
+           "comm (KiB)", "bm ratio");
+    for (size_t l = 0; l < levels_.size(); l++) {
+      int64_t raw = sums[3 * l + 1], sent = sums[3 * l + 2];
+      printf("%5zu %4s %12" PRId64 " %12.1f", l,
+             levels_[l].bottom_up ? "bu" : "td", levels_[l].frontier,
+             sums[3 * l] / 1024.0);
+      if (sent > 0)
+        printf(" %9.1fx\n", double(raw) / sent);
+      else
+        printf(" %10s\n", "-");
+    }
+  }
+
+  const Graph &g_;
+  Transport &tr_;
+  bool compress_;
+  int rows_, cols_, row_, col_;
+  vector<NodeID> bounds_;
+  NodeID lo_, hi_, row_lo_, row_hi_;
+  vector<int> row_group_, col_group_;
+  vector<int64_t> col_start_;
+  vector<int64_t> out_index_, in_index_;
+  vector<NodeID> out_neigh_, in_neigh_;
+  int64_t num_words_;
+  vector<NodeID> parent_;
+  vector<NodeID> queue_;
+  vector<uint64_t> front_, next_, visited_;
+  vector<uint64_t> visited_sent_;      // own visited words last shared
+  vector<DistLevel> levels_;
+  int64_t edges_ = 0;
+};
+
+// Ranks other than 0: run every broadcast source until told to stop
+void FollowerLoop(DistBFS &bfs, Transport &tr, bool logging_enabled,
+                  const BFSOptions &opts) {
+  while (true) {
+    vector<uint8_t> cmd = tr.Broadcast(vector<uint8_t>());
+    NodeID source = *Elems<NodeID>(cmd);
+    if (source < 0)
+      return;
+    bfs.Run(source, logging_enabled, opts);
+  }
+}
+
+int main(int argc, char* argv[]) {
+  StripCustomArgs(argc, argv);
+  CLApp cli(argc, argv, "distributed breadth-first search");
+  if (!cli.ParseArgs()) return -1;
+  if (g_procs < 1) {
+    cout << "--procs must be at least 1" << endl;
+    return -1;
+  }
+
+  GraphProvider provider;
+  const Graph &g = provider.Get(cli, g_snapshot, kPrefaultNone);
+  ShmTransport tr(g_procs, g_slot_bytes);
+  if (!tr.ok()) {
+    cout << "Could not map the shared-memory transport" << endl;
+    return -1;
+  }
+  cout.flush();
+  fflush(stdout);
+  vector<pid_t> children;
+  int rank = 0;
+  for (int r = 1; r < g_procs; r++) {
+    pid_t pid = fork();
+    if (pid == 0) {
+      rank = r;
+      break;
+    }
+    children.push_back(pid);
+  }
+  tr.SetRank(rank);
+  if (rank == 0)
+    tr.WatchChildren(children);
+  BFSOptions opts;
+
+  Timer t;
+  t.Start();
+  DistBFS bfs(g, tr, g_compress);
+  int64_t total_local = tr.AllReduceSum(bfs.local_edges());
+  t.Stop();
+  if (rank != 0) {
+    FollowerLoop(bfs, tr, cli.logging_en(), opts);
+    _exit(0);
+  }
+  PrintTime("Partition Time", t.Seconds());
+  cout << "Process grid: " << bfs.rows() << " x " << bfs.cols()
+       << ", edges held per rank: " << total_local / g_procs << endl;
+
+  SourcePicker<Graph> sp(g, cli.start_vertex());
+  auto BFSBound = [&] (const Graph &) {
+    NodeID source = sp.PickNext();
+    tr.Broadcast(ToBytes(&source, 1));
+    return bfs.Run(source, cli.logging_en(), opts);
+  };
+  SourcePicker<Graph> vsp(g, cli.start_vertex());
+  auto VerifierBound = [&vsp] (const Graph &g, const pvector<NodeID> &parent) {
+    return BFSVerifier(g, vsp.PickNext(), parent);
+  };
+  BenchmarkKernel(cli, g, BFSBound, PrintBFSStats, VerifierBound);
+  NodeID stop = -1;
+  tr.Broadcast(ToBytes(&stop, 1));
+  for (pid_t pid : children)
+    waitpid(pid, nullptr, 0);
+
+  const int trials = cli.num_trials();
+  cout << "Processes: " << g_procs << endl;
+  cout << "Traversed edges: " << g_dist.edges / trials << endl;
+  cout << "BFS Time (s): " << fixed << setprecision(6)
+       << g_dist.seconds / trials << endl;
+  cout << "Communication (MiB): " << setprecision(2)
+       << g_dist.bytes / double(1 << 20) / trials << " per BFS, "
+       << g_dist.bytes / 1024.0 / max<int64_t>(g_dist.levels, 1)
+       << " KiB per level" << endl;
+  if (g_dist.bitmap_sent > 0)
+    cout << "Bitmap compression: " << setprecision(1)
+         << double(g_dist.bitmap_raw) / g_dist.bitmap_sent << "x" << endl;
+  cout << "TEPS: " << setprecision(3)
+       << (g_dist.seconds > 0 ? g_dist.edges / g_dist.seconds : 0.0) << endl;
+  return 0;
+}
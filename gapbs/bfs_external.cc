@@ -0,0 +1,141 @@
+#include <iostream>
+#include <vector>
+#include <iomanip>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+
+#include "benchmark.h"
+#include "bfs_external.h"
+#include "bfs_kernel.h"
+#include "command_line.h"
+#include "graph.h"
+#include "graph_snapshot.h"
+#include "pvector.h"
+#include "timer.h"
+
+/*
+Semi-external BFS driver (bfs_external.h)
+
+The graph lives in a snapshot file, written beforehand by a run with
+--write-snapshot, which builds the graph from the usual -g/-u/-f options,
+writes it and exits. A BFS run never builds or maps a CSR Graph: it loads
+the header and offsets (ExternalGraph), refuses a snapshot built from other
+options, picks sources from the offsets and runs ExternalDOBFS each trial,
+reporting TEPS next to the I/O it took. -v uses ExternalBFSVerifier, which
+also reads the file, after the trial and before the next cache drop.
+
+Extra flags (stripped before CLApp sees them):
+  --snapshot=F        snapshot file (required)
+  --write-snapshot    build the graph, write F and exit
+  --block-kb=K        largest coalesced read in KiB (default 4096)
+  --read-ahead=K      blocks read ahead of the BFS (default 4)
+  --drop-cache=0|1    evict the file from the page cache before each trial
+                      (default 1)
+*/
+
+using namespace std;
+
+static string g_snapshot = "";
+static ExternalBFSOptions g_opts;
+static bool g_drop_cache = true;
+static bool g_write_snapshot = false;
+
+static void StripCustomArgs(int& argc, char** argv) {
+  int out = 1;
+  for (int i = 1; i < argc; ++i) {
+    string a = argv[i];
+    if (a.compare(0, 11, "--snapshot=") == 0) g_snapshot = a.substr(11);
+    else if (a == "--write-snapshot") g_write_snapshot = true;
+    else if (a.compare(0, 11, "--block-kb=") == 0)
+      g_opts.block_bytes = atol(a.c_str() + 11) << 10;
+    else if (a.compare(0, 13, "--read-ahead=") == 0)
+      g_opts.read_ahead = atoi(a.c_str() + 13);
+    else if (a.compare(0, 13, "--drop-cache=") == 0)
+      g_drop_cache = atoi(a.c_str() + 13) != 0;
+    else argv[out++] = argv[i];
+  }
+  argc = out;
+}
+
+int main(int argc, char* argv[]) {
+  StripCustomArgs(argc, argv);
+  CLApp cli(argc, argv, "semi-external breadth-first search");
+  if (!cli.ParseArgs()) return -1;
+  if (g_snapshot == "") {
+    cout << "--snapshot=F is required" << endl;
+    return -1;
+  }
+
+  SnapshotSource source = SnapshotSource::FromCLI(cli);
+  if (g_write_snapshot) {
+    Builder b(cli);
+    Graph g = b.MakeGraph();
+    g.PrintStats();
+    Timer tw;
+    tw.Start();
+    bool ok = WriteGraphSnapshot(g, g_snapshot, source);
+    tw.Stop();
+    if (!ok) {
+      cout << "Could not write snapshot " << g_snapshot << endl;
+      return -1;
+    }
+    PrintTime("Snapshot Write Time", tw.Seconds());
+    return 0;
+  }
+
+  Timer t;
+  t.Start();
+  ExternalGraph eg;
+  string err;
+  if (!eg.Open(g_snapshot, err, &source)) {
+    cout << "Snapshot: " << err << endl;
+    cout << "Write it first with --write-snapshot and the same graph options"
+         << endl;
+    return -1;
+  }
+  t.Stop();
+  PrintTime("Snapshot Open Time", t.Seconds());
+  cout << "In-memory state: " << fixed << setprecision(1)
+       << (eg.num_nodes() * (sizeof(NodeID) * 2 + 0.25 +
+                             sizeof(int64_t) * (eg.directed() ? 2 : 1)))
+          / (1 << 20)
+       << " MiB, on disk: "
+       << eg.num_edges_directed() * sizeof(NodeID) * (eg.directed() ? 2 : 1)
+          / double(1 << 20)
+       << " MiB" << endl;
+
+  SourcePicker<ExternalGraph> sp(eg, cli.start_vertex());
+  ExternalIOStats io;
+  double bfs_total = 0;
+  int64_t edges_total = 0;
+  auto BFSBound = [&] (const ExternalGraph &) {
+    if (g_drop_cache) eg.DropCache();
+    pvector<NodeID> parent = ExternalDOBFS(eg, sp.PickNext(), cli.logging_en(),
+                                           g_opts, io);
+    bfs_total += g_bfs_time_sec;
+    edges_total += g_traversed_edges;
+    return parent;
+  };
+  SourcePicker<ExternalGraph> vsp(eg, cli.start_vertex());
+  auto VerifierBound = [&vsp] (const ExternalGraph &eg,
+                               const pvector<NodeID> &parent) {
+    return ExternalBFSVerifier(eg, vsp.PickNext(), parent, g_opts);
+  };
+  BenchmarkKernel(cli, eg, BFSBound, PrintExternalBFSStats, VerifierBound);
+
+  const int trials = cli.num_trials();
+  cout << "Traversed edges: " << edges_total / trials << endl;
+  cout << "BFS Time (s): " << fixed << setprecision(6) << bfs_total / trials
+       << endl;
+  cout << "Read (MiB): " << setprecision(1)
+       << io.bytes / double(1 << 20) / trials << " in "
+       << io.reads / trials << " reads" << endl;
+  cout << "I/O Time (s): " << setprecision(6) << io.read_sec / trials
+       << " read, " << io.wait_sec / trials << " waited" << endl;
+  cout << "I/O Bandwidth (MB/s): " << setprecision(1)
+       << (bfs_total > 0 ? io.bytes / bfs_total / 1e6 : 0.0) << endl;
+  cout << "TEPS: " << setprecision(3)
+       << (bfs_total > 0 ? edges_total / bfs_total : 0.0) << endl;
+  return 0;
+}
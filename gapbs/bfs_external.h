@@ -0,0 +1,540 @@
+#ifndef BFS_EXTERNAL_H_
+#define BFS_EXTERNAL_H_
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cinttypes>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "benchmark.h"
+#include "bfs_kernel.h"
+#include "graph_snapshot.h"
+#include "pvector.h"
+#include "sliding_queue.h"
+#include "timer.h"
+#include "word_bitmap.h"
+
+/*
+Semi-external BFS over a graph snapshot (graph_snapshot.h)
+
+Vertex state (parent, the two frontier bitmaps, the queue) and the CSR
+offsets stay in memory: about 4 + 2/8 + 4 + 8 bytes per vertex and
+direction. Neighbor arrays stay on disk and are read with pread:
+
+  top-down   the frontier is sorted, and the adjacency lists of nearby
+             frontier vertices are merged into one read when the gap
+             between them is under kMaxGapBytes
+  bottom-up  the same over the still-unvisited vertices, which walks the
+             in-edge section front to back
+
+Reads go through a BlockReader thread that stays up to read_ahead blocks
+ahead of the step consuming them. Blocks are at most block_bytes unless a
+single adjacency list is larger. The direction switch is DOBFS's alpha/beta
+test, and scout counts come from the in-memory offsets.
+
+ExternalIOStats counts bytes and reads issued, time the reader spent in
+pread and time the BFS waited for a block. Drop the page cache between
+trials (ExternalGraph::DropCache) for numbers that reflect the device.
+
+ExternalGraph has num_nodes, out_degree and PrintStats, so SourcePicker
+and BenchmarkKernel take it in place of a Graph. ExternalBFSVerifier makes
+SerialBFSVerifier's checks with the adjacency lists streamed from the file:
+a level-synchronous reference BFS over the out-edges, then one pass over
+the in-edges of every reached vertex to find its parent edge.
+*/
+
+class ExternalGraph {
+ public:
+  ExternalGraph() : fd_(-1) {}
+  ~ExternalGraph() { if (fd_ >= 0) close(fd_); }
+  ExternalGraph(const ExternalGraph &) = delete;
+  ExternalGraph &operator=(const ExternalGraph &) = delete;
+
+  // Loads header and offsets; neighbor sections are left on disk. With
+  // expect set, a snapshot built from other options is refused.
+  bool Open(const std::string &path, std::string &err,
+            const SnapshotSource *expect = nullptr) {
+    fd_ = open(path.c_str(), O_RDONLY);
+    if (fd_ < 0) {
+      err = "cannot open " + path;
+      return false;
+    }
+    struct stat st;
+    if (fstat(fd_, &st) != 0 || !ReadFully(&header_, sizeof(header_), 0)) {
+      err = "cannot read " + path;
+      return false;
+    }
+    if (!CheckSnapshotHeader(header_, st.st_size, err))
+      return false;
+    if (expect != nullptr && !header_.source.Matches(*expect)) {
+      err = "built from " + header_.source.Describe() + ", not " +
+            expect->Describe();
+      return false;
+    }
+    out_offsets_ = pvector<int64_t>(header_.num_nodes + 1);
+    if (!ReadFully(out_offsets_.data(), out_offsets_.size() * sizeof(int64_t),
+                   header_.out_offsets_pos) ||
+        !CheckSnapshotOffsets(out_offsets_.data(), header_.num_nodes,
+                              header_.num_out)) {
+      err = "cannot read offsets from " + path;
+      return false;
+    }
+    if (directed()) {
+      in_offsets_ = pvector<int64_t>(header_.num_nodes + 1);
+      if (!ReadFully(in_offsets_.data(), in_offsets_.size() * sizeof(int64_t),
+                     header_.in_offsets_pos) ||
+          !CheckSnapshotOffsets(in_offsets_.data(), header_.num_nodes,
+                                header_.num_in)) {
+        err = "cannot read offsets from " + path;
+        return false;
+      }
+    }
+    return true;
+  }
+
+  int64_t num_nodes() const { return header_.num_nodes; }
+  int64_t num_edges() const {
+    return directed() ? header_.num_out : header_.num_out / 2;
+  }
+  int64_t num_edges_directed() const { return header_.num_out; }
+  bool directed() const { return header_.flags & SnapshotHeader::kDirected; }
+
+  void PrintStats() const {
+    std::cout << "Graph has " << num_nodes() << " nodes and " << num_edges()
+              << " " << (directed() ? "" : "un") << "directed edges for "
+              << "degree: " << num_edges() / num_nodes() << std::endl;
+  }
+
+  int64_t out_degree(NodeID v) const {
+    return out_offsets_[v + 1] - out_offsets_[v];
+  }
+
+  // Offsets and file position of one direction's neighbor section
+  const pvector<int64_t>& offsets(bool in) const {
+    return in && directed() ? in_offsets_ : out_offsets_;
+  }
+  uint64_t neigh_pos(bool in) const {
+    return in && directed() ? header_.in_neigh_pos : header_.out_neigh_pos;
+  }
+
+  bool ReadFully(void *buf, size_t bytes, uint64_t pos) const {
+    char *dst = static_cast<char*>(buf);
+    while (bytes > 0) {
+      ssize_t got = pread(fd_, dst, bytes, pos);
+      if (got <= 0) return false;
+      dst += got;
+      pos += got;
+      bytes -= got;
+    }
+    return true;
+  }
+
+  // Evicts the file's clean pages so the next trial reads from the device
+  void DropCache() const {
+#ifdef POSIX_FADV_DONTNEED
+    posix_fadvise(fd_, 0, 0, POSIX_FADV_DONTNEED);
+#endif
+  }
+
+ private:
+  int fd_;
+  SnapshotHeader header_;
+  pvector<int64_t> out_offsets_;
+  pvector<int64_t> in_offsets_;
+};
+
+struct ExternalIOStats {
+  int64_t bytes = 0;
+  int64_t reads = 0;
+  double read_sec = 0;          // reader thread inside pread
+  double wait_sec = 0;          // BFS blocked waiting for a block
+
+  void Add(const ExternalIOStats &o) {
+    bytes += o.bytes;
+    reads += o.reads;
+    read_sec += o.read_sec;
+    wait_sec += o.wait_sec;
+  }
+};
+
+// Neighbors of the vertices [first, last), read as one range
+struct AdjacencyBlock {
+  NodeID first;
+  NodeID last;
+  int64_t base;                 // offset of first's list in the section
+  std::vector<NodeID> data;
+};
+
+// Reads a list of vertex ranges in order on a helper thread, at most
+// read_ahead blocks ahead of the consumer
+class BlockReader {
+ public:
+  BlockReader(const ExternalGraph &eg, bool in_edges,
+              const std::vector<std::pair<NodeID, NodeID>> &ranges,
+              int read_ahead)
+      : eg_(eg), in_(in_edges), ranges_(ranges),
+        read_ahead_(std::max(read_ahead, 1)), done_(false), failed_(false) {
+    thread_ = std::thread(&BlockReader::Run, this);
+  }
+
+  ~BlockReader() {
+    {
+      std::lock_guard<std::mutex> lock(mu_);
+      done_ = true;
+    }
+    cv_.notify_all();
+    thread_.join();
+  }
+
+  // Next block in request order; false once all have been handed out
+  bool Next(AdjacencyBlock &block) {
+    Timer t;
+    t.Start();
+    std::unique_lock<std::mutex> lock(mu_);
+    cv_.wait(lock, [this] {
+      return !ready_.empty() || next_read_ == ranges_.size() || failed_;
+    });
+    t.Stop();
+    stats_.wait_sec += t.Seconds();
+    if (ready_.empty())
+      return false;
+    if (block.data.capacity() > 0)
+      spare_.push_back(std::move(block.data));
+    block = std::move(ready_.front());
+    ready_.pop_front();
+    cv_.notify_all();
+    return true;
+  }
+
+  bool failed() const { return failed_; }
+  const ExternalIOStats& stats() const { return stats_; }
+
+ private:
+  void Run() {
+    const pvector<int64_t> &off = eg_.offsets(in_);
+    const uint64_t pos = eg_.neigh_pos(in_);
+    std::unique_lock<std::mutex> lock(mu_);
+    for (size_t i = 0; i < ranges_.size(); i++) {
+      cv_.wait(lock, [this] {
+        return done_ || (int) ready_.size() < read_ahead_;
+      });
+      if (done_) return;
+      AdjacencyBlock block;
+      if (!spare_.empty()) {
+        block.data = std::move(spare_.back());
+        spare_.pop_back();
+      }
+      lock.unlock();
+      block.first = ranges_[i].first;
+      block.last = ranges_[i].second;
+      block.base = off[block.first];
+      int64_t count = off[block.last] - block.base;
+      block.data.resize(count);
+      Timer t;
+      t.Start();
+      bool ok = eg_.ReadFully(block.data.data(), count * sizeof(NodeID),
+                              pos + block.base * sizeof(NodeID));
+      t.Stop();
+      lock.lock();
+      stats_.read_sec += t.Seconds();
+      stats_.bytes += count * sizeof(NodeID);
+      stats_.reads++;
+      next_read_ = i + 1;
+      if (!ok) {
+        failed_ = true;
+        next_read_ = ranges_.size();
+        cv_.notify_all();
+        return;
+      }
+      ready_.push_back(std::move(block));
+      cv_.notify_all();
+    }
+  }
+
+  const ExternalGraph &eg_;
+  bool in_;
+  std::vector<std::pair<NodeID, NodeID>> ranges_;
+  int read_ahead_;
+  std::mutex mu_;
+  std::condition_variable cv_;
+  std::deque<AdjacencyBlock> ready_;
+  std::vector<std::vector<NodeID>> spare_;
+  size_t next_read_ = 0;
+  bool done_;
+  bool failed_;
+  ExternalIOStats stats_;
+  std::thread thread_;
+};
+
+struct ExternalBFSOptions {
+  int64_t block_bytes = 4 << 20;
+  int read_ahead = 4;
+  int alpha = 15;
+  int beta = 18;
+};
+
+static const int64_t kMaxGapBytes = 64 << 10;
+
+// Groups sorted vertices into read ranges: a range grows while the bytes
+// skipped to reach the next vertex stay under kMaxGapBytes and the range
+// stays under block_bytes
+inline std::vector<std::pair<NodeID, NodeID>> PlanReads(
+    const pvector<int64_t> &off, const NodeID *vs, int64_t count,
+    int64_t block_bytes) {
+  std::vector<std::pair<NodeID, NodeID>> ranges;
+  const int64_t node_bytes = sizeof(NodeID);
+  for (int64_t i = 0; i < count; ) {
+    NodeID first = vs[i], last = vs[i] + 1;
+    for (i++; i < count; i++) {
+      NodeID v = vs[i];
+      int64_t gap = (off[v] - off[last]) * node_bytes;
+      int64_t size = (off[v + 1] - off[first]) * node_bytes;
+      if (gap > kMaxGapBytes || size > block_bytes)
+        break;
+      last = v + 1;
+    }
+    ranges.push_back(std::make_pair(first, last));
+  }
+  return ranges;
+}
+
+// Calls f(v, neighbors, degree) for every vertex of the sorted list vs,
+// reading its adjacency list from disk; returns false on a read error
+template <typename F>
+bool StreamAdjacency(const ExternalGraph &eg, bool in_edges, const NodeID *vs,
+                     int64_t count, const ExternalBFSOptions &opts,
+                     ExternalIOStats &io, F f) {
+  const pvector<int64_t> &off = eg.offsets(in_edges);
+  BlockReader reader(eg, in_edges, PlanReads(off, vs, count,
+                                             opts.block_bytes),
+                     opts.read_ahead);
+  AdjacencyBlock block;
+  int64_t i = 0;
+  while (i < count && reader.Next(block)) {
+    for (; i < count && vs[i] < block.last; i++) {
+      NodeID v = vs[i];
+      f(v, block.data.data() + (off[v] - block.base), off[v + 1] - off[v]);
+    }
+  }
+  io.Add(reader.stats());
+  return !reader.failed() && i == count;
+}
+
+template <typename QueueT>
+int64_t ExternalTDStep(const ExternalGraph &eg, pvector<NodeID> &parent,
+                       QueueT &queue, const ExternalBFSOptions &opts,
+                       int64_t &edges_visited, ExternalIOStats &io,
+                       bool &ok) {
+  int64_t scout_count = 0;
+  std::sort(queue.begin(), queue.end());
+  QueueBuffer<NodeID> lqueue(queue);
+  ok = StreamAdjacency(eg, false, queue.begin(), queue.size(), opts, io,
+      [&](NodeID u, const NodeID *neigh, int64_t degree) {
+        for (int64_t k = 0; k < degree; k++) {
+          NodeID v = neigh[k];
+          edges_visited++;
+          NodeID curr_val = parent[v];
+          if (curr_val < 0) {
+            parent[v] = u;
+            lqueue.push_back(v);
+            scout_count += -curr_val;
+          }
+        }
+      });
+  lqueue.flush();
+  return scout_count;
+}
+
+inline int64_t ExternalBUStep(const ExternalGraph &eg, pvector<NodeID> &parent,
+                              const WordBitmap &front, WordBitmap &next,
+                              std::vector<NodeID> &unvisited,
+                              const ExternalBFSOptions &opts,
+                              int64_t &edges_visited, ExternalIOStats &io,
+                              bool &ok) {
+  int64_t awake_count = 0;
+  next.reset();
+  unvisited.clear();
+  for (NodeID u = 0; u < eg.num_nodes(); u++)
+    if (parent[u] < 0 && eg.offsets(true)[u + 1] != eg.offsets(true)[u])
+      unvisited.push_back(u);
+  ok = StreamAdjacency(eg, true, unvisited.data(), unvisited.size(), opts, io,
+      [&](NodeID u, const NodeID *neigh, int64_t degree) {
+        for (int64_t k = 0; k < degree; k++) {
+          edges_visited++;
+          if (front.get_bit(neigh[k])) {
+            parent[u] = neigh[k];
+            awake_count++;
+            next.set_bit(u);
+            break;
+          }
+        }
+      });
+  return awake_count;
+}
+
+// DOBFS over an ExternalGraph; io accumulates the trial's I/O
+inline pvector<NodeID> ExternalDOBFS(const ExternalGraph &eg, NodeID source,
+                                     bool logging_enabled,
+                                     const ExternalBFSOptions &opts,
+                                     ExternalIOStats &io) {
+  if (logging_enabled) PrintStep("Source", static_cast<int64_t>(source));
+  Timer t;
+  t.Start();
+  pvector<NodeID> parent(eg.num_nodes());
+  #pragma omp parallel for
+  for (NodeID n = 0; n < eg.num_nodes(); n++)
+    parent[n] = eg.out_degree(n) != 0 ? -eg.out_degree(n) : -1;
+  parent[source] = source;
+  t.Stop();
+  if (logging_enabled) PrintStep("i", t.Seconds());
+
+  Timer t_total;
+  t_total.Start();
+  int64_t traversed_edges = 0;
+  SlidingQueue<NodeID> queue(eg.num_nodes());
+  queue.push_back(source);
+  queue.slide_window();
+  WordBitmap curr(eg.num_nodes()); curr.reset();
+  WordBitmap front(eg.num_nodes()); front.reset();
+  std::vector<NodeID> unvisited;
+  int64_t edges_to_check = eg.num_edges_directed();
+  int64_t scout_count = eg.out_degree(source);
+  bool ok = true;
+  while (!queue.empty() && ok) {
+    if (scout_count > edges_to_check / opts.alpha) {
+      int64_t awake_count, old_awake_count;
+      front.reset();
+      TIME_OP(t, QueueToBitmap<kMetricsNone>(queue, front));
+      if (logging_enabled) PrintStep("e", t.Seconds());
+      awake_count = queue.size();
+      queue.slide_window();
+      do {
+        t.Start();
+        old_awake_count = awake_count;
+        awake_count = ExternalBUStep(eg, parent, front, curr, unvisited, opts,
+                                     traversed_edges, io, ok);
+        front.swap(curr);
+        t.Stop();
+        if (logging_enabled) PrintStep("bu", t.Seconds(), awake_count);
+      } while (ok && ((awake_count >= old_awake_count) ||
+                      (awake_count > eg.num_nodes() / opts.beta)));
+      TIME_OP(t, BitmapToQueue<kMetricsNone>(front, queue));
+      if (logging_enabled) PrintStep("c", t.Seconds());
+      scout_count = 1;
+    } else {
+      t.Start();
+      edges_to_check -= scout_count;
+      scout_count = ExternalTDStep(eg, parent, queue, opts, traversed_edges,
+                                   io, ok);
+      queue.slide_window();
+      t.Stop();
+      if (logging_enabled) PrintStep("td", t.Seconds(), queue.size());
+    }
+  }
+  if (!ok)
+    std::cout << "Read error; BFS result is incomplete" << std::endl;
+
+  #pragma omp parallel for
+  for (NodeID n = 0; n < eg.num_nodes(); n++)
+    if (parent[n] < -1) parent[n] = -1;
+
+  t_total.Stop();
+  g_traversed_edges = traversed_edges;
+  g_bfs_time_sec = t_total.Seconds();
+  return parent;
+}
+
+inline void PrintExternalBFSStats(const ExternalGraph &eg,
+                                  const pvector<NodeID> &bfs_tree) {
+  int64_t tree_size = 0, n_edges = 0;
+  for (NodeID n = 0; n < eg.num_nodes(); n++) {
+    if (bfs_tree[n] >= 0) { n_edges += eg.out_degree(n); tree_size++; }
+  }
+  std::cout << "BFS Tree has " << tree_size << " nodes and " << n_edges
+            << " edges" << std::endl;
+}
+
+// SerialBFSVerifier (bfs_verify.h) with adjacency lists read from the file
+inline bool ExternalBFSVerifier(const ExternalGraph &eg, NodeID source,
+                                const pvector<NodeID> &parent,
+                                const ExternalBFSOptions &opts) {
+  using std::cout;
+  using std::endl;
+  ExternalIOStats io;
+  pvector<int> depth(eg.num_nodes(), -1);
+  depth[source] = 0;
+  std::vector<NodeID> frontier(1, source), next;
+  while (!frontier.empty()) {
+    next.clear();
+    bool ok = StreamAdjacency(eg, false, frontier.data(), frontier.size(),
+                              opts, io,
+        [&](NodeID u, const NodeID *neigh, int64_t degree) {
+          for (int64_t k = 0; k < degree; k++) {
+            NodeID v = neigh[k];
+            if (depth[v] == -1) {
+              depth[v] = depth[u] + 1;
+              next.push_back(v);
+            }
+          }
+        });
+    if (!ok) {
+      cout << "Read error during verification" << endl;
+      return false;
+    }
+    std::sort(next.begin(), next.end());
+    frontier.swap(next);
+  }
+  std::vector<NodeID> reached;
+  for (NodeID u = 0; u < eg.num_nodes(); u++) {
+    if ((depth[u] != -1) && (parent[u] != -1)) {
+      if (u == source) {
+        if (!((parent[u] == u) && (depth[u] == 0))) {
+          cout << "Source wrong" << endl;
+          return false;
+        }
+        continue;
+      }
+      reached.push_back(u);
+    } else if (depth[u] != parent[u]) {
+      cout << "Reachability mismatch" << endl;
+      return false;
+    }
+  }
+  bool pass = true;
+  bool ok = StreamAdjacency(eg, true, reached.data(), reached.size(), opts,
+                            io,
+      [&](NodeID u, const NodeID *neigh, int64_t degree) {
+        if (!pass) return;
+        for (int64_t k = 0; k < degree; k++) {
+          NodeID v = neigh[k];
+          if (v == parent[u]) {
+            if (depth[v] != depth[u] - 1) {
+              cout << "Wrong depths for " << u << " & " << v << endl;
+              pass = false;
+            }
+            return;
+          }
+        }
+        cout << "Couldn't find edge from " << parent[u] << " to " << u
+             << endl;
+        pass = false;
+      });
+  if (!ok) {
+    cout << "Read error during verification" << endl;
+    return false;
+  }
+  return pass;
+}
+
+#endif  // BFS_EXTERNAL_H_
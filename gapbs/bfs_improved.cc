@@ -2,297 +2,267 @@
 #include <vector>
 #include <iomanip>
 #include <cstdint>   // added
+#include <functional>
 
+#include "bench_runner.h"
 #include "benchmark.h"
-#include "bitmap.h"
+#include "bfs_kernel.h"
+#include "bfs_metrics.h"
 #include "builder.h"
+#include "cache_sim.h"
 #include "command_line.h"
 #include "graph.h"
-#include "platform_atomics.h"
+#include "graph_snapshot.h"
+#include "machine_profile.h"
 #include "pvector.h"
-#include "sliding_queue.h"
-#include "timer.h"
+#include "switch_tuning.h"
 
 #include <cstdint>
 
 using namespace std;
 
-// Global stats for final report (unchanged)
-static int64_t g_traversed_edges = 0;
-static double  g_bfs_time_sec    = 0.0;
+// Optimization toggles via simple argv parsing (kernel in bfs_kernel.h)
+static BFSOptions g_opts;            // visited-byte on, prefetch off by default
 
-// New: optimization toggles via simple argv parsing
-static bool g_opt_visited = true;   // enable visited-byte optimization by default
-static bool g_opt_prefetch = false; // prefetch off by default (iterator dependent)
+// Direction switching: fixed alpha/beta unless --adaptive=1
+static bool g_calibrate = false;     // sweep alpha/beta, save, exit
+static bool g_compare = false;       // fixed vs calibrated vs adaptive, exit
+static string g_tune_file = "";      // per-class alpha/beta (load/save)
+static string g_graph_class = "";    // defaults to GraphClassName(cli)
 
-// Metrics (extended): split visited-byte accesses from bitmap(front/curr)
-struct BfsMemMetrics {
-  int64_t col_ind_reads      = 0; // CSR neighbor index loads
-  int64_t parent_reads       = 0; // parent/visited reads (parent array)
-  int64_t parent_writes      = 0; // parent writes on discovery
-  int64_t frontier_pushes    = 0; // queue enqueues
-  int64_t bitmap_reads       = 0; // frontier/curr bitmap get_bit
-  int64_t bitmap_writes      = 0; // frontier/curr bitmap set_bit
-  int64_t visited_byte_reads = 0; // reads from visited[] byte array (new)
-  int64_t visited_byte_writes= 0; // writes to visited[] byte array (new)
-};
-static BfsMemMetrics g_metrics;
+static MetricsLevel g_metrics_level = kMetricsCounts;
+
+// Reuse one BfsWorkspace across trials (0 = allocate every trial, as before)
+static bool g_reuse_workspace = true;
+
+// Graph snapshot (graph_snapshot.h): mmap if present, else build and save
+static string g_snapshot = "";
+static SnapshotPrefault g_prefault = kPrefaultNone;
+
+// Per-step trace file (bfs_trace.h); .csv for CSV, anything else binary
+static string g_trace_file = "";
+static bool g_trace_counters = false;
+
+// Cache model fed by the metrics points (cache_sim.h); needs exact counts
+static bool g_cache_sim = false;
+static CacheSimConfig g_cache_config;
+
+// Region summary (region_tracer.h), plus a Chrome trace if a file is given
+static bool g_regions = false;
+static string g_regions_file = "";
+
+// Pinning, priority and repeat-until-stable sampling (bench_runner.h)
+static RunnerOptions g_runner;
 
 // Optional: simple custom arg stripper so CLApp doesn't see our flags
 static void StripCustomArgs(int& argc, char** argv) {
   int out = 1;
   for (int i = 1; i < argc; ++i) {
     string a = argv[i];
-    if (a == "--opt-visited=0") g_opt_visited = false;
-    else if (a == "--opt-visited=1") g_opt_visited = true;
-    else if (a == "--opt-prefetch=1") g_opt_prefetch = true;
-    else if (a == "--opt-prefetch=0") g_opt_prefetch = false;
+    if (a == "--opt-visited=0") g_opts.visited = false;
+    else if (a == "--opt-visited=1") g_opts.visited = true;
+    else if (a == "--opt-prefetch=1") g_opts.prefetch = true;
+    else if (a == "--opt-prefetch=0") g_opts.prefetch = false;
+    else if (a == "--opt-parallel=1") g_opts.parallel = true;
+    else if (a == "--opt-parallel=0") g_opts.parallel = false;
+    else if (a == "--opt-balanced=1") g_opts.balanced = true;
+    else if (a == "--opt-balanced=0") g_opts.balanced = false;
+    else if (a == "--adaptive=1") g_opts.adaptive = true;
+    else if (a == "--adaptive=0") g_opts.adaptive = false;
+    else if (a == "--calibrate=1") g_calibrate = true;
+    else if (a == "--compare=1") g_compare = true;
+    else if (a == "--reuse-workspace=1") g_reuse_workspace = true;
+    else if (a == "--reuse-workspace=0") g_reuse_workspace = false;
+    else if (a.compare(0, 12, "--tune-file=") == 0) g_tune_file = a.substr(12);
+    else if (a.compare(0, 14, "--graph-class=") == 0) g_graph_class = a.substr(14);
+    else if (a.compare(0, 10, "--metrics=") == 0) {
+      if (!ParseMetricsLevel(a.substr(10), g_metrics_level))
+        cout << "Unknown metrics level " << a.substr(10) << endl;
+    }
+    else if (a.compare(0, 17, "--metrics-sample=") == 0)
+      g_metrics_bank.set_sample_every(atol(a.c_str() + 17));
+    else if (a.compare(0, 11, "--snapshot=") == 0) g_snapshot = a.substr(11);
+    else if (a.compare(0, 20, "--snapshot-prefault=") == 0) {
+      if (!ParseSnapshotPrefault(a.substr(20), g_prefault))
+        cout << "Unknown prefault mode " << a.substr(20) << endl;
+    }
+    else if (a.compare(0, 8, "--trace=") == 0) g_trace_file = a.substr(8);
+    else if (a == "--trace-counters=1") g_trace_counters = true;
+    else if (a == "--trace-counters=0") g_trace_counters = false;
+    else if (a.compare(0, 12, "--cache-sim=") == 0) {
+      g_cache_sim = CacheSimConfig::Parse(a.substr(12), g_cache_config);
+      if (!g_cache_sim)
+        cout << "Bad cache spec " << a.substr(12) << endl;
+    }
+    else if (a == "--regions") g_regions = true;
+    else if (a.compare(0, 10, "--regions=") == 0) {
+      g_regions = true;
+      g_regions_file = a.substr(10);
+    }
+    else if (a == "--cache-prefetch=1") g_cache_config.prefetch = true;
+    else if (a == "--cache-prefetch=0") g_cache_config.prefetch = false;
+    else if (ParseVerifyArg(a, g_verify)) continue;
+    else if (ParseRunnerArg(a, g_runner)) continue;
     else argv[out++] = argv[i];
   }
   argc = out;
 }
 
-// Bottom-up step (unchanged semantics; metrics kept)
-int64_t BUStep(const Graph &g, pvector<NodeID> &parent, Bitmap &front,
-               Bitmap &next, int64_t &edges_visited) {
-  int64_t awake_count = 0;
-  next.reset();
-  for (NodeID u = 0; u < g.num_nodes(); u++) {
-    g_metrics.parent_reads++;                 // read parent[u] state
-    if (parent[u] < 0) {
-      for (NodeID v : g.in_neigh(u)) {
-        edges_visited++;
-        g_metrics.col_ind_reads++;            // in-neighbor index
-        g_metrics.bitmap_reads++;             // front.get_bit
-        if (front.get_bit(v)) {
-          parent[u] = v;
-          g_metrics.parent_writes++;          // write parent
-          awake_count++;
-          next.set_bit(u);
-          g_metrics.bitmap_writes++;          // write next bitmap
-          break;                              // early exit
-        }
+// Offline calibration: time the same sources under every alpha/beta pair
+// in a small grid and keep the fastest. Uses cli.num_trials() sources.
+void CalibrateSwitch(const Graph &g, const CLApp &cli, int &best_alpha,
+                     int &best_beta) {
+  BFSOptions opts = g_opts;
+  opts.adaptive = false;
+  const int alphas[] = {2, 4, 8, 15, 30, 60, 120};
+  const int betas[]  = {6, 12, 18, 24, 48, 96};
+  vector<NodeID> sources;
+  SourcePicker<Graph> sp(g, cli.start_vertex());
+  for (int i = 0; i < cli.num_trials(); i++)
+    sources.push_back(sp.PickNext());
+  double best_time = -1;
+  BfsWorkspace ws(g);
+  for (int a : alphas) {
+    for (int b : betas) {
+      double total = 0;
+      for (NodeID source : sources) {
+        opts.alpha = a;
+        opts.beta = b;
+        DOBFS<kMetricsNone>(g, source, false, opts, ws);
+        total += g_bfs_time_sec;
+      }
+      cout << "calibrate alpha=" << setw(3) << a << " beta=" << setw(3) << b
+           << "  " << fixed << setprecision(6) << total << " s" << endl;
+      if (best_time < 0 || total < best_time) {
+        best_time = total;
+        best_alpha = a;
+        best_beta = b;
       }
     }
   }
-  return awake_count;
 }
 
-// Top-down step with optional visited-byte fast path
-int64_t TDStep(const Graph &g, pvector<NodeID> &parent,
-               SlidingQueue<NodeID> &queue, int64_t &edges_visited,
-               uint8_t* visited_bytes_or_null) {
-  const bool use_visited = g_opt_visited && (visited_bytes_or_null != nullptr);
-  uint8_t* visited = visited_bytes_or_null;
-  int64_t scout_count = 0;
-  QueueBuffer<NodeID> lqueue(queue);
-
-  for (auto q_iter = queue.begin(); q_iter < queue.end(); q_iter++) {
-    NodeID u = *q_iter;
-    for (NodeID v : g.out_neigh(u)) {
-      edges_visited++;
-      g_metrics.col_ind_reads++;              // neighbor index load
-
-      // Fast reject via visited byte before touching parent[v]
-      if (use_visited) {
-        g_metrics.visited_byte_reads++;
-        if (visited[v]) continue;             // already visited: skip
-      }
-
-      // Fallback/confirm via parent array
-      NodeID curr_val = parent[v];
-      g_metrics.parent_reads++;               // parent read
-      if (curr_val < 0) {
-        // Found an undiscovered vertex; mark visited first (single-thread)
-        if (use_visited) {
-          if (!visited[v]) {
-            visited[v] = 1;
-            g_metrics.visited_byte_writes++;
-          }
-        }
-        // Publish parent and enqueue
-        if (compare_and_swap(parent[v], curr_val, u)) {
-          lqueue.push_back(v);
-          g_metrics.frontier_pushes++;
-          scout_count += -curr_val;           // degree stored as negative
-        }
+// Fixed 15/18 vs the calibrated pair vs the cost model (seeded with the
+// calibrated pair), on the same cli.num_trials() sources. The three run
+// back to back per source so drift hits them alike. Switching changes how
+// many edges a BFS examines, so TEPS here divides the edges of the reached
+// component (as Graph500 does), the same for all three.
+void CompareSwitch(const Graph &g, const CLApp &cli, int tuned_alpha,
+                   int tuned_beta) {
+  const char *names[] = {"fixed", "calibrated", "adaptive"};
+  BFSOptions configs[3] = {g_opts, g_opts, g_opts};
+  configs[0].alpha = BFSOptions().alpha;
+  configs[0].beta = BFSOptions().beta;
+  configs[0].adaptive = false;
+  configs[1].alpha = configs[2].alpha = tuned_alpha;
+  configs[1].beta = configs[2].beta = tuned_beta;
+  configs[1].adaptive = false;
+  configs[2].adaptive = true;
+  double seconds[3] = {0, 0, 0};
+  int64_t examined[3] = {0, 0, 0};
+  int64_t component_edges = 0;
+  SourcePicker<Graph> sp(g, cli.start_vertex());
+  BfsWorkspace ws(g);
+  for (int i = 0; i < cli.num_trials(); i++) {
+    NodeID source = sp.PickNext();
+    for (int c = 0; c < 3; c++) {
+      const pvector<NodeID> &parent =
+          DOBFS<kMetricsNone>(g, source, false, configs[c], ws);
+      seconds[c] += g_bfs_time_sec;
+      examined[c] += g_traversed_edges;
+      if (c == 0) {
+        for (NodeID n = 0; n < g.num_nodes(); n++)
+          if (parent[n] >= 0) component_edges += g.out_degree(n);
       }
     }
   }
-  lqueue.flush();
-  return scout_count;
-}
-
-void QueueToBitmap(const SlidingQueue<NodeID> &queue, Bitmap &bm) {
-  for (auto q_iter = queue.begin(); q_iter < queue.end(); q_iter++) {
-    NodeID u = *q_iter;
-    bm.set_bit_atomic(u);
-    g_metrics.bitmap_writes++;
-  }
-}
-
-void BitmapToQueue(const Graph &g, const Bitmap &bm,
-                   SlidingQueue<NodeID> &queue) {
-  QueueBuffer<NodeID> lqueue(queue);
-  for (NodeID n = 0; n < g.num_nodes(); n++) {
-    g_metrics.bitmap_reads++;
-    if (bm.get_bit(n)) {
-      lqueue.push_back(n);
-      g_metrics.frontier_pushes++;
-    }
+  const int trials = cli.num_trials();
+  cout << left << setw(12) << "Switch" << right << setw(7) << "alpha"
+       << setw(6) << "beta" << setw(14) << "BFS Time (s)" << setw(14)
+       << "examined" << setw(12) << "TEPS" << setw(10) << "vs fixed"
+       << endl;
+  for (int c = 0; c < 3; c++) {
+    const double teps = seconds[c] > 0 ? component_edges / seconds[c] : 0;
+    cout << left << setw(12) << names[c] << right << setw(7)
+         << configs[c].alpha << setw(6) << configs[c].beta << fixed
+         << setprecision(6) << setw(14) << seconds[c] / trials
+         << setw(14) << examined[c] / trials << scientific
+         << setprecision(3) << setw(12) << teps << fixed << setprecision(2)
+         << setw(9) << (seconds[c] > 0 ? seconds[0] / seconds[c] : 0.0)
+         << "x" << endl;
   }
-  lqueue.flush();
-  queue.slide_window();
-}
-
-pvector<NodeID> InitParent(const Graph &g) {
-  pvector<NodeID> parent(g.num_nodes());
-  for (NodeID n = 0; n < g.num_nodes(); n++)
-    parent[n] = g.out_degree(n) != 0 ? -g.out_degree(n) : -1;
-  return parent;
 }
 
-pvector<NodeID> DOBFS(const Graph &g, NodeID source, bool logging_enabled = false,
-                      int alpha = 15, int beta = 18) {
-  if (logging_enabled) PrintStep("Source", static_cast<int64_t>(source));
-
-  Timer t;
-  t.Start();
-  pvector<NodeID> parent = InitParent(g);
-  t.Stop();
-  if (logging_enabled) PrintStep("i", t.Seconds());
-
-  parent[source] = source;
-
-  // Optional visited-byte array (single-threaded)
-  vector<uint8_t> visited_vec;
-  uint8_t* visited_ptr = nullptr;
-  if (g_opt_visited) {
-    visited_vec.assign(g.num_nodes(), 0);
-    visited_vec[source] = 1;
-    visited_ptr = visited_vec.data();
-    g_metrics.visited_byte_writes++;          // source mark
-  }
-
-  Timer t_total;
-  t_total.Start();
-  int64_t traversed_edges = 0;
-
-  SlidingQueue<NodeID> queue(g.num_nodes());
-  queue.push_back(source);
-  queue.slide_window();
-  Bitmap curr(g.num_nodes()); curr.reset();
-  Bitmap front(g.num_nodes()); front.reset();
-  int64_t edges_to_check = g.num_edges_directed();
-  int64_t scout_count = g.out_degree(source);
+int main(int argc, char* argv[]) {
+  // Strip our custom flags so CLApp parses cleanly
+  StripCustomArgs(argc, argv);
+  // Before any timer starts: enabling calibrates the TSC for 20 ms
+  if (g_regions) RegionTracer::SetEnabled(true);
+  Timer t_startup;
+  t_startup.Start();
 
-  while (!queue.empty()) {
-    if (scout_count > edges_to_check / alpha) {
-      int64_t awake_count, old_awake_count;
-      TIME_OP(t, QueueToBitmap(queue, front));
-      if (logging_enabled) PrintStep("e", t.Seconds());
-      awake_count = queue.size();
-      queue.slide_window();
-      do {
-        t.Start();
-        old_awake_count = awake_count;
-        awake_count = BUStep(g, parent, front, curr, traversed_edges);
-        front.swap(curr);
-        t.Stop();
-        if (logging_enabled) PrintStep("bu", t.Seconds(), awake_count);
-      } while ((awake_count >= old_awake_count) ||
-               (awake_count > g.num_nodes() / beta));
-      TIME_OP(t, BitmapToQueue(g, front, queue));
-      if (logging_enabled) PrintStep("c", t.Seconds());
-      scout_count = 1;
-    } else {
-      t.Start();
-      edges_to_check -= scout_count;
-      scout_count = TDStep(g, parent, queue, traversed_edges, visited_ptr);
-      queue.slide_window();
-      t.Stop();
-      if (logging_enabled) PrintStep("td", t.Seconds(), queue.size());
-    }
+  CLApp cli(argc, argv, "breadth-first search");
+  if (!cli.ParseArgs()) return -1;
+  // Before the graph is built, so its pages and the OpenMP pool follow
+  ScopedSchedule schedule(g_runner);
+
+  GraphProvider provider;
+  const Graph &g = provider.Get(cli, g_snapshot, g_prefault);
+
+  int &alpha = g_opts.alpha, &beta = g_opts.beta;
+  if (g_graph_class == "") g_graph_class = GraphClassName(cli);
+  if (g_calibrate) {
+    CalibrateSwitch(g, cli, alpha, beta);
+    cout << "Tuned " << g_graph_class << ": alpha=" << alpha
+         << " beta=" << beta << endl;
+    if (g_tune_file != "" &&
+        !SaveSwitchParams(g_tune_file, g_graph_class, alpha, beta))
+      cout << "Could not write " << g_tune_file << endl;
+    return 0;
   }
-
-  for (NodeID n = 0; n < g.num_nodes(); n++)
-    if (parent[n] < -1) parent[n] = -1;
-
-  t_total.Stop();
-  g_traversed_edges = traversed_edges;
-  g_bfs_time_sec    = t_total.Seconds();
-  return parent;
-}
-
-void PrintBFSStats(const Graph &g, const pvector<NodeID> &bfs_tree) {
-  int64_t tree_size = 0, n_edges = 0;
-  for (NodeID n : g.vertices()) {
-    if (bfs_tree[n] >= 0) { n_edges += g.out_degree(n); tree_size++; }
+  bool tuned = false;
+  if (g_tune_file != "" &&
+      LoadSwitchParams(g_tune_file, g_graph_class, alpha, beta)) {
+    cout << "Using tuned " << g_graph_class << ": alpha=" << alpha
+         << " beta=" << beta << endl;
+    tuned = true;
   }
-  cout << "BFS Tree has " << tree_size << " nodes and " << n_edges << " edges" << endl;
-}
-
-// BFS verifier (unchanged)
-bool BFSVerifier(const Graph &g, NodeID source,
-                 const pvector<NodeID> &parent) {
-  pvector<int> depth(g.num_nodes(), -1);
-  depth[source] = 0;
-  vector<NodeID> to_visit;
-  to_visit.reserve(g.num_nodes());
-  to_visit.push_back(source);
-  for (auto it = to_visit.begin(); it != to_visit.end(); it++) {
-    NodeID u = *it;
-    for (NodeID v : g.out_neigh(u)) {
-      if (depth[v] == -1) {
-        depth[v] = depth[u] + 1;
-        to_visit.push_back(v);
-      }
+  if (g_compare) {
+    int tuned_alpha = alpha, tuned_beta = beta;
+    if (!tuned) {
+      CalibrateSwitch(g, cli, tuned_alpha, tuned_beta);
+      cout << "Tuned " << g_graph_class << ": alpha=" << tuned_alpha
+           << " beta=" << tuned_beta << endl;
     }
+    CompareSwitch(g, cli, tuned_alpha, tuned_beta);
+    return 0;
   }
-  for (NodeID u : g.vertices()) {
-    if ((depth[u] != -1) && (parent[u] != -1)) {
-      if (u == source) {
-        if (!((parent[u] == u) && (depth[u] == 0))) {
-          cout << "Source wrong" << endl;
-          return false;
-        }
-        continue;
-      }
-      bool parent_found = false;
-      for (NodeID v : g.in_neigh(u)) {
-        if (v == parent[u]) {
-          if (depth[v] != depth[u] - 1) {
-            cout << "Wrong depths for " << u << " & " << v << endl;
-            return false;
-          }
-          parent_found = true;
-          break;
-        }
-      }
-      if (!parent_found) {
-        cout << "Couldn't find edge from " << parent[u] << " to " << u << endl;
-        return false;
-      }
-    } else if (depth[u] != parent[u]) {
-      cout << "Reachability mismatch" << endl;
-      return false;
+
+  if (g_cache_sim) {
+    if (g_metrics_level == kMetricsNone || g_metrics_level == kMetricsSampled) {
+      cout << "Cache model needs every access, using --metrics=counts" << endl;
+      g_metrics_level = kMetricsCounts;
     }
+    g_metrics_bank.EnableCacheSim(g_cache_config);
   }
-  return true;
-}
 
-int main(int argc, char* argv[]) {
-  // Strip our custom flags so CLApp parses cleanly
-  StripCustomArgs(argc, argv);
-
-  CLApp cli(argc, argv, "breadth-first search");
-  if (!cli.ParseArgs()) return -1;
+  if (g_trace_file != "" && !g_trace.Open(g_trace_file, g_trace_counters))
+    cout << "Could not open trace file " << g_trace_file << endl;
 
-  Builder b(cli);
-  Graph g = b.MakeGraph();
   SourcePicker<Graph> sp(g, cli.start_vertex());
-  auto BFSBound = [&sp,&cli] (const Graph &g) {
-    return DOBFS(g, sp.PickNext(), cli.logging_en());
+  DOBFSFunc bfs = PickDOBFS(g_metrics_level);
+  bool first_trial = true;
+  BfsWorkspace ws;
+  auto BFSBound = [&sp,&cli,bfs,&first_trial,&t_startup,&ws] (const Graph &g) {
+    if (!g_reuse_workspace) ws.Drop();
+    const pvector<NodeID> &parent =
+        bfs(g, sp.PickNext(), cli.logging_en(), g_opts, ws);
+    if (first_trial) {
+      t_startup.Stop();
+      PrintTime("Time to First BFS", t_startup.Seconds());
+      first_trial = false;
+    }
+    return std::cref(parent);
   };
   SourcePicker<Graph> vsp(g, cli.start_vertex());
   auto VerifierBound = [&vsp] (const Graph &g, const pvector<NodeID> &parent) {
@@ -303,34 +273,79 @@ int main(int argc, char* argv[]) {
   cout << "Traversed edges: " << g_traversed_edges << endl;
   cout << "BFS Time (s): " << fixed << setprecision(6) << g_bfs_time_sec << endl;
 
-  // Byte model: count visited bytes separately from bitmaps; parent/frontier as before
-  const double bytes_est =
-      (double)g_metrics.col_ind_reads      * sizeof(NodeID)   +
-      (double)g_metrics.parent_reads       * sizeof(NodeID)   +
-      (double)g_metrics.parent_writes      * sizeof(NodeID)   +
-      (double)g_metrics.frontier_pushes    * sizeof(NodeID)   +
-      (double)g_metrics.bitmap_reads       * sizeof(uint64_t) +
-      (double)g_metrics.bitmap_writes      * sizeof(uint64_t) +
-      (double)g_metrics.visited_byte_reads * sizeof(uint8_t)  +
-      (double)g_metrics.visited_byte_writes* sizeof(uint8_t);
-
   const double teps = (g_bfs_time_sec > 0.0) ? (double)g_traversed_edges / g_bfs_time_sec : 0.0;
-  const double Ie_edges_per_byte = (bytes_est > 0.0) ? (double)g_traversed_edges / bytes_est : 0.0;
-
-  cout << "Estimated bytes: " << fixed << setprecision(0) << bytes_est << endl;
-  cout << "Edges per byte (Ie): " << setprecision(6) << Ie_edges_per_byte << endl;
-  cout << "TEPS: " << setprecision(3) << teps << endl;
+  if (g_metrics_level != kMetricsNone) {
+    // Byte model: count visited bytes separately from bitmaps; parent/frontier as before
+    const double bytes_est = g_metrics.BytesEstimate(sizeof(NodeID));
+    const double Ie_edges_per_byte = (bytes_est > 0.0) ? (double)g_traversed_edges / bytes_est : 0.0;
+
+    cout << "Metrics: " << MetricsLevelName(g_metrics_level);
+    if (g_metrics_level == kMetricsSampled)
+      cout << " (1 in " << g_metrics_bank.sample_every() << " edges)";
+    cout << endl;
+    cout << "Estimated bytes: " << fixed << setprecision(0) << bytes_est << endl;
+    cout << "Edges per byte (Ie): " << setprecision(6) << Ie_edges_per_byte << endl;
+    MachineProfile profile;
+    if (profile.Load(MachineProfile::DefaultPath()))
+      PrintTraversalRoofline(cout, profile, Ie_edges_per_byte, teps,
+                             ProfileThreads());
+    if (g_metrics_bank.cache_sim_enabled()) {
+      CacheSimStats cache = g_metrics_bank.CacheTotals();
+      const double dram_bytes = cache.dram_bytes();
+      const double Ie_modeled = dram_bytes > 0 ?
+                                (double)g_traversed_edges / dram_bytes : 0.0;
+      cout << "Cache model: " << g_cache_config.Describe() << endl;
+      cache.Print(cout);
+      cout << "Modeled DRAM bytes: " << setprecision(0) << dram_bytes
+           << " (" << setprecision(3)
+           << (bytes_est > 0 ? dram_bytes / bytes_est : 0.0)
+           << "x the byte model)" << endl;
+      cout << "Edges per DRAM byte (modeled Ie): " << setprecision(6)
+           << Ie_modeled << endl;
+      if (profile.loaded())
+        PrintTraversalRoofline(cout, profile, Ie_modeled, teps,
+                               ProfileThreads());
+    }
+  }
+  cout << "TEPS: " << fixed << setprecision(3) << teps << endl;
+  if (g_opts.balanced)
+    g_balancer.PrintStats(cout);
+  if (g_opts.adaptive) {
+    cout << "Switch model: td=" << setprecision(3) << g_switch.td_ns_per_edge()
+         << " ns/edge bu=" << g_switch.bu_ns_per_edge()
+         << " ns/edge bu_frac=" << g_switch.bu_fraction()
+         << (g_switch.calibrated() ? "" : " (incomplete, used alpha/beta)")
+         << endl;
+  }
 
   // Debug counters (unchanged style)
-  cerr << "[mem] col_reads=" << g_metrics.col_ind_reads
-       << " parent_reads=" << g_metrics.parent_reads
-       << " parent_writes=" << g_metrics.parent_writes
-       << " frontier_pushes=" << g_metrics.frontier_pushes
-       << " bitmap_reads=" << g_metrics.bitmap_reads
-       << " bitmap_writes=" << g_metrics.bitmap_writes
-       << " visited_reads=" << g_metrics.visited_byte_reads
-       << " visited_writes=" << g_metrics.visited_byte_writes
-       << endl;
+  if (g_metrics_level != kMetricsNone)
+    cerr << "[mem] " << g_metrics << endl;
+
+  // The trace covers the trials above; samples below must not append to it
+  g_trace.Close();
+
+  // Repeat-until-stable timing of the BFS itself (no workspace reset), one
+  // new source per sample
+  if (g_runner.enabled) {
+    SourcePicker<Graph> rsp(g, cli.start_vertex());
+    BenchResult r = RunSampled("bfs", g_runner, [&]() {
+      bfs(g, rsp.PickNext(), false, g_opts, ws);
+      return g_bfs_time_sec * 1e9;
+    });
+    r.AddParam("graph", g_graph_class);
+    r.AddParam("metrics", MetricsLevelName(g_metrics_level));
+    PrintBenchResult(cout, r);
+    if (!g_runner.json_path.empty() &&
+        !WriteBenchJson(g_runner.json_path, g_runner, {r}))
+      cout << "Could not write " << g_runner.json_path << endl;
+  }
+
+  if (g_regions) {
+    RegionTracer::PrintSummary(cout);
+    if (g_regions_file != "" && !RegionTracer::WriteChromeTrace(g_regions_file))
+      cout << "Could not write " << g_regions_file << endl;
+  }
 
   return 0;
 }
@@ -8,10 +8,12 @@
 #include <cstdint>   // added
 
 #include "benchmark.h"
+#include "bfs_metrics.h"
 #include "bitmap.h"
 #include "builder.h"
 #include "command_line.h"
 #include "graph.h"
+#include "machine_profile.h"
 #include "platform_atomics.h"
 #include "pvector.h"
 #include "sliding_queue.h"
@@ -37,36 +39,52 @@ using namespace std;
 static int64_t g_traversed_edges = 0;
 static double  g_bfs_time_sec    = 0.0;
 
-// Added: memory-event counters for intensity estimation
-struct BfsMemMetrics {
-  int64_t col_ind_reads    = 0; // neighbor index loads (CSR col ids)
-  int64_t parent_reads     = 0; // parent/visited reads
-  int64_t parent_writes    = 0; // parent writes (discoveries)
-  int64_t frontier_pushes  = 0; // queue enqueues
-  int64_t bitmap_reads     = 0; // bitmap get_bit
-  int64_t bitmap_writes    = 0; // bitmap set_bit / set_bit_atomic
-};
+// Memory-event counters for intensity estimation. The level is a template
+// argument of the steps (see bfs_metrics.h); --metrics= picks it at startup.
 static BfsMemMetrics g_metrics;
+static MetricsBank g_metrics_bank;
+static MetricsLevel g_metrics_level = kMetricsCounts;
 
+static void StripCustomArgs(int& argc, char** argv) {
+  int out = 1;
+  for (int i = 1; i < argc; ++i) {
+    string a = argv[i];
+    if (a.compare(0, 10, "--metrics=") == 0) {
+      if (!ParseMetricsLevel(a.substr(10), g_metrics_level))
+        cout << "Unknown metrics level " << a.substr(10) << endl;
+    }
+    else if (a.compare(0, 17, "--metrics-sample=") == 0)
+      g_metrics_bank.set_sample_every(atol(a.c_str() + 17));
+    else argv[out++] = argv[i];
+  }
+  argc = out;
+}
+
+template <MetricsLevel kLevel>
 int64_t BUStep(const Graph &g, pvector<NodeID> &parent, Bitmap &front,
                Bitmap &next, int64_t &edges_visited) {
+  ThreadMetrics<kLevel> m(g_metrics_bank);
   int64_t awake_count = 0;
   next.reset();
   for (NodeID u = 0; u < g.num_nodes(); u++) {
     // read parent state for u once
-    g_metrics.parent_reads++;
+    if (m.enabled) m.exact().parent_reads++;
     if (parent[u] < 0) {
       for (NodeID v : g.in_neigh(u)) {
         // each in-neighbor check
         edges_visited++;
-        g_metrics.col_ind_reads++;
-        g_metrics.bitmap_reads++;           // front.get_bit(v) read
+        if (m.edge()) {
+          m.at_edge().col_ind_reads++;
+          m.at_edge().bitmap_reads++;       // front.get_bit(v) read
+        }
         if (front.get_bit(v)) {
           parent[u] = v;
-          g_metrics.parent_writes++;        // write parent on discovery
           awake_count++;
           next.set_bit(u);
-          g_metrics.bitmap_writes++;        // write next bitmap
+          if (m.enabled) {
+            m.exact().parent_writes++;      // write parent on discovery
+            m.exact().bitmap_writes++;      // write next bitmap
+          }
           break;                            // stop after finding one parent
         }
       }
@@ -75,8 +93,10 @@ int64_t BUStep(const Graph &g, pvector<NodeID> &parent, Bitmap &front,
   return awake_count;
 }
 
+template <MetricsLevel kLevel>
 int64_t TDStep(const Graph &g, pvector<NodeID> &parent,
                SlidingQueue<NodeID> &queue, int64_t &edges_visited) {
+  ThreadMetrics<kLevel> m(g_metrics_bank);
   int64_t scout_count = 0;
   QueueBuffer<NodeID> lqueue(queue);
   for (auto q_iter = queue.begin(); q_iter < queue.end(); q_iter++) {
@@ -84,16 +104,20 @@ int64_t TDStep(const Graph &g, pvector<NodeID> &parent,
     for (NodeID v : g.out_neigh(u)) {
       // each out-neighbor check
       edges_visited++;
-      g_metrics.col_ind_reads++;
       // parent read
       NodeID curr_val = parent[v];
-      g_metrics.parent_reads++;
+      if (m.edge()) {
+        m.at_edge().col_ind_reads++;
+        m.at_edge().parent_reads++;
+      }
       if (curr_val < 0) {
         if (compare_and_swap(parent[v], curr_val, u)) {
           // successful discovery writes parent and enqueues v
-          g_metrics.parent_writes++;
           lqueue.push_back(v);
-          g_metrics.frontier_pushes++;
+          if (m.enabled) {
+            m.exact().parent_writes++;
+            m.exact().frontier_pushes++;
+          }
           scout_count += -curr_val;      // degree stored as negative
         }
       }
@@ -103,26 +127,32 @@ int64_t TDStep(const Graph &g, pvector<NodeID> &parent,
   return scout_count;
 }
 
+template <MetricsLevel kLevel>
 void QueueToBitmap(const SlidingQueue<NodeID> &queue, Bitmap &bm) {
   for (auto q_iter = queue.begin(); q_iter < queue.end(); q_iter++) {
     NodeID u = *q_iter;
     bm.set_bit_atomic(u);
-    g_metrics.bitmap_writes++;
   }
+  if (kLevel != kMetricsNone) g_metrics.bitmap_writes += queue.size();
 }
 
+template <MetricsLevel kLevel>
 void BitmapToQueue(const Graph &g, const Bitmap &bm,
                    SlidingQueue<NodeID> &queue) {
   QueueBuffer<NodeID> lqueue(queue);
+  int64_t pushed = 0;
   for (NodeID n = 0; n < g.num_nodes(); n++) {
-    g_metrics.bitmap_reads++;
     if (bm.get_bit(n)) {
       lqueue.push_back(n);
-      g_metrics.frontier_pushes++;
+      pushed++;
     }
   }
   lqueue.flush();
   queue.slide_window();
+  if (kLevel != kMetricsNone) {
+    g_metrics.bitmap_reads    += g.num_nodes();
+    g_metrics.frontier_pushes += pushed;
+  }
 }
 
 pvector<NodeID> InitParent(const Graph &g) {
@@ -132,6 +162,7 @@ pvector<NodeID> InitParent(const Graph &g) {
   return parent;
 }
 
+template <MetricsLevel kLevel>
 pvector<NodeID> DOBFS(const Graph &g, NodeID source, bool logging_enabled = false,
                       int alpha = 15, int beta = 18) {
   if (logging_enabled)
@@ -164,7 +195,7 @@ pvector<NodeID> DOBFS(const Graph &g, NodeID source, bool logging_enabled = fals
   while (!queue.empty()) {
     if (scout_count > edges_to_check / alpha) {
       int64_t awake_count, old_awake_count;
-      TIME_OP(t, QueueToBitmap(queue, front));
+      TIME_OP(t, QueueToBitmap<kLevel>(queue, front));
       if (logging_enabled)
         PrintStep("e", t.Seconds());
       awake_count = queue.size();
@@ -172,25 +203,27 @@ pvector<NodeID> DOBFS(const Graph &g, NodeID source, bool logging_enabled = fals
       do {
         t.Start();
         old_awake_count = awake_count;
-        awake_count = BUStep(g, parent, front, curr, traversed_edges);
+        awake_count = BUStep<kLevel>(g, parent, front, curr, traversed_edges);
         front.swap(curr);
         t.Stop();
         if (logging_enabled)
           PrintStep("bu", t.Seconds(), awake_count);
+        MetricsStepDone<kLevel>(g_metrics_bank, g_metrics, "bu", logging_enabled);
       } while ((awake_count >= old_awake_count) ||
                (awake_count > g.num_nodes() / beta));
-      TIME_OP(t, BitmapToQueue(g, front, queue));
+      TIME_OP(t, BitmapToQueue<kLevel>(g, front, queue));
       if (logging_enabled)
         PrintStep("c", t.Seconds());
       scout_count = 1;
     } else {
       t.Start();
       edges_to_check -= scout_count;
-      scout_count = TDStep(g, parent, queue, traversed_edges);
+      scout_count = TDStep<kLevel>(g, parent, queue, traversed_edges);
       queue.slide_window();
       t.Stop();
       if (logging_enabled)
         PrintStep("td", t.Seconds(), queue.size());
+      MetricsStepDone<kLevel>(g_metrics_bank, g_metrics, "td", logging_enabled);
     }
   }
 
@@ -200,6 +233,7 @@ pvector<NodeID> DOBFS(const Graph &g, NodeID source, bool logging_enabled = fals
 
   // Stop BFS-only timing and store globals for final print
   t_total.Stop();
+  MetricsTrialDone<kLevel>(g_metrics_bank, g_metrics);
   g_traversed_edges = traversed_edges;
   g_bfs_time_sec    = t_total.Seconds();
   return parent;
@@ -267,15 +301,29 @@ bool BFSVerifier(const Graph &g, NodeID source,
   return true;
 }
 
+typedef pvector<NodeID> (*DOBFSFunc)(const Graph&, NodeID, bool, int, int);
+
+DOBFSFunc PickDOBFS(MetricsLevel level) {
+  switch (level) {
+    case kMetricsNone:    return DOBFS<kMetricsNone>;
+    case kMetricsCounts:  return DOBFS<kMetricsCounts>;
+    case kMetricsFull:    return DOBFS<kMetricsFull>;
+    case kMetricsSampled: return DOBFS<kMetricsSampled>;
+  }
+  return DOBFS<kMetricsCounts>;
+}
+
 int main(int argc, char* argv[]) {
+  StripCustomArgs(argc, argv);
   CLApp cli(argc, argv, "breadth-first search");
   if (!cli.ParseArgs())
     return -1;
   Builder b(cli);
   Graph g = b.MakeGraph();
   SourcePicker<Graph> sp(g, cli.start_vertex());
-  auto BFSBound = [&sp,&cli] (const Graph &g) {
-    return DOBFS(g, sp.PickNext(), cli.logging_en());
+  DOBFSFunc bfs = PickDOBFS(g_metrics_level);
+  auto BFSBound = [&sp,&cli,bfs] (const Graph &g) {
+    return bfs(g, sp.PickNext(), cli.logging_en(), 15, 18);
   };
   SourcePicker<Graph> vsp(g, cli.start_vertex());
   auto VerifierBound = [&vsp] (const Graph &g, const pvector<NodeID> &parent) {
@@ -287,33 +335,29 @@ int main(int argc, char* argv[]) {
   cout << "Traversed edges: " << g_traversed_edges << endl;
   cout << "BFS Time (s): " << fixed << setprecision(6) << g_bfs_time_sec << endl;
 
-  // Compute estimated bytes moved by BFS traversal (no counters)
-  const double bytes_est =
-      (double)g_metrics.col_ind_reads   * sizeof(NodeID)   +
-      (double)g_metrics.parent_reads    * sizeof(NodeID)   +
-      (double)g_metrics.parent_writes   * sizeof(NodeID)   +
-      (double)g_metrics.frontier_pushes * sizeof(NodeID)   +
-      (double)g_metrics.bitmap_reads    * sizeof(uint64_t) +
-      (double)g_metrics.bitmap_writes   * sizeof(uint64_t);
-
   const double teps = (g_bfs_time_sec > 0.0)
                         ? (double)g_traversed_edges / g_bfs_time_sec
                         : 0.0;
-  const double Ie_edges_per_byte = (bytes_est > 0.0)
-                        ? (double)g_traversed_edges / bytes_est
-                        : 0.0;
+  if (g_metrics_level != kMetricsNone) {
+    // Compute estimated bytes moved by BFS traversal (no counters)
+    const double bytes_est = g_metrics.BytesEstimate(sizeof(NodeID));
+    const double Ie_edges_per_byte = (bytes_est > 0.0)
+                          ? (double)g_traversed_edges / bytes_est
+                          : 0.0;
 
-  cout << "Estimated bytes: " << fixed << setprecision(0) << bytes_est << endl;
-  cout << "Edges per byte (Ie): " << setprecision(6) << Ie_edges_per_byte << endl;
-  cout << "TEPS: " << setprecision(3) << teps << endl;
+    cout << "Metrics: " << MetricsLevelName(g_metrics_level) << endl;
+    cout << "Estimated bytes: " << fixed << setprecision(0) << bytes_est << endl;
+    cout << "Edges per byte (Ie): " << setprecision(6) << Ie_edges_per_byte << endl;
+    MachineProfile profile;
+    if (profile.Load(MachineProfile::DefaultPath()))
+      PrintTraversalRoofline(cout, profile, Ie_edges_per_byte, teps,
+                             ProfileThreads());
+  }
+  cout << "TEPS: " << fixed << setprecision(3) << teps << endl;
 
   // Optional: print event counters for debugging
-  cerr << "[mem] col_reads=" << g_metrics.col_ind_reads
-       << " parent_reads=" << g_metrics.parent_reads
-       << " parent_writes=" << g_metrics.parent_writes
-       << " frontier_pushes=" << g_metrics.frontier_pushes
-       << " bitmap_reads=" << g_metrics.bitmap_reads
-       << " bitmap_writes=" << g_metrics.bitmap_writes << endl;
+  if (g_metrics_level != kMetricsNone)
+    cerr << "[mem] " << g_metrics << endl;
 
   return 0;
 }
@@ -0,0 +1,745 @@
+#ifndef BFS_KERNEL_H_
+#define BFS_KERNEL_H_
+
+#include <iostream>
+#include <memory>
+#include <vector>
+#include <cstdint>
+
+#include "benchmark.h"
+#include "bfs_metrics.h"
+#include "bfs_trace.h"
+#include "bfs_verify.h"
+#include "edge_balance.h"
+#include "graph.h"
+#include "platform_atomics.h"
+#include "pvector.h"
+#include "region_tracer.h"
+#include "sliding_queue.h"
+#include "switch_tuning.h"
+#include "timer.h"
+#include "word_bitmap.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/*
+Direction-optimizing BFS kernel shared by the BFS drivers
+
+This is the kernel that used to live in bfs_improved.cc, with the runtime
+toggles gathered in BFSOptions so several configurations can run side by
+side in one process (bfs_ab.cc). Each option picks a different template
+instantiation of the steps, so an option that is off costs nothing in the
+hot loops:
+
+  visited   visited-byte fast path in td steps
+  prefetch  software prefetch of parent[] (td) and front words (bu)
+            kPrefetchDistance neighbors ahead
+  parallel  OpenMP td/bu steps in the style of upstream gapbs (only
+            differs from the serial steps when built with -fopenmp)
+  adaptive  cost-model direction switching (switch_tuning.h)
+  balanced  td steps split the frontier by edges, with hubs spread over
+            several threads and work stealing (edge_balance.h)
+
+With kMetricsNone and every option off, the steps are the bfs_treps.cc
+loops.
+
+BfsWorkspace keeps parent, the visited bytes, both bitmaps and the queue
+across trials, so a trial no longer allocates (and page-faults in) about
+13 bytes per vertex. The visited bytes are epoch-tagged: a vertex counts as
+visited when its byte equals the trial's mark, so they are only cleared once
+every 255 trials.
+*/
+
+// Kernel state lives in function-local statics, so every translation unit
+// that includes this header shares one copy; the g_ references below keep
+// the short names at the call sites.
+
+// Global stats for final report
+inline int64_t& BfsTraversedEdges() { static int64_t v = 0; return v; }
+inline double& BfsTimeSec() { static double v = 0.0; return v; }
+
+// Memory-event totals (merged from per-thread slots, see bfs_metrics.h)
+inline BfsMemMetrics& BfsMetrics() { static BfsMemMetrics v; return v; }
+inline MetricsBank& BfsMetricsBank() { static MetricsBank v; return v; }
+
+// Learned direction-switch costs, shared by every adaptive run
+inline SwitchController& BfsSwitch() { static SwitchController v; return v; }
+
+// Frontier partitioning and load-imbalance totals for balanced td steps
+inline EdgeBalancer& BfsBalancer() { static EdgeBalancer v; return v; }
+
+// Per-step trace sink (bfs_trace.h); disabled unless a driver opens it
+inline TraceWriter& BfsTrace() { static TraceWriter v; return v; }
+
+static int64_t &g_traversed_edges = BfsTraversedEdges();
+static double &g_bfs_time_sec = BfsTimeSec();
+static BfsMemMetrics &g_metrics = BfsMetrics();
+static MetricsBank &g_metrics_bank = BfsMetricsBank();
+static SwitchController &g_switch = BfsSwitch();
+static EdgeBalancer &g_balancer = BfsBalancer();
+static TraceWriter &g_trace = BfsTrace();
+
+struct BFSOptions {
+  bool visited  = true;
+  bool prefetch = false;
+  bool parallel = false;
+  bool adaptive = false;
+  bool balanced = false;
+  int alpha = 15;
+  int beta  = 18;
+};
+
+static const int kPrefetchDistance = 8;
+
+// Parallel td steps share the visited bytes. A thread may read a byte while
+// the CAS winner writes it; the stale value only sends it on to the parent
+// compare_and_swap, which decides. Relaxed atomics make that race defined
+// and compile to plain byte loads and stores.
+inline bool IsVisited(const uint8_t *visited, NodeID v, uint8_t mark) {
+  return __atomic_load_n(&visited[v], __ATOMIC_RELAXED) == mark;
+}
+
+inline void MarkVisited(uint8_t *visited, NodeID v, uint8_t mark) {
+  __atomic_store_n(&visited[v], mark, __ATOMIC_RELAXED);
+}
+
+// Bottom-up step; kLevel picks the instrumentation at compile time
+template <MetricsLevel kLevel, bool kPrefetch>
+int64_t BUStep(const Graph &g, pvector<NodeID> &parent, WordBitmap &front,
+               WordBitmap &next, int64_t &edges_visited) {
+  ThreadMetrics<kLevel> m(g_metrics_bank);
+  int64_t awake_count = 0;
+  next.reset();
+  for (NodeID u = 0; u < g.num_nodes(); u++) {
+    if (m.enabled) {
+      m.exact().parent_reads++;                       // read parent[u] state
+      m.read(&parent[u]);
+    }
+    if (parent[u] < 0) {
+      auto neigh = g.in_neigh(u);
+      for (auto it = neigh.begin(); it != neigh.end(); ++it) {
+        NodeID v = *it;
+        if (kPrefetch && neigh.end() - it > kPrefetchDistance)
+          __builtin_prefetch(front.words() +
+                             WordBitmap::word_offset(it[kPrefetchDistance]));
+        edges_visited++;
+        if (m.edge()) {
+          m.at_edge().col_ind_reads++;                // in-neighbor index
+          m.at_edge().bitmap_reads++;                 // front.get_bit
+          m.read(&*it);
+          m.read(front.word_of(v));
+        }
+        if (front.get_bit(v)) {
+          parent[u] = v;
+          awake_count++;
+          next.set_bit(u);
+          if (m.enabled) {
+            m.exact().parent_writes++;                // write parent
+            m.exact().bitmap_writes++;                // write next bitmap
+            m.write(&parent[u]);
+            m.write(next.word_of(u));
+          }
+          break;                                      // early exit
+        }
+      }
+    }
+  }
+  return awake_count;
+}
+
+// Top-down step; kUseVisited adds the visited-byte fast path
+template <MetricsLevel kLevel, bool kUseVisited, bool kPrefetch>
+int64_t TDStep(const Graph &g, pvector<NodeID> &parent,
+               SlidingQueue<NodeID> &queue, int64_t &edges_visited,
+               uint8_t* visited, uint8_t mark) {
+  ThreadMetrics<kLevel> m(g_metrics_bank);
+  int64_t scout_count = 0;
+  QueueBuffer<NodeID> lqueue(queue);
+  const NodeID *push_at = queue.end();
+
+  for (auto q_iter = queue.begin(); q_iter < queue.end(); q_iter++) {
+    NodeID u = *q_iter;
+    auto neigh = g.out_neigh(u);
+    for (auto it = neigh.begin(); it != neigh.end(); ++it) {
+      NodeID v = *it;
+      if (kPrefetch && neigh.end() - it > kPrefetchDistance) {
+        NodeID ahead = it[kPrefetchDistance];
+        __builtin_prefetch(kUseVisited ? (const void*) &visited[ahead]
+                                       : (const void*) &parent[ahead]);
+      }
+      edges_visited++;
+      const bool rec = m.edge();
+      if (rec) {
+        m.at_edge().col_ind_reads++;                  // neighbor index load
+        m.read(&*it);
+      }
+
+      // Fast reject via visited byte before touching parent[v]
+      if (kUseVisited) {
+        if (rec) {
+          m.at_edge().visited_byte_reads++;
+          m.read(&visited[v]);
+        }
+        if (visited[v] == mark) continue;             // already visited: skip
+      }
+
+      // Fallback/confirm via parent array
+      NodeID curr_val = parent[v];
+      if (rec) {
+        m.at_edge().parent_reads++;                   // parent read
+        m.read(&parent[v]);
+      }
+      if (curr_val < 0) {
+        // Found an undiscovered vertex; mark visited first
+        if (kUseVisited) {
+          if (visited[v] != mark) {
+            visited[v] = mark;
+            if (m.enabled) {
+              m.exact().visited_byte_writes++;
+              m.write(&visited[v]);
+            }
+          }
+        }
+        // Publish parent and enqueue
+        if (compare_and_swap(parent[v], curr_val, u)) {
+          lqueue.push_back(v);
+          if (m.enabled) {
+            m.exact().frontier_pushes++;
+            m.write(&parent[v]);
+            m.write(push_at++);                       // lands after the window
+          }
+          scout_count += -curr_val;                   // degree stored as negative
+        }
+      }
+    }
+  }
+  lqueue.flush();
+  return scout_count;
+}
+
+// Parallel bottom-up step (upstream gapbs structure)
+template <MetricsLevel kLevel>
+int64_t BUStepParallel(const Graph &g, pvector<NodeID> &parent,
+                       WordBitmap &front, WordBitmap &next,
+                       int64_t &edges_visited) {
+  int64_t awake_count = 0;
+  int64_t edges = 0;
+  next.reset();
+  #pragma omp parallel reduction(+ : awake_count, edges)
+  {
+    ThreadMetrics<kLevel> m(g_metrics_bank);
+    #pragma omp for schedule(dynamic, 1024)
+    for (NodeID u = 0; u < g.num_nodes(); u++) {
+      if (m.enabled) {
+        m.exact().parent_reads++;
+        m.read(&parent[u]);
+      }
+      if (parent[u] < 0) {
+        for (const NodeID &v : g.in_neigh(u)) {
+          edges++;
+          if (m.edge()) {
+            m.at_edge().col_ind_reads++;
+            m.at_edge().bitmap_reads++;
+            m.read(&v);
+            m.read(front.word_of(v));
+          }
+          if (front.get_bit(v)) {
+            parent[u] = v;
+            awake_count++;
+            next.set_bit_atomic(u);
+            if (m.enabled) {
+              m.exact().parent_writes++;
+              m.exact().bitmap_writes++;
+              m.write(&parent[u]);
+              m.write(next.word_of(u));
+            }
+            break;
+          }
+        }
+      }
+    }
+  }
+  edges_visited += edges;
+  return awake_count;
+}
+
+// Parallel top-down step (upstream gapbs structure)
+template <MetricsLevel kLevel, bool kUseVisited>
+int64_t TDStepParallel(const Graph &g, pvector<NodeID> &parent,
+                       SlidingQueue<NodeID> &queue, int64_t &edges_visited,
+                       uint8_t* visited, uint8_t mark) {
+  int64_t scout_count = 0;
+  int64_t edges = 0;
+  #pragma omp parallel reduction(+ : scout_count, edges)
+  {
+    ThreadMetrics<kLevel> m(g_metrics_bank);
+    QueueBuffer<NodeID> lqueue(queue);
+    const NodeID *push_at = queue.end();
+    #pragma omp for nowait schedule(dynamic, 64)
+    for (auto q_iter = queue.begin(); q_iter < queue.end(); q_iter++) {
+      NodeID u = *q_iter;
+      for (const NodeID &v : g.out_neigh(u)) {
+        edges++;
+        const bool rec = m.edge();
+        if (rec) {
+          m.at_edge().col_ind_reads++;
+          m.read(&v);
+        }
+        if (kUseVisited) {
+          if (rec) {
+            m.at_edge().visited_byte_reads++;
+            m.read(&visited[v]);
+          }
+          if (IsVisited(visited, v, mark)) continue;
+        }
+        NodeID curr_val = parent[v];
+        if (rec) {
+          m.at_edge().parent_reads++;
+          m.read(&parent[v]);
+        }
+        if (curr_val < 0) {
+          if (compare_and_swap(parent[v], curr_val, u)) {
+            if (kUseVisited) {
+              MarkVisited(visited, v, mark);
+              if (m.enabled) {
+                m.exact().visited_byte_writes++;
+                m.write(&visited[v]);
+              }
+            }
+            lqueue.push_back(v);
+            if (m.enabled) {
+              m.exact().frontier_pushes++;
+              m.write(&parent[v]);
+              m.write(push_at++);
+            }
+            scout_count += -curr_val;
+          }
+        }
+      }
+    }
+    lqueue.flush();
+  }
+  edges_visited += edges;
+  return scout_count;
+}
+
+// Parallel top-down step over edge-balanced chunks of the frontier; a chunk
+// may start or end inside a hub's adjacency list
+template <MetricsLevel kLevel, bool kUseVisited>
+int64_t TDStepBalanced(const Graph &g, pvector<NodeID> &parent,
+                       SlidingQueue<NodeID> &queue, int64_t &edges_visited,
+                       uint8_t* visited, uint8_t mark) {
+  int num_threads = 1;
+#ifdef _OPENMP
+  num_threads = omp_get_max_threads();
+#endif
+  g_balancer.Plan(g, queue.begin(), queue.size(), num_threads);
+  const NodeID *frontier = queue.begin();
+  int64_t scout_count = 0;
+  int64_t edges = 0;
+  #pragma omp parallel reduction(+ : scout_count, edges)
+  {
+    int tid = 0;
+#ifdef _OPENMP
+    tid = omp_get_thread_num();
+#endif
+    ThreadMetrics<kLevel> m(g_metrics_bank);
+    QueueBuffer<NodeID> lqueue(queue);
+    const NodeID *push_at = queue.end();
+    int64_t thread_edges = 0;
+    int64_t chunk;
+    while (g_balancer.Claim(tid, chunk)) {
+      g_balancer.ForEachInChunk(chunk, [&](int64_t i, int64_t lo, int64_t hi) {
+        NodeID u = frontier[i];
+        auto neigh = g.out_neigh(u);
+        for (auto it = neigh.begin() + lo; it < neigh.begin() + hi; ++it) {
+          NodeID v = *it;
+          thread_edges++;
+          const bool rec = m.edge();
+          if (rec) {
+            m.at_edge().col_ind_reads++;
+            m.read(&*it);
+          }
+          if (kUseVisited) {
+            if (rec) {
+              m.at_edge().visited_byte_reads++;
+              m.read(&visited[v]);
+            }
+            if (IsVisited(visited, v, mark)) continue;
+          }
+          NodeID curr_val = parent[v];
+          if (rec) {
+            m.at_edge().parent_reads++;
+            m.read(&parent[v]);
+          }
+          if (curr_val < 0) {
+            if (compare_and_swap(parent[v], curr_val, u)) {
+              if (kUseVisited) {
+                MarkVisited(visited, v, mark);
+                if (m.enabled) {
+                  m.exact().visited_byte_writes++;
+                  m.write(&visited[v]);
+                }
+              }
+              lqueue.push_back(v);
+              if (m.enabled) {
+                m.exact().frontier_pushes++;
+                m.write(&parent[v]);
+                m.write(push_at++);
+              }
+              scout_count += -curr_val;
+            }
+          }
+        }
+      });
+    }
+    g_balancer.AddThreadEdges(tid, thread_edges);
+    edges += thread_edges;
+    lqueue.flush();
+  }
+  g_balancer.StepDone();
+  edges_visited += edges;
+  return scout_count;
+}
+
+template <MetricsLevel kLevel>
+int64_t RunBUStep(const BFSOptions &opts, const Graph &g,
+                  pvector<NodeID> &parent, WordBitmap &front,
+                  WordBitmap &next, int64_t &edges_visited) {
+  if (opts.parallel)
+    return BUStepParallel<kLevel>(g, parent, front, next, edges_visited);
+  if (opts.prefetch)
+    return BUStep<kLevel, true>(g, parent, front, next, edges_visited);
+  return BUStep<kLevel, false>(g, parent, front, next, edges_visited);
+}
+
+template <MetricsLevel kLevel>
+int64_t RunTDStep(const BFSOptions &opts, const Graph &g,
+                  pvector<NodeID> &parent, SlidingQueue<NodeID> &queue,
+                  int64_t &edges_visited, uint8_t* visited, uint8_t mark) {
+  if (opts.balanced) {
+    if (visited != nullptr)
+      return TDStepBalanced<kLevel, true>(g, parent, queue, edges_visited,
+                                          visited, mark);
+    return TDStepBalanced<kLevel, false>(g, parent, queue, edges_visited,
+                                         nullptr, mark);
+  }
+  if (opts.parallel) {
+    if (visited != nullptr)
+      return TDStepParallel<kLevel, true>(g, parent, queue, edges_visited,
+                                          visited, mark);
+    return TDStepParallel<kLevel, false>(g, parent, queue, edges_visited,
+                                         nullptr, mark);
+  }
+  if (visited != nullptr) {
+    if (opts.prefetch)
+      return TDStep<kLevel, true, true>(g, parent, queue, edges_visited,
+                                        visited, mark);
+    return TDStep<kLevel, true, false>(g, parent, queue, edges_visited,
+                                       visited, mark);
+  }
+  if (opts.prefetch)
+    return TDStep<kLevel, false, true>(g, parent, queue, edges_visited,
+                                       nullptr, mark);
+  return TDStep<kLevel, false, false>(g, parent, queue, edges_visited,
+                                      nullptr, mark);
+}
+
+// Frontier conversions work a 64-bit word at a time. With a single thread
+// the bitmap is built with plain stores; set_bit_atomic is only needed when
+// several threads may hit the same word.
+template <MetricsLevel kLevel>
+void QueueToBitmap(const SlidingQueue<NodeID> &queue, WordBitmap &bm) {
+#ifdef _OPENMP
+  if (omp_get_max_threads() > 1) {
+    #pragma omp parallel
+    {
+      ThreadMetrics<kLevel> m(g_metrics_bank);
+      #pragma omp for
+      for (auto q_iter = queue.begin(); q_iter < queue.end(); q_iter++) {
+        bm.set_bit_atomic(*q_iter);
+        m.read(q_iter);
+        m.write(bm.word_of(*q_iter));
+      }
+    }
+    if (kLevel != kMetricsNone) g_metrics.bitmap_writes += queue.size();
+    return;
+  }
+#endif
+  ThreadMetrics<kLevel> m(g_metrics_bank);
+  for (auto q_iter = queue.begin(); q_iter < queue.end(); q_iter++) {
+    bm.set_bit(*q_iter);
+    m.read(q_iter);
+    m.write(bm.word_of(*q_iter));
+  }
+  if (kLevel != kMetricsNone) g_metrics.bitmap_writes += queue.size();
+}
+
+// Scans whole words, skips empty ones and peels set bits off with tzcnt.
+// Each thread takes a contiguous chunk of words and appends to its own
+// QueueBuffer, so the shared queue only sees one fetch_and_add per flush.
+template <MetricsLevel kLevel>
+void BitmapToQueue(const WordBitmap &bm, SlidingQueue<NodeID> &queue) {
+  const int64_t num_words = bm.num_words();
+  int64_t pushed = 0;
+  #pragma omp parallel reduction(+ : pushed)
+  {
+    ThreadMetrics<kLevel> m(g_metrics_bank);
+    QueueBuffer<NodeID> lqueue(queue);
+    const NodeID *push_at = queue.end();
+    #pragma omp for schedule(static) nowait
+    for (int64_t w = 0; w < num_words; w++) {
+      uint64_t bits = bm.word(w);
+      m.read(bm.words() + w);
+      while (bits != 0) {
+        lqueue.push_back(static_cast<NodeID>(
+            w * WordBitmap::kBitsPerWord + __builtin_ctzll(bits)));
+        m.write(push_at++);
+        bits &= bits - 1;
+        pushed++;
+      }
+    }
+    lqueue.flush();
+  }
+  queue.slide_window();
+  if (kLevel != kMetricsNone) {
+    g_metrics.bitmap_reads    += num_words; // one word load per 64 vertices
+    g_metrics.frontier_pushes += pushed;
+  }
+}
+
+inline void InitParent(const Graph &g, pvector<NodeID> &parent) {
+  #pragma omp parallel for
+  for (NodeID n = 0; n < g.num_nodes(); n++)
+    parent[n] = g.out_degree(n) != 0 ? -g.out_degree(n) : -1;
+}
+
+inline pvector<NodeID> InitParent(const Graph &g) {
+  pvector<NodeID> parent(g.num_nodes());
+  InitParent(g, parent);
+  return parent;
+}
+
+// Buffers for one DOBFS at a time, reused from trial to trial. Buffers are
+// (re)allocated only when the graph size changes; Reset() rewrites parent,
+// clears the two bitmaps and the queue, and bumps the visited mark.
+class BfsWorkspace {
+ public:
+  BfsWorkspace() : num_nodes_(-1), mark_(0), front_(0), curr_(0) {}
+
+  explicit BfsWorkspace(const Graph &g) : BfsWorkspace() { Prepare(g); }
+
+  void Prepare(const Graph &g) {
+    if (num_nodes_ == g.num_nodes())
+      return;
+    num_nodes_ = g.num_nodes();
+    parent_ = pvector<NodeID>(num_nodes_);
+    visited_ = pvector<uint8_t>(num_nodes_, 0);
+    mark_ = 0;
+    WordBitmap(num_nodes_).swap(front_);
+    WordBitmap(num_nodes_).swap(curr_);
+    queue_.reset(new SlidingQueue<NodeID>(num_nodes_));
+  }
+
+  // Readies the buffers for a BFS from source; visited bytes are touched
+  // only when the 8-bit mark wraps
+  void Reset(const Graph &g, NodeID source) {
+    Prepare(g);
+    InitParent(g, parent_);
+    parent_[source] = source;
+    if (++mark_ == 0) {
+      #pragma omp parallel for
+      for (int64_t n = 0; n < num_nodes_; n++)
+        visited_[n] = 0;
+      mark_ = 1;
+    }
+    visited_[source] = mark_;
+    front_.reset();
+    curr_.reset();
+    queue_->reset();
+  }
+
+  pvector<NodeID>& parent() { return parent_; }
+  uint8_t* visited() { return visited_.data(); }
+  uint8_t mark() const { return mark_; }
+  WordBitmap& front() { return front_; }
+  WordBitmap& curr() { return curr_; }
+  SlidingQueue<NodeID>& queue() { return *queue_; }
+
+  // Makes the next Reset allocate fresh buffers, as DOBFS used to every trial
+  void Drop() { num_nodes_ = -1; }
+
+  // Hands the parent array to the caller; the next Reset reallocates it
+  pvector<NodeID> TakeParent() {
+    num_nodes_ = -1;
+    return std::move(parent_);
+  }
+
+ private:
+  int64_t num_nodes_;
+  uint8_t mark_;
+  pvector<NodeID> parent_;
+  pvector<uint8_t> visited_;
+  WordBitmap front_;
+  WordBitmap curr_;
+  std::unique_ptr<SlidingQueue<NodeID>> queue_;
+};
+
+template <MetricsLevel kLevel>
+const pvector<NodeID>& DOBFS(const Graph &g, NodeID source,
+                             bool logging_enabled, const BFSOptions &opts,
+                             BfsWorkspace &ws) {
+  TraceRegion trial_region("bfs");
+  if (logging_enabled) PrintStep("Source", static_cast<int64_t>(source));
+  g_trace.BeginTrial(source);
+
+  Timer t;
+  g_trace.BeginStep(g_metrics);
+  TraceRegion init_region("i");
+  t.Start();
+  ws.Reset(g, source);
+  t.Stop();
+  init_region.End();
+  if (logging_enabled) PrintStep("i", t.Seconds());
+  g_trace.EndStep("i", t.Seconds(), 1, 0, g_metrics);
+
+  pvector<NodeID> &parent = ws.parent();
+  uint8_t* visited_ptr = opts.visited ? ws.visited() : nullptr;
+  if (opts.visited && kLevel != kMetricsNone)
+    g_metrics.visited_byte_writes++;          // source mark
+
+  Timer t_total;
+  t_total.Start();
+  int64_t traversed_edges = 0;
+
+  SlidingQueue<NodeID> &queue = ws.queue();
+  queue.push_back(source);
+  queue.slide_window();
+  WordBitmap &curr = ws.curr();
+  WordBitmap &front = ws.front();
+  int64_t edges_to_check = g.num_edges_directed();
+  int64_t scout_count = g.out_degree(source);
+  const double avg_degree = (double)g.num_edges_directed() / g.num_nodes();
+
+  while (!queue.empty()) {
+    bool go_bottom_up = opts.adaptive
+        ? g_switch.PreferBottomUp(scout_count, edges_to_check, opts.alpha)
+        : scout_count > edges_to_check / opts.alpha;
+    if (go_bottom_up) {
+      int64_t awake_count, old_awake_count, bu_edges;
+      bool stay;
+      g_trace.BeginStep(g_metrics);
+      TraceRegion e_region("e");
+      TIME_OP(t, QueueToBitmap<kLevel>(queue, front));
+      e_region.End();
+      if (logging_enabled) PrintStep("e", t.Seconds());
+      g_trace.EndStep("e", t.Seconds(), queue.size(), 0, g_metrics);
+      awake_count = queue.size();
+      queue.slide_window();
+      bool first_in_phase = true;
+      do {
+        g_trace.BeginStep(g_metrics);
+        TraceRegion bu_region("bu");
+        t.Start();
+        old_awake_count = awake_count;
+        bu_edges = traversed_edges;
+        awake_count = RunBUStep<kLevel>(opts, g, parent, front, curr,
+                                        traversed_edges);
+        front.swap(curr);
+        t.Stop();
+        bu_region.End();
+        bu_edges = traversed_edges - bu_edges;
+        g_switch.RecordBottomUp(bu_edges, edges_to_check, t.Seconds(),
+                                first_in_phase);
+        first_in_phase = false;
+        if (logging_enabled) PrintStep("bu", t.Seconds(), awake_count);
+        MetricsStepDone<kLevel>(g_metrics_bank, g_metrics, "bu", logging_enabled);
+        g_trace.EndStep("bu", t.Seconds(), awake_count, bu_edges, g_metrics);
+        stay = opts.adaptive
+            ? g_switch.StayBottomUp(awake_count, old_awake_count, bu_edges,
+                                    g.num_nodes(), avg_degree, opts.beta)
+            : (awake_count >= old_awake_count) ||
+              (awake_count > g.num_nodes() / opts.beta);
+      } while (stay);
+      g_trace.BeginStep(g_metrics);
+      TraceRegion c_region("c");
+      TIME_OP(t, BitmapToQueue<kLevel>(front, queue));
+      c_region.End();
+      if (logging_enabled) PrintStep("c", t.Seconds());
+      g_trace.EndStep("c", t.Seconds(), queue.size(), 0, g_metrics);
+      scout_count = 1;
+    } else {
+      g_trace.BeginStep(g_metrics);
+      TraceRegion td_region("td");
+      t.Start();
+      int64_t td_edges = traversed_edges;
+      edges_to_check -= scout_count;
+      scout_count = RunTDStep<kLevel>(opts, g, parent, queue, traversed_edges,
+                                      visited_ptr, ws.mark());
+      queue.slide_window();
+      t.Stop();
+      td_region.End();
+      g_switch.RecordTopDown(traversed_edges - td_edges, t.Seconds());
+      if (logging_enabled) PrintStep("td", t.Seconds(), queue.size());
+      MetricsStepDone<kLevel>(g_metrics_bank, g_metrics, "td", logging_enabled);
+      g_trace.EndStep("td", t.Seconds(), queue.size(),
+                      traversed_edges - td_edges, g_metrics);
+    }
+  }
+
+  #pragma omp parallel for
+  for (NodeID n = 0; n < g.num_nodes(); n++)
+    if (parent[n] < -1) parent[n] = -1;
+
+  t_total.Stop();
+  trial_region.End();
+  MetricsTrialDone<kLevel>(g_metrics_bank, g_metrics);
+  g_trace.EndTrial(g_metrics);
+  g_traversed_edges = traversed_edges;
+  g_bfs_time_sec    = t_total.Seconds();
+  return parent;
+}
+
+
+// Allocating form: a fresh workspace per call, parent handed to the caller
+template <MetricsLevel kLevel>
+pvector<NodeID> DOBFS(const Graph &g, NodeID source, bool logging_enabled,
+                      const BFSOptions &opts) {
+  BfsWorkspace ws(g);
+  DOBFS<kLevel>(g, source, logging_enabled, opts, ws);
+  return ws.TakeParent();
+}
+
+typedef const pvector<NodeID>& (*DOBFSFunc)(const Graph&, NodeID, bool,
+                                            const BFSOptions&,
+                                            BfsWorkspace&);
+
+inline DOBFSFunc PickDOBFS(MetricsLevel level) {
+  switch (level) {
+    case kMetricsNone:    return DOBFS<kMetricsNone>;
+    case kMetricsCounts:  return DOBFS<kMetricsCounts>;
+    case kMetricsFull:    return DOBFS<kMetricsFull>;
+    case kMetricsSampled: return DOBFS<kMetricsSampled>;
+  }
+  return DOBFS<kMetricsCounts>;
+}
+
+inline void PrintBFSStats(const Graph &g,
+                          const pvector<NodeID> &bfs_tree) {
+  int64_t tree_size = 0, n_edges = 0;
+  for (NodeID n : g.vertices()) {
+    if (bfs_tree[n] >= 0) { n_edges += g.out_degree(n); tree_size++; }
+  }
+  std::cout << "BFS Tree has " << tree_size << " nodes and " << n_edges
+            << " edges" << std::endl;
+}
+
+// BFS verifier; mode and sampling from g_verify (bfs_verify.h)
+inline bool BFSVerifier(const Graph &g, NodeID source,
+                        const pvector<NodeID> &parent) {
+  return VerifyBFSTree(g, source, parent, g_verify);
+}
+
+#endif  // BFS_KERNEL_H_
@@ -0,0 +1,183 @@
+#include <iostream>
+#include <vector>
+#include <iomanip>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <string>
+
+#include "benchmark.h"
+#include "bfs_kernel.h"
+#include "bfs_limited.h"
+#include "bfs_metrics.h"
+#include "command_line.h"
+#include "graph.h"
+#include "graph_snapshot.h"
+#include "machine_profile.h"
+#include "pvector.h"
+
+/*
+Compact-output BFS driver (bfs_limited.h)
+
+Runs LimitedBFS with the chosen per-vertex state and reports the same TEPS
+and byte-model Ie lines as bfs_improved, so the two can be compared
+directly. With -v every trial is checked against a serial reference BFS
+cut at the same depth: level sizes always, per-vertex depths for the depth
+outputs.
+
+Extra flags (stripped before CLApp sees them):
+  --output=depth16|depth8|count   per-vertex state (default depth16)
+  --max-depth=K                   stop after K levels (default: no limit)
+  --metrics=none|counts|full|sampled, --metrics-sample=K   as bfs_improved
+  --snapshot=F, --snapshot-prefault=none|populate|background
+*/
+
+using namespace std;
+
+static string g_output = "depth16";
+static int g_max_depth = -1;
+static MetricsLevel g_metrics_level = kMetricsCounts;
+
+// Graph snapshot (graph_snapshot.h): mmap if present, else build and save
+static string g_snapshot = "";
+static SnapshotPrefault g_prefault = kPrefaultNone;
+
+static void StripCustomArgs(int& argc, char** argv) {
+  int out = 1;
+  for (int i = 1; i < argc; ++i) {
+    string a = argv[i];
+    if (a.compare(0, 9, "--output=") == 0) g_output = a.substr(9);
+    else if (a.compare(0, 12, "--max-depth=") == 0)
+      g_max_depth = atoi(a.c_str() + 12);
+    else if (a.compare(0, 10, "--metrics=") == 0) {
+      if (!ParseMetricsLevel(a.substr(10), g_metrics_level))
+        cout << "Unknown metrics level " << a.substr(10) << endl;
+    }
+    else if (a.compare(0, 17, "--metrics-sample=") == 0)
+      g_metrics_bank.set_sample_every(atol(a.c_str() + 17));
+    else if (a.compare(0, 11, "--snapshot=") == 0) g_snapshot = a.substr(11);
+    else if (a.compare(0, 20, "--snapshot-prefault=") == 0) {
+      if (!ParseSnapshotPrefault(a.substr(20), g_prefault))
+        cout << "Unknown prefault mode " << a.substr(20) << endl;
+    }
+    else argv[out++] = argv[i];
+  }
+  argc = out;
+}
+
+template <typename State>
+void PrintLimitedStats(const Graph &g,
+                       const LimitedBfsWorkspace<State> &ws) {
+  cout << "BFS reached " << ws.reached() << " of " << g.num_nodes()
+       << " nodes in "
+       << ws.level_sizes.size() << " levels";
+  if (g_max_depth >= 0)
+    cout << " (limit " << g_max_depth << ")";
+  cout << endl;
+  if (ws.truncated)
+    cout << "Warning: stopped at level " << ws.max_depth << ", the deepest "
+         << State::Name() << " can store" << endl;
+}
+
+// Serial reference BFS cut at ws.max_depth levels
+template <typename State>
+bool LimitedVerifier(const Graph &g, const LimitedBfsWorkspace<State> &ws) {
+  pvector<int> depth(g.num_nodes(), -1);
+  depth[ws.source] = 0;
+  vector<NodeID> to_visit;
+  to_visit.reserve(g.num_nodes());
+  to_visit.push_back(ws.source);
+  vector<int64_t> level_sizes(1, 1);
+  for (auto it = to_visit.begin(); it != to_visit.end(); it++) {
+    NodeID u = *it;
+    if (depth[u] == ws.max_depth)
+      continue;
+    for (NodeID v : g.out_neigh(u)) {
+      if (depth[v] == -1) {
+        depth[v] = depth[u] + 1;
+        if ((int) level_sizes.size() <= depth[v]) level_sizes.push_back(0);
+        level_sizes[depth[v]]++;
+        to_visit.push_back(v);
+      }
+    }
+  }
+  if (level_sizes != ws.level_sizes) {
+    cout << "Level sizes differ" << endl;
+    return false;
+  }
+  if (ws.state.depth(ws.source) < 0)
+    return true;                        // count-only: nothing per vertex
+  for (NodeID u : g.vertices()) {
+    if (ws.state.depth(u) != depth[u]) {
+      cout << "Wrong depth for " << u << ": " << ws.state.depth(u)
+           << " expected " << depth[u] << endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+template <typename State, MetricsLevel kLevel>
+void RunLimited(const CLApp &cli, const Graph &g) {
+  LimitedBfsWorkspace<State> ws(g.num_nodes());
+  SourcePicker<Graph> sp(g, cli.start_vertex());
+  auto BFSBound = [&sp, &cli, &ws] (const Graph &g) {
+    LimitedBFS<kLevel>(g, sp.PickNext(), g_max_depth, cli.logging_en(), ws);
+    return std::cref(ws);
+  };
+  BenchmarkKernel(cli, g, BFSBound, PrintLimitedStats<State>,
+                  LimitedVerifier<State>);
+
+  cout << "Output: " << State::Name() << " (" << State::Bytes()
+       << " bytes/vertex)" << endl;
+  cout << "Traversed edges: " << g_traversed_edges << endl;
+  cout << "BFS Time (s): " << fixed << setprecision(6) << g_bfs_time_sec
+       << endl;
+  const double teps = (g_bfs_time_sec > 0.0)
+                        ? (double)g_traversed_edges / g_bfs_time_sec : 0.0;
+  if (kLevel != kMetricsNone) {
+    const double bytes_est = g_metrics.BytesEstimate(sizeof(NodeID),
+                                                     State::Bytes());
+    const double Ie = (bytes_est > 0.0) ? g_traversed_edges / bytes_est : 0.0;
+    cout << "Metrics: " << MetricsLevelName(kLevel) << endl;
+    cout << "Estimated bytes: " << fixed << setprecision(0) << bytes_est
+         << endl;
+    cout << "Edges per byte (Ie): " << setprecision(6) << Ie << endl;
+    MachineProfile profile;
+    if (profile.Load(MachineProfile::DefaultPath()))
+      PrintTraversalRoofline(cout, profile, Ie, teps, ProfileThreads());
+  }
+  cout << "TEPS: " << fixed << setprecision(3) << teps << endl;
+  if (kLevel != kMetricsNone)
+    cerr << "[mem] " << g_metrics << endl;
+}
+
+template <typename State>
+void RunLimited(MetricsLevel level, const CLApp &cli, const Graph &g) {
+  switch (level) {
+    case kMetricsNone:    RunLimited<State, kMetricsNone>(cli, g); break;
+    case kMetricsCounts:  RunLimited<State, kMetricsCounts>(cli, g); break;
+    case kMetricsFull:    RunLimited<State, kMetricsFull>(cli, g); break;
+    case kMetricsSampled: RunLimited<State, kMetricsSampled>(cli, g); break;
+  }
+}
+
+int main(int argc, char* argv[]) {
+  StripCustomArgs(argc, argv);
+  if (g_output != "depth16" && g_output != "depth8" && g_output != "count") {
+    cout << "--output must be depth16, depth8 or count" << endl;
+    return -1;
+  }
+  CLApp cli(argc, argv, "depth-limited breadth-first search");
+  if (!cli.ParseArgs()) return -1;
+
+  GraphProvider provider;
+  const Graph &g = provider.Get(cli, g_snapshot, g_prefault);
+  if (g_output == "depth8")
+    RunLimited<DepthState<uint8_t>>(g_metrics_level, cli, g);
+  else if (g_output == "count")
+    RunLimited<ReachState>(g_metrics_level, cli, g);
+  else
+    RunLimited<DepthState<uint16_t>>(g_metrics_level, cli, g);
+  return 0;
+}
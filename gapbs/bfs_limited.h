@@ -0,0 +1,245 @@
+#ifndef BFS_LIMITED_H_
+#define BFS_LIMITED_H_
+
+#include <cinttypes>
+#include <limits>
+#include <vector>
+
+#include "benchmark.h"
+#include "bfs_kernel.h"
+#include "bfs_metrics.h"
+#include "graph.h"
+#include "pvector.h"
+#include "sliding_queue.h"
+#include "timer.h"
+#include "word_bitmap.h"
+
+/*
+Distance-only, k-hop bounded and count-only BFS
+
+DOBFS keeps a 4-byte parent per vertex because it has to hand back a BFS
+tree. Queries that only want hop counts, or only the size of the reachable
+set, can carry less state per vertex:
+
+  DepthState<uint16_t>  2-byte depth, up to 65534 levels
+  DepthState<uint8_t>   1-byte depth, up to 254 levels
+  ReachState            1 bit per vertex (count-only)
+
+LimitedBFS is the DOBFS step structure (same alpha/beta switch) over one of
+these states, plus an optional max_depth after which it stops expanding.
+Level sizes are counted while traversing, so reporting needs no pass over
+the vertices. With metrics on, state accesses are counted as parent_reads /
+parent_writes and priced at State::Bytes() in the byte model, which is where
+the smaller state shows up as a higher Ie.
+
+A depth state too narrow for the graph's diameter stops at its last level
+and sets truncated, rather than wrapping.
+*/
+
+template <typename DepthT>
+class DepthState {
+ public:
+  static const DepthT kUnvisited = std::numeric_limits<DepthT>::max();
+  static int MaxLevel() { return kUnvisited - 1; }
+  static double Bytes() { return sizeof(DepthT); }
+  static const char* Name() { return sizeof(DepthT) == 1 ? "depth8" : "depth16"; }
+
+  explicit DepthState(int64_t n) : depth_(n) {}
+
+  void Reset() {
+    #pragma omp parallel for
+    for (int64_t v = 0; v < (int64_t) depth_.size(); v++)
+      depth_[v] = kUnvisited;
+  }
+
+  bool visited(NodeID v) const { return depth_[v] != kUnvisited; }
+  void mark(NodeID v, int level) { depth_[v] = static_cast<DepthT>(level); }
+  int depth(NodeID v) const { return visited(v) ? depth_[v] : -1; }
+
+ private:
+  pvector<DepthT> depth_;
+};
+
+class ReachState {
+ public:
+  static int MaxLevel() { return std::numeric_limits<int>::max(); }
+  static double Bytes() { return 1.0 / 8; }
+  static const char* Name() { return "count"; }
+
+  explicit ReachState(int64_t n) : seen_(n) {}
+
+  void Reset() { seen_.reset(); }
+  bool visited(NodeID v) const { return seen_.get_bit(v); }
+  void mark(NodeID v, int) { seen_.set_bit(v); }
+  int depth(NodeID) const { return -1; }             // not recorded
+
+ private:
+  WordBitmap seen_;
+};
+
+// State, frontier bitmaps and queue for one LimitedBFS at a time, reused
+// across trials like BfsWorkspace
+template <typename State>
+struct LimitedBfsWorkspace {
+  explicit LimitedBfsWorkspace(int64_t n)
+      : state(n), front(n), curr(n), queue(n) {}
+
+  State state;
+  WordBitmap front;
+  WordBitmap curr;
+  SlidingQueue<NodeID> queue;
+
+  // Results of the last run
+  NodeID source = -1;
+  int max_depth = -1;
+  bool truncated = false;
+  std::vector<int64_t> level_sizes;
+
+  int64_t reached() const {
+    int64_t total = 0;
+    for (int64_t n : level_sizes) total += n;
+    return total;
+  }
+};
+
+template <MetricsLevel kLevel, typename State>
+int64_t LimitedTDStep(const Graph &g, State &st, SlidingQueue<NodeID> &queue,
+                      int level, int64_t &edges_visited) {
+  ThreadMetrics<kLevel> m(g_metrics_bank);
+  int64_t scout_count = 0;
+  QueueBuffer<NodeID> lqueue(queue);
+  for (auto q_iter = queue.begin(); q_iter < queue.end(); q_iter++) {
+    for (NodeID v : g.out_neigh(*q_iter)) {
+      edges_visited++;
+      if (m.edge()) {
+        m.at_edge().col_ind_reads++;
+        m.at_edge().parent_reads++;                   // state read
+      }
+      if (!st.visited(v)) {
+        st.mark(v, level);
+        lqueue.push_back(v);
+        scout_count += g.out_degree(v);
+        if (m.enabled) {
+          m.exact().parent_writes++;
+          m.exact().frontier_pushes++;
+        }
+      }
+    }
+  }
+  lqueue.flush();
+  return scout_count;
+}
+
+template <MetricsLevel kLevel, typename State>
+int64_t LimitedBUStep(const Graph &g, State &st, const WordBitmap &front,
+                      WordBitmap &next, int level, int64_t &edges_visited) {
+  ThreadMetrics<kLevel> m(g_metrics_bank);
+  int64_t awake_count = 0;
+  next.reset();
+  for (NodeID u = 0; u < g.num_nodes(); u++) {
+    if (m.enabled) m.exact().parent_reads++;
+    if (st.visited(u))
+      continue;
+    for (NodeID v : g.in_neigh(u)) {
+      edges_visited++;
+      if (m.edge()) {
+        m.at_edge().col_ind_reads++;
+        m.at_edge().bitmap_reads++;
+      }
+      if (front.get_bit(v)) {
+        st.mark(u, level);
+        next.set_bit(u);
+        awake_count++;
+        if (m.enabled) {
+          m.exact().parent_writes++;
+          m.exact().bitmap_writes++;
+        }
+        break;
+      }
+    }
+  }
+  return awake_count;
+}
+
+// BFS from source that expands at most max_depth levels (< 0: no limit)
+template <MetricsLevel kLevel, typename State>
+void LimitedBFS(const Graph &g, NodeID source, int max_depth,
+                bool logging_enabled, LimitedBfsWorkspace<State> &ws,
+                int alpha = 15, int beta = 18) {
+  if (logging_enabled) PrintStep("Source", static_cast<int64_t>(source));
+  Timer t;
+  t.Start();
+  ws.state.Reset();
+  ws.front.reset();
+  ws.queue.reset();
+  t.Stop();
+  if (logging_enabled) PrintStep("i", t.Seconds());
+
+  ws.source = source;
+  ws.truncated = false;
+  ws.level_sizes.assign(1, 1);
+  int limit = State::MaxLevel();
+  if (max_depth >= 0 && max_depth < limit) limit = max_depth;
+  ws.max_depth = limit;
+
+  Timer t_total;
+  t_total.Start();
+  int64_t traversed_edges = 0;
+  State &st = ws.state;
+  SlidingQueue<NodeID> &queue = ws.queue;
+  st.mark(source, 0);
+  queue.push_back(source);
+  queue.slide_window();
+  int64_t edges_to_check = g.num_edges_directed();
+  int64_t scout_count = g.out_degree(source);
+  int level = 0;
+
+  while (!queue.empty() && level < limit) {
+    if (scout_count > edges_to_check / alpha) {
+      int64_t awake_count, old_awake_count;
+      ws.front.reset();
+      TIME_OP(t, QueueToBitmap<kLevel>(queue, ws.front));
+      if (logging_enabled) PrintStep("e", t.Seconds());
+      awake_count = queue.size();
+      queue.slide_window();
+      do {
+        t.Start();
+        old_awake_count = awake_count;
+        level++;
+        awake_count = LimitedBUStep<kLevel>(g, st, ws.front, ws.curr, level,
+                                            traversed_edges);
+        ws.front.swap(ws.curr);
+        t.Stop();
+        if (awake_count > 0) ws.level_sizes.push_back(awake_count);
+        if (logging_enabled) PrintStep("bu", t.Seconds(), awake_count);
+        MetricsStepDone<kLevel>(g_metrics_bank, g_metrics, "bu",
+                                logging_enabled);
+      } while (level < limit &&
+               ((awake_count >= old_awake_count) ||
+                (awake_count > g.num_nodes() / beta)));
+      TIME_OP(t, BitmapToQueue<kLevel>(ws.front, queue));
+      if (logging_enabled) PrintStep("c", t.Seconds());
+      scout_count = 1;
+    } else {
+      t.Start();
+      level++;
+      edges_to_check -= scout_count;
+      scout_count = LimitedTDStep<kLevel>(g, st, queue, level,
+                                          traversed_edges);
+      queue.slide_window();
+      t.Stop();
+      if (!queue.empty()) ws.level_sizes.push_back(queue.size());
+      if (logging_enabled) PrintStep("td", t.Seconds(), queue.size());
+      MetricsStepDone<kLevel>(g_metrics_bank, g_metrics, "td",
+                              logging_enabled);
+    }
+  }
+  ws.truncated = !queue.empty() && level == State::MaxLevel() &&
+                 (max_depth < 0 || max_depth > level);
+  t_total.Stop();
+  MetricsTrialDone<kLevel>(g_metrics_bank, g_metrics);
+  g_traversed_edges = traversed_edges;
+  g_bfs_time_sec = t_total.Seconds();
+}
+
+#endif  // BFS_LIMITED_H_
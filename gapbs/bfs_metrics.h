@@ -0,0 +1,267 @@
+#ifndef BFS_METRICS_H_
+#define BFS_METRICS_H_
+
+#include <cinttypes>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "cache_sim.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/*
+Compile-time switchable memory-event counters for the BFS steps
+
+TDStep/BUStep take a MetricsLevel template argument. Every counter update in
+the hot loops is guarded by a condition that is a compile-time constant for
+kMetricsNone, so that instantiation compiles to the uninstrumented loop of
+bfs_treps.cc.
+
+  kMetricsNone     no counting
+  kMetricsCounts   exact counts in per-thread, cache-line padded slots,
+                   merged into the totals once per trial
+  kMetricsFull     as counts, but merged after every step so per-step
+                   deltas can be logged next to PrintStep
+  kMetricsSampled  per-vertex events exact; per-edge events recorded for
+                   1 in kSampleEvery edges and scaled up at merge time
+
+Single-threaded builds use slot 0 only; with OpenMP each thread writes its
+own slot so the counters never race and never share a cache line.
+
+With a cache model attached (MetricsBank::EnableCacheSim), every counted
+event also replays its address through that thread's CacheHierarchy
+(cache_sim.h), so the same instrumentation points yield modeled misses and
+DRAM bytes next to the flat byte model. That needs every access, so it is
+only fed at kMetricsCounts and kMetricsFull.
+*/
+
+enum MetricsLevel {
+  kMetricsNone,
+  kMetricsCounts,
+  kMetricsFull,
+  kMetricsSampled
+};
+
+inline const char* MetricsLevelName(MetricsLevel level) {
+  switch (level) {
+    case kMetricsNone:    return "none";
+    case kMetricsCounts:  return "counts";
+    case kMetricsFull:    return "full";
+    case kMetricsSampled: return "sampled";
+  }
+  return "?";
+}
+
+inline bool ParseMetricsLevel(const std::string &name, MetricsLevel &level) {
+  if (name == "none") level = kMetricsNone;
+  else if (name == "counts") level = kMetricsCounts;
+  else if (name == "full") level = kMetricsFull;
+  else if (name == "sampled") level = kMetricsSampled;
+  else return false;
+  return true;
+}
+
+// Metrics: split visited-byte accesses from bitmap(front/curr)
+struct BfsMemMetrics {
+  int64_t col_ind_reads      = 0; // CSR neighbor index loads
+  int64_t parent_reads       = 0; // parent/visited reads (parent array)
+  int64_t parent_writes      = 0; // parent writes on discovery
+  int64_t frontier_pushes    = 0; // queue enqueues
+  int64_t bitmap_reads       = 0; // frontier/curr bitmap get_bit
+  int64_t bitmap_writes      = 0; // frontier/curr bitmap set_bit
+  int64_t visited_byte_reads = 0; // reads from visited[] byte array
+  int64_t visited_byte_writes= 0; // writes to visited[] byte array
+
+  void AddScaled(const BfsMemMetrics &o, int64_t k) {
+    col_ind_reads       += k * o.col_ind_reads;
+    parent_reads        += k * o.parent_reads;
+    parent_writes       += k * o.parent_writes;
+    frontier_pushes     += k * o.frontier_pushes;
+    bitmap_reads        += k * o.bitmap_reads;
+    bitmap_writes       += k * o.bitmap_writes;
+    visited_byte_reads  += k * o.visited_byte_reads;
+    visited_byte_writes += k * o.visited_byte_writes;
+  }
+
+  // Byte model: every event costs the size of the element it touches
+  double BytesEstimate(size_t node_bytes) const {
+    return BytesEstimate(node_bytes, node_bytes);
+  }
+
+  // state_bytes: size of one parent_* access when the per-vertex state is
+  // not a NodeID (depth arrays, or 1/8 for a visited bitmap; bfs_limited.h)
+  double BytesEstimate(size_t node_bytes, double state_bytes) const {
+    return (double)col_ind_reads      * node_bytes       +
+           (double)parent_reads       * state_bytes      +
+           (double)parent_writes      * state_bytes      +
+           (double)frontier_pushes    * node_bytes       +
+           (double)bitmap_reads       * sizeof(uint64_t) +
+           (double)bitmap_writes      * sizeof(uint64_t) +
+           (double)visited_byte_reads * sizeof(uint8_t)  +
+           (double)visited_byte_writes* sizeof(uint8_t);
+  }
+};
+
+inline std::ostream& operator<<(std::ostream &os, const BfsMemMetrics &m) {
+  return os << "col_reads=" << m.col_ind_reads
+            << " parent_reads=" << m.parent_reads
+            << " parent_writes=" << m.parent_writes
+            << " frontier_pushes=" << m.frontier_pushes
+            << " bitmap_reads=" << m.bitmap_reads
+            << " bitmap_writes=" << m.bitmap_writes
+            << " visited_reads=" << m.visited_byte_reads
+            << " visited_writes=" << m.visited_byte_writes;
+}
+
+// One slot per thread; exact and sampled events kept apart until merged
+struct alignas(64) MetricsSlot {
+  BfsMemMetrics exact;
+  BfsMemMetrics sampled;
+};
+
+class MetricsBank {
+ public:
+  MetricsBank() : num_slots_(MaxThreads()), sample_every_(64) {
+    void *mem = nullptr;
+    if (posix_memalign(&mem, 64, num_slots_ * sizeof(MetricsSlot)) != 0)
+      throw std::bad_alloc();
+    slots_ = new (mem) MetricsSlot[num_slots_];
+  }
+  ~MetricsBank() { free(slots_); }
+  MetricsBank(const MetricsBank &) = delete;
+  MetricsBank &operator=(const MetricsBank &) = delete;
+
+  MetricsSlot& local() {
+#ifdef _OPENMP
+    return slots_[omp_get_thread_num()];
+#else
+    return slots_[0];
+#endif
+  }
+
+  // Folds every slot into total (sampled events scaled) and clears them
+  BfsMemMetrics Drain() {
+    BfsMemMetrics total;
+    for (int i = 0; i < num_slots_; i++) {
+      total.AddScaled(slots_[i].exact, 1);
+      total.AddScaled(slots_[i].sampled, sample_every_);
+      slots_[i] = MetricsSlot();
+    }
+    return total;
+  }
+
+  int64_t sample_every() const { return sample_every_; }
+  void set_sample_every(int64_t k) { sample_every_ = k > 0 ? k : 1; }
+
+  // One hierarchy per slot; models persist (warm) across steps and trials
+  void EnableCacheSim(const CacheSimConfig &config) {
+    sims_.clear();
+    for (int i = 0; i < num_slots_; i++)
+      sims_.emplace_back(new CacheHierarchy(config));
+  }
+
+  bool cache_sim_enabled() const { return !sims_.empty(); }
+
+  CacheHierarchy* local_sim() {
+    if (sims_.empty()) return nullptr;
+#ifdef _OPENMP
+    return sims_[omp_get_thread_num()].get();
+#else
+    return sims_[0].get();
+#endif
+  }
+
+  CacheSimStats CacheTotals() const {
+    CacheSimStats total;
+    for (const std::unique_ptr<CacheHierarchy> &sim : sims_)
+      total.Add(sim->stats());
+    return total;
+  }
+
+ private:
+  static int MaxThreads() {
+#ifdef _OPENMP
+    return omp_get_max_threads();
+#else
+    return 1;
+#endif
+  }
+
+  MetricsSlot *slots_;
+  int num_slots_;
+  int64_t sample_every_;
+  std::vector<std::unique_ptr<CacheHierarchy>> sims_;
+};
+
+// Per-thread handle used inside TDStep/BUStep. For kMetricsNone all members
+// fold away: enabled is false and edge() is constant false.
+template <MetricsLevel kLevel>
+class ThreadMetrics {
+ public:
+  static const bool enabled = kLevel != kMetricsNone;
+
+  explicit ThreadMetrics(MetricsBank &bank)
+      : slot_(enabled ? &bank.local() : nullptr),
+        sim_(enabled && kLevel != kMetricsSampled ? bank.local_sim() : nullptr),
+        sample_every_(bank.sample_every()), countdown_(bank.sample_every()) {}
+
+  // Per-vertex events: always exact
+  BfsMemMetrics& exact() { return slot_->exact; }
+
+  // Call once per edge; true when this edge's events should be recorded
+  bool edge() {
+    if (kLevel == kMetricsNone) return false;
+    if (kLevel != kMetricsSampled) return true;
+    if (--countdown_ != 0) return false;
+    countdown_ = sample_every_;
+    return true;
+  }
+
+  // Where events of a recorded edge go
+  BfsMemMetrics& at_edge() {
+    return kLevel == kMetricsSampled ? slot_->sampled : slot_->exact;
+  }
+
+  // Replays the address of a counted event through the cache model, if any
+  template <typename T>
+  void read(const T *p) {
+    if (enabled && sim_ != nullptr) sim_->Access(p, sizeof(T), false);
+  }
+
+  template <typename T>
+  void write(const T *p) {
+    if (enabled && sim_ != nullptr) sim_->Access(p, sizeof(T), true);
+  }
+
+ private:
+  MetricsSlot *slot_;
+  CacheHierarchy *sim_;
+  int64_t sample_every_;
+  int64_t countdown_;
+};
+
+// Called after every step: kMetricsFull merges now (and logs the delta)
+template <MetricsLevel kLevel>
+inline void MetricsStepDone(MetricsBank &bank, BfsMemMetrics &totals,
+                            const char *step, bool logging_enabled) {
+  if (kLevel != kMetricsFull) return;
+  BfsMemMetrics delta = bank.Drain();
+  totals.AddScaled(delta, 1);
+  if (logging_enabled)
+    std::cout << "  [mem " << step << "] " << delta << std::endl;
+}
+
+// Called at the end of a trial: merges whatever is still in the slots
+template <MetricsLevel kLevel>
+inline void MetricsTrialDone(MetricsBank &bank, BfsMemMetrics &totals) {
+  if (kLevel == kMetricsNone) return;
+  totals.AddScaled(bank.Drain(), 1);
+}
+
+#endif  // BFS_METRICS_H_
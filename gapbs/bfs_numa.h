@@ -0,0 +1,634 @@
+#ifndef BFS_NUMA_H_
+#define BFS_NUMA_H_
+
+#include <sched.h>
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "benchmark.h"
+#include "bfs_kernel.h"
+#include "graph.h"
+#include "platform_atomics.h"
+#include "pvector.h"
+#include "timer.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/*
+NUMA-partitioned direction-optimizing BFS
+
+The vertex range is cut into P contiguous, edge-balanced partitions (cut
+points on 64-vertex boundaries, so no bitmap word is shared). Each
+partition lives on one NUMA node and owns, in memory first touched by its
+own threads:
+  - out- and in-edge CSR of its vertices (global neighbor ids)
+  - its slice of parent[] and its frontier queue
+  - a full replica of the front and next bitmaps
+OpenMP thread t serves partition t % P (or, with fewer threads than
+partitions, partitions t, t + T, ...) and is pinned to that node's CPUs
+for the length of each BFS. The original masks are restored afterwards, so
+other variants in the same process are unaffected.
+
+Steps mirror DOBFS and switch with the same alpha/beta rules:
+  td  each partition expands its local queue over local out-edges. Hits on
+      its own vertices are claimed in place; hits on another partition's
+      vertices are appended to a per-thread outbox for that partition. A
+      second pass has every partition drain the outboxes addressed to it,
+      so remote memory is only ever read in sequential batches
+  bu  each partition scans its own unvisited vertices against its local
+      front replica and sets bits in its slice of next. The slices are then
+      copied into every other replica (P - 1 slice copies per partition),
+      so the scan itself never leaves the node
+  e/c the conversions work on owned words only, plus one replica exchange
+
+Without --numa-parts the partition count is the number of NUMA nodes in
+/sys/devices/system/node. --numa-parts=P overrides it, and partitions are
+then spread round-robin over the real nodes with each node's CPUs split
+among its partitions. On a one-node machine that simulates P sockets: the
+traffic counters (remote updates, replica bytes) are the ones a P-socket
+box would see, only the latencies are local.
+
+The variant is "numa" in bfs_variants.h; bfs_ab takes --numa-parts and
+--numa-bind.
+*/
+
+struct NumaOptions {
+  int parts = 0;        // 0: one partition per NUMA node
+  bool bind = true;     // pin worker threads to their partition's CPUs
+};
+
+// Partitioning settings for the "numa" variant (one copy, see bfs_kernel.h)
+inline NumaOptions& BfsNumaOptions() { static NumaOptions v; return v; }
+static NumaOptions &g_numa = BfsNumaOptions();
+
+// --numa-parts=P, --numa-bind=0|1; returns false if a is not a numa flag
+inline bool ParseNumaArg(const std::string &a, NumaOptions &opts) {
+  if (a.compare(0, 13, "--numa-parts=") == 0)
+    opts.parts = atoi(a.c_str() + 13);
+  else if (a.compare(0, 12, "--numa-bind=") == 0)
+    opts.bind = atoi(a.c_str() + 12) != 0;
+  else
+    return false;
+  return true;
+}
+
+// Traffic totals across runs
+struct NumaStats {
+  int parts = 0;
+  int64_t runs = 0;
+  int64_t td_edges = 0;
+  int64_t remote_updates = 0;     // outbox entries (vertex, parent)
+  int64_t replica_bytes = 0;      // bitmap slices copied between partitions
+  int64_t bu_edges = 0;
+
+  void Print() const {
+    if (runs == 0) return;
+    std::cout << "NUMA partitions: " << parts << ", per BFS: "
+              << remote_updates / runs << " remote updates ("
+              << (td_edges > 0 ? 100.0 * remote_updates / td_edges : 0.0)
+              << "% of td edges), "
+              << replica_bytes / runs / double(1 << 20)
+              << " MiB bitmap exchange" << std::endl;
+  }
+};
+
+inline NumaStats& BfsNumaStats() { static NumaStats v; return v; }
+static NumaStats &g_numa_stats = BfsNumaStats();
+
+inline int NumaThreadNum() {
+#ifdef _OPENMP
+  return omp_get_thread_num();
+#else
+  return 0;
+#endif
+}
+
+inline int NumaMaxThreads() {
+#ifdef _OPENMP
+  return omp_get_max_threads();
+#else
+  return 1;
+#endif
+}
+
+// "0-3,8,10-11" -> set
+inline void ParseCpuList(const char *list, cpu_set_t &set) {
+  CPU_ZERO(&set);
+  const char *p = list;
+  while (*p != '\0' && *p != '\n') {
+    char *end;
+    long lo = strtol(p, &end, 10);
+    long hi = lo;
+    if (end == p) break;
+    if (*end == '-') {
+      p = end + 1;
+      hi = strtol(p, &end, 10);
+    }
+    for (long c = lo; c <= hi && c < CPU_SETSIZE; c++)
+      CPU_SET(c, &set);
+    p = *end == ',' ? end + 1 : end;
+  }
+}
+
+// Allowed CPUs of every NUMA node that has any
+inline std::vector<cpu_set_t> DiscoverNumaNodes() {
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  sched_getaffinity(0, sizeof(allowed), &allowed);
+  std::vector<cpu_set_t> nodes;
+  for (int n = 0; ; n++) {
+    char path[64];
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", n);
+    FILE *f = fopen(path, "r");
+    if (f == nullptr) break;
+    char buf[4096] = {0};
+    size_t len = fread(buf, 1, sizeof(buf) - 1, f);
+    fclose(f);
+    buf[len] = '\0';
+    cpu_set_t set;
+    ParseCpuList(buf, set);
+    CPU_AND(&set, &set, &allowed);
+    if (CPU_COUNT(&set) > 0)
+      nodes.push_back(set);
+  }
+  if (nodes.empty())
+    nodes.push_back(allowed);
+  return nodes;
+}
+
+// Splits set into `ways` contiguous groups and returns group i
+inline cpu_set_t CpuShare(const cpu_set_t &set, int i, int ways) {
+  std::vector<int> cpus;
+  for (int c = 0; c < CPU_SETSIZE; c++)
+    if (CPU_ISSET(c, &set)) cpus.push_back(c);
+  cpu_set_t share;
+  CPU_ZERO(&share);
+  if (ways >= static_cast<int>(cpus.size())) {
+    CPU_SET(cpus[i % cpus.size()], &share);
+    return share;
+  }
+  size_t lo = cpus.size() * i / ways, hi = cpus.size() * (i + 1) / ways;
+  for (size_t k = lo; k < hi; k++)
+    CPU_SET(cpus[k], &share);
+  return share;
+}
+
+struct NumaVertexUpdate {
+  NodeID v;
+  NodeID parent;
+};
+
+// One partition: vertices [lo, hi) and everything the BFS touches for them
+struct NumaPart {
+  NodeID lo = 0, hi = 0;
+  int64_t lo_word = 0, hi_word = 0;    // owned bitmap words
+  cpu_set_t cpus;
+  std::vector<int> workers;            // OpenMP thread ids serving it
+  pvector<SGOffset> out_index, in_index;
+  pvector<NodeID> out_neigh, in_neigh;
+  pvector<NodeID> parent;              // parent[v - lo]
+  pvector<NodeID> queue, next_queue;
+  int64_t queue_size = 0, next_size = 0;
+  pvector<uint64_t> front, next;       // full-size replicas
+
+  bool owns(NodeID v) const { return v >= lo && v < hi; }
+  int64_t out_degree(NodeID v) const {
+    return out_index[v - lo + 1] - out_index[v - lo];
+  }
+};
+
+// Appends to a partition's next queue in batches
+class NumaQueueBuffer {
+ public:
+  explicit NumaQueueBuffer(NumaPart &part) : part_(part), n_(0) {}
+  ~NumaQueueBuffer() { flush(); }
+
+  void push_back(NodeID v) {
+    if (n_ == kSize) flush();
+    buf_[n_++] = v;
+  }
+
+  void flush() {
+    if (n_ == 0) return;
+    int64_t start = fetch_and_add(part_.next_size, static_cast<int64_t>(n_));
+    std::copy(buf_, buf_ + n_, part_.next_queue.data() + start);
+    n_ = 0;
+  }
+
+ private:
+  static const int kSize = 1024;
+  NumaPart &part_;
+  int n_;
+  NodeID buf_[kSize];
+};
+
+class NumaGraph {
+ public:
+  NumaGraph() : g_(nullptr), num_threads_(0), num_words_(0) {}
+
+  int num_parts() const { return parts_.size(); }
+
+  // Partitions g (once per graph) for the current thread count and options
+  void Prepare(const Graph &g, const NumaOptions &opts) {
+    if (g_ == &g && num_threads_ == NumaMaxThreads() &&
+        opts_parts_ == opts.parts)
+      return;
+    g_ = &g;
+    num_threads_ = NumaMaxThreads();
+    opts_parts_ = opts.parts;
+    std::vector<cpu_set_t> nodes = DiscoverNumaNodes();
+    int num_parts = opts.parts > 0 ? opts.parts : nodes.size();
+    num_parts = std::max(1, num_parts);
+    num_words_ = (g.num_nodes() + 63) / 64;
+    parts_ = std::vector<NumaPart>(num_parts);
+
+    // Edge-balanced cut points, rounded to whole bitmap words
+    bounds_.assign(num_parts + 1, g.num_nodes());
+    bounds_[0] = 0;
+    const int64_t total = g.num_edges_directed() + g.num_nodes();
+    int64_t seen = 0;
+    int p = 1;
+    for (NodeID v = 0; v < g.num_nodes() && p < num_parts; v++) {
+      seen += g.out_degree(v) + 1;
+      if (seen >= total * p / num_parts && (v + 1) % 64 == 0)
+        bounds_[p++] = v + 1;
+    }
+    for (int q = 0; q < num_parts; q++) {
+      NumaPart &part = parts_[q];
+      part.lo = bounds_[q];
+      part.hi = std::max(bounds_[q], bounds_[q + 1]);
+      part.lo_word = part.lo / 64;
+      part.hi_word = (part.hi + 63) / 64;
+      if (part.lo == part.hi)
+        part.lo_word = part.hi_word = num_words_;
+      int node = q % nodes.size();
+      int per_node = (num_parts - node + nodes.size() - 1) / nodes.size();
+      part.cpus = CpuShare(nodes[node], q / nodes.size(), per_node);
+      part.workers.clear();
+    }
+    thread_parts_.assign(num_threads_, std::vector<int>());
+    for (int t = 0; t < num_threads_; t++) {
+      if (num_threads_ >= num_parts) {
+        thread_parts_[t].push_back(t % num_parts);
+        parts_[t % num_parts].workers.push_back(t);
+      } else {
+        for (int q = t; q < num_parts; q += num_threads_) {
+          thread_parts_[t].push_back(q);
+          parts_[q].workers.push_back(t);
+        }
+      }
+    }
+    g_numa_stats.parts = num_parts;
+    outbox_.assign(num_threads_, std::vector<std::vector<NumaVertexUpdate>>());
+
+    Bind(opts.bind);
+    // First touch by a thread of the owning partition
+    ForEachPart([&] (NumaPart &part, int rank, int) {
+      if (rank != 0) return;
+      const int64_t n = part.hi - part.lo;
+      part.out_index = pvector<SGOffset>(n + 1);
+      part.out_index[0] = 0;
+      for (NodeID v = part.lo; v < part.hi; v++)
+        part.out_index[v - part.lo + 1] =
+            part.out_index[v - part.lo] + g.out_degree(v);
+      part.out_neigh = pvector<NodeID>(part.out_index[n]);
+      for (NodeID v = part.lo; v < part.hi; v++)
+        std::copy(g.out_neigh(v).begin(), g.out_neigh(v).end(),
+                  part.out_neigh.data() + part.out_index[v - part.lo]);
+      if (g.directed()) {
+        part.in_index = pvector<SGOffset>(n + 1);
+        part.in_index[0] = 0;
+        for (NodeID v = part.lo; v < part.hi; v++)
+          part.in_index[v - part.lo + 1] =
+              part.in_index[v - part.lo] + g.in_degree(v);
+        part.in_neigh = pvector<NodeID>(part.in_index[n]);
+        for (NodeID v = part.lo; v < part.hi; v++)
+          std::copy(g.in_neigh(v).begin(), g.in_neigh(v).end(),
+                    part.in_neigh.data() + part.in_index[v - part.lo]);
+      }
+      part.parent = pvector<NodeID>(n);
+      part.queue = pvector<NodeID>(n);
+      part.next_queue = pvector<NodeID>(n);
+      part.front = pvector<uint64_t>(num_words_);
+      part.next = pvector<uint64_t>(num_words_);
+      std::fill(part.front.begin(), part.front.end(), 0);
+      std::fill(part.next.begin(), part.next.end(), 0);
+    });
+    #pragma omp parallel num_threads(num_threads_)
+    {
+      int t = NumaThreadNum();
+      outbox_[t].assign(num_parts, std::vector<NumaVertexUpdate>());
+    }
+    Unbind(opts.bind);
+    result_ = pvector<NodeID>(g.num_nodes());
+  }
+
+  const pvector<NodeID>& BFS(NodeID source, bool logging_enabled,
+                             const BFSOptions &opts, bool bind) {
+    const Graph &g = *g_;
+    if (logging_enabled) PrintStep("Source", static_cast<int64_t>(source));
+    Bind(bind);
+    Timer t;
+    t.Start();
+    ForEachPart([&] (NumaPart &part, int rank, int ways) {
+      for (NodeID v = part.lo + rank; v < part.hi; v += ways)
+        part.parent[v - part.lo] = -1;
+      if (rank == 0) {
+        part.queue_size = 0;
+        part.next_size = 0;
+      }
+    });
+    NumaPart &src = parts_[Owner(source)];
+    src.parent[source - src.lo] = source;
+    src.queue[0] = source;
+    src.queue_size = 1;
+    t.Stop();
+    if (logging_enabled) PrintStep("i", t.Seconds());
+
+    Timer t_total;
+    t_total.Start();
+    int64_t traversed_edges = 0;
+    int64_t edges_to_check = g.num_edges_directed();
+    int64_t scout_count = g.out_degree(source);
+    int64_t queue_size = 1;
+    while (queue_size > 0) {
+      if (scout_count > edges_to_check / opts.alpha) {
+        TIME_OP(t, QueueToReplicas());
+        if (logging_enabled) PrintStep("e", t.Seconds());
+        int64_t awake_count = queue_size, old_awake_count;
+        do {
+          t.Start();
+          old_awake_count = awake_count;
+          awake_count = BUStep(traversed_edges);
+          t.Stop();
+          if (logging_enabled) PrintStep("bu", t.Seconds(), awake_count);
+        } while ((awake_count >= old_awake_count) ||
+                 (awake_count > g.num_nodes() / opts.beta));
+        TIME_OP(t, queue_size = ReplicasToQueue());
+        if (logging_enabled) PrintStep("c", t.Seconds());
+        scout_count = 1;
+      } else {
+        t.Start();
+        edges_to_check -= scout_count;
+        scout_count = TDStep(traversed_edges, queue_size);
+        t.Stop();
+        if (logging_enabled) PrintStep("td", t.Seconds(), queue_size);
+      }
+    }
+    ForEachPart([&] (NumaPart &part, int rank, int ways) {
+      for (NodeID v = part.lo + rank; v < part.hi; v += ways)
+        result_[v] = part.parent[v - part.lo];
+    });
+    t_total.Stop();
+    Unbind(bind);
+    g_numa_stats.runs++;
+    g_traversed_edges = traversed_edges;
+    g_bfs_time_sec    = t_total.Seconds();
+    return result_;
+  }
+
+ private:
+  int Owner(NodeID v) const {
+    return std::upper_bound(bounds_.begin(), bounds_.end(), v) -
+           bounds_.begin() - 1;
+  }
+
+  // fn(part, rank among the part's workers, number of workers) for every
+  // partition the calling thread serves
+  template <typename F>
+  void ForEachPart(F fn) {
+    #pragma omp parallel num_threads(num_threads_)
+    {
+      int t = NumaThreadNum();
+      for (int q : thread_parts_[t]) {
+        NumaPart &part = parts_[q];
+        int rank = std::find(part.workers.begin(), part.workers.end(), t) -
+                   part.workers.begin();
+        fn(part, rank, part.workers.size());
+      }
+    }
+  }
+
+  void Bind(bool bind) {
+    if (!bind) return;
+    saved_masks_.resize(num_threads_);
+    #pragma omp parallel num_threads(num_threads_)
+    {
+      int t = NumaThreadNum();
+      sched_getaffinity(0, sizeof(cpu_set_t), &saved_masks_[t]);
+      sched_setaffinity(0, sizeof(cpu_set_t),
+                        &parts_[thread_parts_[t][0]].cpus);
+    }
+  }
+
+  void Unbind(bool bind) {
+    if (!bind) return;
+    #pragma omp parallel num_threads(num_threads_)
+    {
+      int t = NumaThreadNum();
+      sched_setaffinity(0, sizeof(cpu_set_t), &saved_masks_[t]);
+    }
+  }
+
+  // Copies every partition's owned words of a bitmap into all replicas
+  void ExchangeReplicas(pvector<uint64_t> NumaPart::*bitmap) {
+    ForEachPart([&] (NumaPart &part, int rank, int ways) {
+      for (const NumaPart &other : parts_) {
+        if (&other == &part) continue;
+        const uint64_t *src = (other.*bitmap).data();
+        uint64_t *dst = (part.*bitmap).data();
+        for (int64_t w = other.lo_word + rank; w < other.hi_word; w += ways)
+          dst[w] = src[w];
+      }
+    });
+    int64_t bytes = 0;
+    for (const NumaPart &part : parts_)
+      bytes += (part.hi_word - part.lo_word) * sizeof(uint64_t) *
+               (parts_.size() - 1);
+    g_numa_stats.replica_bytes += bytes;
+  }
+
+  // Returns the out-degree sum of the new frontier; queue_size is updated
+  int64_t TDStep(int64_t &edges_visited, int64_t &queue_size) {
+    int64_t edges = 0, scout_count = 0, remote = 0;
+    #pragma omp parallel num_threads(num_threads_) \
+        reduction(+ : edges, scout_count, remote)
+    {
+      int t = NumaThreadNum();
+      std::vector<std::vector<NumaVertexUpdate>> &outbox = outbox_[t];
+      for (int q : thread_parts_[t]) {
+        NumaPart &part = parts_[q];
+        NumaQueueBuffer lqueue(part);
+        int ways = part.workers.size();
+        int rank = std::find(part.workers.begin(), part.workers.end(), t) -
+                   part.workers.begin();
+        for (int64_t i = rank * 64; i < part.queue_size; i += ways * 64) {
+          int64_t end = std::min(i + 64, part.queue_size);
+          for (int64_t k = i; k < end; k++) {
+            NodeID u = part.queue[k];
+            for (SGOffset e = part.out_index[u - part.lo];
+                 e < part.out_index[u - part.lo + 1]; e++) {
+              NodeID v = part.out_neigh[e];
+              edges++;
+              if (!part.owns(v)) {
+                outbox[Owner(v)].push_back(NumaVertexUpdate{v, u});
+                remote++;
+                continue;
+              }
+              NodeID &slot = part.parent[v - part.lo];
+              if (slot == -1 &&
+                  compare_and_swap(slot, static_cast<NodeID>(-1), u)) {
+                lqueue.push_back(v);
+                scout_count += part.out_degree(v);
+              }
+            }
+          }
+        }
+      }
+    }
+    // Each partition drains the outboxes addressed to it
+    #pragma omp parallel num_threads(num_threads_) reduction(+ : scout_count)
+    {
+      int t = NumaThreadNum();
+      for (int q : thread_parts_[t]) {
+        NumaPart &part = parts_[q];
+        NumaQueueBuffer lqueue(part);
+        int ways = part.workers.size();
+        int rank = std::find(part.workers.begin(), part.workers.end(), t) -
+                   part.workers.begin();
+        for (int s = rank; s < num_threads_; s += ways) {
+          std::vector<NumaVertexUpdate> &box = outbox_[s][q];
+          for (const NumaVertexUpdate &m : box) {
+            NodeID &slot = part.parent[m.v - part.lo];
+            if (slot == -1 &&
+                compare_and_swap(slot, static_cast<NodeID>(-1), m.parent)) {
+              lqueue.push_back(m.v);
+              scout_count += part.out_degree(m.v);
+            }
+          }
+          box.clear();
+        }
+      }
+    }
+    queue_size = 0;
+    for (NumaPart &part : parts_) {
+      part.queue.swap(part.next_queue);
+      part.queue_size = part.next_size;
+      part.next_size = 0;
+      queue_size += part.queue_size;
+    }
+    edges_visited += edges;
+    g_numa_stats.td_edges += edges;
+    g_numa_stats.remote_updates += remote;
+    return scout_count;
+  }
+
+  // Returns the number of vertices woken up
+  int64_t BUStep(int64_t &edges_visited) {
+    const bool directed = g_->directed();
+    int64_t awake_count = 0, edges = 0;
+    #pragma omp parallel num_threads(num_threads_) \
+        reduction(+ : awake_count, edges)
+    {
+      int t = NumaThreadNum();
+      for (int q : thread_parts_[t]) {
+        NumaPart &part = parts_[q];
+        const pvector<SGOffset> &index = directed ? part.in_index
+                                                  : part.out_index;
+        const pvector<NodeID> &neigh = directed ? part.in_neigh
+                                                : part.out_neigh;
+        const uint64_t *front = part.front.data();
+        uint64_t *next = part.next.data();
+        int ways = part.workers.size();
+        int rank = std::find(part.workers.begin(), part.workers.end(), t) -
+                   part.workers.begin();
+        // Chunks of 16 words, so no two workers share a word of next
+        for (int64_t w0 = part.lo_word + rank * 16; w0 < part.hi_word;
+             w0 += ways * 16) {
+          int64_t w1 = std::min(w0 + 16, part.hi_word);
+          std::fill(next + w0, next + w1, 0);
+          NodeID v_end = std::min<int64_t>(w1 * 64, part.hi);
+          for (NodeID v = w0 * 64; v < v_end; v++) {
+            if (part.parent[v - part.lo] != -1)
+              continue;
+            for (SGOffset e = index[v - part.lo]; e < index[v - part.lo + 1];
+                 e++) {
+              NodeID u = neigh[e];
+              edges++;
+              if ((front[u >> 6] >> (u & 63)) & 1) {
+                part.parent[v - part.lo] = u;
+                next[v >> 6] |= uint64_t(1) << (v & 63);
+                awake_count++;
+                break;
+              }
+            }
+          }
+        }
+      }
+    }
+    ExchangeReplicas(&NumaPart::next);
+    for (NumaPart &part : parts_)
+      part.front.swap(part.next);
+    edges_visited += edges;
+    g_numa_stats.bu_edges += edges;
+    return awake_count;
+  }
+
+  void QueueToReplicas() {
+    ForEachPart([&] (NumaPart &part, int rank, int ways) {
+      for (int64_t w = part.lo_word + rank; w < part.hi_word; w += ways)
+        part.front[w] = 0;
+    });
+    ForEachPart([&] (NumaPart &part, int rank, int ways) {
+      for (int64_t i = rank; i < part.queue_size; i += ways) {
+        NodeID v = part.queue[i];
+        __sync_fetch_and_or(&part.front[v >> 6], uint64_t(1) << (v & 63));
+      }
+    });
+    ExchangeReplicas(&NumaPart::front);
+  }
+
+  // Rebuilds the local queues from owned front words; returns their total
+  int64_t ReplicasToQueue() {
+    ForEachPart([&] (NumaPart &part, int rank, int ways) {
+      NumaQueueBuffer lqueue(part);
+      for (int64_t w = part.lo_word + rank; w < part.hi_word; w += ways) {
+        uint64_t bits = part.front[w];
+        while (bits != 0) {
+          lqueue.push_back(static_cast<NodeID>(w * 64 + __builtin_ctzll(bits)));
+          bits &= bits - 1;
+        }
+      }
+    });
+    int64_t queue_size = 0;
+    for (NumaPart &part : parts_) {
+      part.queue.swap(part.next_queue);
+      part.queue_size = part.next_size;
+      part.next_size = 0;
+      queue_size += part.queue_size;
+    }
+    return queue_size;
+  }
+
+  const Graph *g_;
+  int num_threads_;
+  int opts_parts_ = -1;
+  int64_t num_words_;
+  std::vector<NodeID> bounds_;
+  std::vector<NumaPart> parts_;
+  std::vector<std::vector<int>> thread_parts_;
+  // outbox_[thread][partition]: td updates bound for another partition
+  std::vector<std::vector<std::vector<NumaVertexUpdate>>> outbox_;
+  std::vector<cpu_set_t> saved_masks_;
+  pvector<NodeID> result_;
+};
+
+#endif  // BFS_NUMA_H_
@@ -0,0 +1,457 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "benchmark.h"
+#include "command_line.h"
+#include "graph.h"
+#include "graph_snapshot.h"
+#include "msbfs.h"
+#include "pvector.h"
+#include "timer.h"
+
+/*
+BFS query daemon
+
+Loads the graph once (graph_snapshot.h, so --snapshot= makes restarts
+cheap) and answers BFS queries over a Unix domain socket. Queries that are
+waiting when a batch starts share one MultiSourceBFS traversal (up to 64 per
+batch), and the set arrays of that traversal stay allocated between batches.
+
+Protocol, one request per line:
+
+  <source> [depth_limit] [count|depths]
+
+  count   (default) "ok <source> reached <n> depth <d>" then one
+          "level <k> <n_k>" line per level
+  depths  "ok <source> reached <n> depth <d>" then one "<v> <depth>" line
+          per reached vertex
+
+A depth_limit of -1 (default) means unlimited. Every answer ends with a
+line "end". Other requests:
+
+  stats       queries and throughput so far, latency percentiles over the
+              last kLatencyWindow answers
+  shutdown    print stats and exit
+
+Errors are answered with "error <reason>" followed by "end". Errors and
+stats are answered at once, so they can overtake earlier queries of the same
+connection; the "ok <source>" line identifies each answer. Throughput in
+stats is queries answered over server uptime.
+
+Extra flags (stripped before CLApp sees them):
+  --socket=PATH        socket to listen on (default /tmp/gapbs-bfs.sock)
+  --max-batch=K        queries per traversal, 1..64 (default 64)
+  --batch-wait-us=U    after the first query of a batch arrives, wait up to
+                       U microseconds for more (default 0); the wait is a
+                       ppoll with the time left, so it is not rounded to ms
+  --snapshot=F, --snapshot-prefault=none|populate|background  as in bfs_ab
+
+Example:
+  ./bfs_server -g 20 --snapshot=/tmp/kron20.snap &
+  printf '0 3\n17 -1 depths\nstats\n' | socat - UNIX-CONNECT:/tmp/gapbs-bfs.sock
+*/
+
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+static string g_socket_path = "/tmp/gapbs-bfs.sock";
+static int g_max_batch = 64;
+static int g_batch_wait_us = 0;
+
+static string g_snapshot = "";
+static SnapshotPrefault g_prefault = kPrefaultNone;
+
+static volatile sig_atomic_t g_stop = 0;
+
+// Whole-string decimal integer; false for empty, trailing junk or overflow
+static bool ParseLong(const char *s, long &value) {
+  char *end;
+  errno = 0;
+  value = strtol(s, &end, 10);
+  return end != s && *end == '\0' && errno == 0;
+}
+
+// Returns false (after saying why) on a malformed value
+static bool StripCustomArgs(int& argc, char** argv) {
+  int out = 1;
+  for (int i = 1; i < argc; ++i) {
+    string a = argv[i];
+    long value;
+    if (a.compare(0, 9, "--socket=") == 0) g_socket_path = a.substr(9);
+    else if (a.compare(0, 12, "--max-batch=") == 0) {
+      if (!ParseLong(a.c_str() + 12, value) || value < 1 ||
+          value > SourceSet<1>::kWidth) {
+        cout << "--max-batch must be between 1 and " << SourceSet<1>::kWidth
+             << ", not " << a.substr(12) << endl;
+        return false;
+      }
+      g_max_batch = value;
+    }
+    else if (a.compare(0, 16, "--batch-wait-us=") == 0) {
+      if (!ParseLong(a.c_str() + 16, value) || value < 0 ||
+          value > INT32_MAX) {
+        cout << "--batch-wait-us must be a number of microseconds, not "
+             << a.substr(16) << endl;
+        return false;
+      }
+      g_batch_wait_us = value;
+    }
+    else if (a.compare(0, 11, "--snapshot=") == 0) g_snapshot = a.substr(11);
+    else if (a.compare(0, 20, "--snapshot-prefault=") == 0) {
+      if (!ParseSnapshotPrefault(a.substr(20), g_prefault))
+        cout << "Unknown prefault mode " << a.substr(20) << endl;
+    }
+    else argv[out++] = argv[i];
+  }
+  argc = out;
+  return true;
+}
+
+static void OnSignal(int) { g_stop = 1; }
+
+struct Client {
+  int fd;
+  string in;              // bytes received, not yet a full line
+  string out;             // bytes to send
+  bool closing = false;   // peer hung up; drop once out is flushed
+};
+
+struct Query {
+  int fd;
+  NodeID source;
+  int depth_limit;
+  bool want_depths;
+  Clock::time_point arrived;
+};
+
+// Query and batch counts since startup; latencies of the last
+// kLatencyWindow answers in a ring, so a long-running server holds and
+// sorts a bounded amount per stats request
+class QueryStats {
+ public:
+  static const size_t kLatencyWindow = 1 << 14;
+
+  QueryStats() : queries_(0), batches_(0), start_(Clock::now()) {
+    latencies_us_.reserve(kLatencyWindow);
+  }
+
+  void Record(Clock::time_point arrived, Clock::time_point done) {
+    double us = chrono::duration<double, micro>(done - arrived).count();
+    if (latencies_us_.size() < kLatencyWindow)
+      latencies_us_.push_back(us);
+    else
+      latencies_us_[queries_ % kLatencyWindow] = us;
+    queries_++;
+  }
+
+  void RecordBatch() { batches_++; }
+
+  string Summary() const {
+    ostringstream ss;
+    double secs = chrono::duration<double>(Clock::now() - start_).count();
+    vector<double> sorted(latencies_us_);
+    sort(sorted.begin(), sorted.end());
+    ss << fixed << setprecision(1)
+       << "queries " << queries_ << " batches " << batches_
+       << " qps " << (secs > 0 ? queries_ / secs : 0)
+       << " window " << sorted.size()
+       << " p50_us " << Percentile(sorted, 0.50)
+       << " p95_us " << Percentile(sorted, 0.95)
+       << " p99_us " << Percentile(sorted, 0.99) << "\n";
+    return ss.str();
+  }
+
+ private:
+  static double Percentile(const vector<double> &sorted, double p) {
+    if (sorted.empty()) return 0;
+    size_t i = static_cast<size_t>(p * (sorted.size() - 1) + 0.5);
+    return sorted[i];
+  }
+
+  vector<double> latencies_us_;
+  int64_t queries_;
+  int64_t batches_;
+  Clock::time_point start_;
+};
+
+class BFSServer {
+ public:
+  BFSServer(const Graph &g, int listen_fd) : g_(g), listen_fd_(listen_fd) {}
+
+  void Run() {
+    while (!g_stop) {
+      PollOnce(pending_.empty() ? 1000000 : 0);
+      if (pending_.empty())
+        continue;
+      if (g_batch_wait_us > 0 && (int) pending_.size() < g_max_batch) {
+        int64_t waited_us = chrono::duration_cast<chrono::microseconds>(
+            Clock::now() - pending_.front().arrived).count();
+        if (waited_us < g_batch_wait_us) {
+          PollOnce(g_batch_wait_us - waited_us);
+          continue;
+        }
+      }
+      RunBatch();
+    }
+    cout << stats_.Summary();
+  }
+
+ private:
+  // ppoll rather than poll, so batch waits under 1 ms are honored
+  void PollOnce(int64_t timeout_us) {
+    vector<pollfd> fds;
+    fds.push_back(pollfd{listen_fd_, POLLIN, 0});
+    for (const Client &c : clients_) {
+      short events = c.closing ? 0 : POLLIN;
+      if (!c.out.empty()) events |= POLLOUT;
+      fds.push_back(pollfd{c.fd, events, 0});
+    }
+    timespec timeout;
+    timeout.tv_sec = timeout_us / 1000000;
+    timeout.tv_nsec = (timeout_us % 1000000) * 1000;
+    if (ppoll(fds.data(), fds.size(), &timeout, nullptr) <= 0)
+      return;
+    if (fds[0].revents & POLLIN)
+      Accept();
+    for (size_t i = 1; i < fds.size(); i++) {
+      Client &c = clients_[i - 1];
+      if (fds[i].revents & (POLLIN | POLLHUP | POLLERR))
+        Read(c);
+      if (fds[i].revents & POLLOUT)
+        Flush(c);
+    }
+    Reap();
+  }
+
+  // A client that hung up is kept until its queued answers are sent
+  void Reap() {
+    auto done = [this](const Client &c) {
+      if (!c.closing || !c.out.empty()) return false;
+      for (const Query &q : pending_)
+        if (q.fd == c.fd) return false;
+      close(c.fd);
+      return true;
+    };
+    clients_.erase(remove_if(clients_.begin(), clients_.end(), done),
+                   clients_.end());
+  }
+
+  void Accept() {
+    int fd = accept(listen_fd_, nullptr, nullptr);
+    if (fd < 0) return;
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    Client c;
+    c.fd = fd;
+    clients_.push_back(c);
+  }
+
+  void Read(Client &c) {
+    char buf[4096];
+    while (true) {
+      ssize_t got = read(c.fd, buf, sizeof(buf));
+      if (got > 0) {
+        c.in.append(buf, got);
+        continue;
+      }
+      if (got == 0 || (errno != EAGAIN && errno != EWOULDBLOCK))
+        c.closing = true;
+      break;
+    }
+    size_t pos;
+    while ((pos = c.in.find('\n')) != string::npos) {
+      string line = c.in.substr(0, pos);
+      c.in.erase(0, pos + 1);
+      Parse(c, line);
+    }
+  }
+
+  void Flush(Client &c) {
+    while (!c.out.empty()) {
+      ssize_t sent = write(c.fd, c.out.data(), c.out.size());
+      if (sent <= 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+          c.out.clear();
+          c.closing = true;
+        }
+        break;
+      }
+      c.out.erase(0, sent);
+    }
+  }
+
+  Client* Find(int fd) {
+    for (Client &c : clients_)
+      if (c.fd == fd) return &c;
+    return nullptr;
+  }
+
+  void Parse(Client &c, const string &line) {
+    istringstream ss(line);
+    string word;
+    if (!(ss >> word))
+      return;
+    if (word == "stats") {
+      c.out += stats_.Summary() + "end\n";
+      return;
+    }
+    if (word == "shutdown") {
+      g_stop = 1;
+      return;
+    }
+    Query q;
+    q.fd = c.fd;
+    q.arrived = Clock::now();
+    q.depth_limit = -1;
+    q.want_depths = false;
+    long source;
+    string format;
+    if (!ParseLong(word.c_str(), source) || source < 0 ||
+        source >= g_.num_nodes()) {
+      c.out += "error bad source " + word + "\nend\n";
+      return;
+    }
+    q.source = static_cast<NodeID>(source);
+    if (ss >> word) {
+      long depth_limit;
+      if (!ParseLong(word.c_str(), depth_limit) || depth_limit < -1 ||
+          depth_limit > INT32_MAX) {
+        c.out += "error bad depth_limit " + word + "\nend\n";
+        return;
+      }
+      q.depth_limit = depth_limit;
+      if (ss >> format) {
+        if (format == "depths") {
+          q.want_depths = true;
+        } else if (format != "count") {
+          c.out += "error unknown format " + format + "\nend\n";
+          return;
+        }
+      }
+    }
+    pending_.push_back(q);
+  }
+
+  void RunBatch() {
+    vector<Query> batch;
+    while (!pending_.empty() && (int) batch.size() < g_max_batch) {
+      batch.push_back(pending_.front());
+      pending_.pop_front();
+    }
+    // Traverse as deep as the deepest query needs; shallower ones filter
+    int max_depth = 0;
+    vector<NodeID> sources;
+    for (const Query &q : batch) {
+      sources.push_back(q.source);
+      if (q.depth_limit < 0) max_depth = -1;
+      else if (max_depth >= 0) max_depth = max(max_depth, q.depth_limit);
+    }
+    vector<vector<int64_t>> levels(batch.size());
+    vector<vector<pair<NodeID, int>>> reached(batch.size());
+    auto visit = [&](NodeID v, const SourceSet<1> &fresh, int depth) {
+      ForEachSource(fresh, [&](int s) {
+        const Query &q = batch[s];
+        if (q.depth_limit >= 0 && depth > q.depth_limit)
+          return;
+        if ((int) levels[s].size() <= depth) levels[s].resize(depth + 1, 0);
+        levels[s][depth]++;
+        if (q.want_depths) reached[s].push_back(make_pair(v, depth));
+      });
+    };
+    MultiSourceBFS<1>(g_, sources, visit, ws_, false, 15, max_depth);
+    stats_.RecordBatch();
+
+    for (size_t s = 0; s < batch.size(); s++) {
+      Client *c = Find(batch[s].fd);
+      if (c == nullptr)
+        continue;                                     // client went away
+      int64_t total = 0;
+      for (int64_t n : levels[s]) total += n;
+      ostringstream ss;
+      ss << "ok " << batch[s].source << " reached " << total
+         << " depth " << (int64_t) levels[s].size() - 1 << "\n";
+      if (batch[s].want_depths) {
+        for (const pair<NodeID, int> &p : reached[s])
+          ss << p.first << " " << p.second << "\n";
+      } else {
+        for (size_t d = 0; d < levels[s].size(); d++)
+          ss << "level " << d << " " << levels[s][d] << "\n";
+      }
+      ss << "end\n";
+      c->out += ss.str();
+      Flush(*c);
+      stats_.Record(batch[s].arrived, Clock::now());
+    }
+    Reap();
+  }
+
+  const Graph &g_;
+  int listen_fd_;
+  vector<Client> clients_;
+  deque<Query> pending_;
+  MSBFSWorkspace<1> ws_;
+  QueryStats stats_;
+};
+
+static int Listen(const string &path) {
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) return -1;
+  sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(addr.sun_path)) {
+    close(fd);
+    return -1;
+  }
+  strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+  unlink(path.c_str());
+  if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+      listen(fd, 64) != 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+int main(int argc, char* argv[]) {
+  if (!StripCustomArgs(argc, argv)) return -1;
+  CLApp cli(argc, argv, "BFS query server");
+  if (!cli.ParseArgs()) return -1;
+
+  GraphProvider provider;
+  const Graph &g = provider.Get(cli, g_snapshot, g_prefault);
+  g.PrintStats();
+
+  int listen_fd = Listen(g_socket_path);
+  if (listen_fd < 0) {
+    cout << "Cannot listen on " << g_socket_path << endl;
+    return -1;
+  }
+  signal(SIGINT, OnSignal);
+  signal(SIGTERM, OnSignal);
+  signal(SIGPIPE, SIG_IGN);
+  cout << "Listening on " << g_socket_path << endl;
+
+  BFSServer server(g, listen_fd);
+  server.Run();
+  close(listen_fd);
+  unlink(g_socket_path.c_str());
+  return 0;
+}
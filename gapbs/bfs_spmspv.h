@@ -0,0 +1,243 @@
+#ifndef BFS_SPMSPV_H_
+#define BFS_SPMSPV_H_
+
+#include <cinttypes>
+#include <memory>
+
+#include "benchmark.h"
+#include "bfs_kernel.h"
+#include "graph.h"
+#include "platform_atomics.h"
+#include "pvector.h"
+#include "sliding_queue.h"
+#include "timer.h"
+#include "word_bitmap.h"
+
+/*
+Linear-algebra BFS: masked SpMSpV over a semiring
+
+Each level computes y = A^T x masked by the complement of the visited
+vector p, then p += y and x = y with every value replaced by its own index.
+x and y hold parent candidates, so p ends up as the BFS parent array. The
+semiring decides how candidates combine:
+
+  AnySemiring  boolean (or, and) carrying the source id; any candidate
+               wins, so the dense product can stop at the first hit
+  MinSemiring  (min, select-first); the smallest parent id wins, so the
+               tree is the same for every thread count
+
+Two forms of the product, picked per level like TDStep/BUStep in DOBFS:
+  push  x sparse (index list). Walks out_neigh (A^T by rows), folds each
+        product into a dense sparse-accumulator (SPA) with the semiring's
+        atomic add, and records an index the first time a slot leaves zero.
+        The mask is tested before the fold
+  pull  x dense (bitmap). For every unmasked v, folds over in_neigh(v) (the
+        CSC of A^T) and tests x's bitmap. Semirings with an annihilating add
+        break at the first hit
+The switch uses DOBFS's fixed rules (alpha, beta from BFSOptions).
+
+This is a reference engine, not a tuned one. It pays for the generality
+with a separate accumulate-then-apply pass per push level and no
+visited-byte fast path, which is the cost the A/B comparison with DOBFS
+measures (variants "spmspv" and "spmspv-min" in bfs_variants.h).
+*/
+
+// Boolean semiring carrying the source id: add is "any", multiply selects
+// the source
+struct AnySemiring {
+  static const bool kAnnihilates = true;
+  static NodeID Multiply(NodeID u) { return u; }
+  // Folds val into acc; true if acc was zero before
+  static bool AtomicAdd(NodeID &acc, NodeID val) {
+    return acc == -1 && compare_and_swap(acc, static_cast<NodeID>(-1), val);
+  }
+  static NodeID Add(NodeID acc, NodeID val) { return acc == -1 ? val : acc; }
+};
+
+// (min, select-first): deterministic parents
+struct MinSemiring {
+  static const bool kAnnihilates = false;
+  static NodeID Multiply(NodeID u) { return u; }
+  static bool AtomicAdd(NodeID &acc, NodeID val) {
+    NodeID old_val = acc;
+    while (old_val == -1 || val < old_val) {
+      if (compare_and_swap(acc, old_val, val))
+        return old_val == -1;
+      old_val = acc;
+    }
+    return false;
+  }
+  static NodeID Add(NodeID acc, NodeID val) {
+    return acc == -1 || val < acc ? val : acc;
+  }
+};
+
+// Vectors for one BFS, reused across runs. parent is the visited mask and
+// the result; spa is the push accumulator and stays all -1 between levels.
+class SpMSpVWorkspace {
+ public:
+  SpMSpVWorkspace() : num_nodes_(-1), x_bits_(0), y_bits_(0) {}
+
+  void Reset(const Graph &g, NodeID source) {
+    if (num_nodes_ != g.num_nodes()) {
+      num_nodes_ = g.num_nodes();
+      parent_ = pvector<NodeID>(num_nodes_);
+      spa_ = pvector<NodeID>(num_nodes_);
+      WordBitmap(num_nodes_).swap(x_bits_);
+      WordBitmap(num_nodes_).swap(y_bits_);
+      x_idx_.reset(new SlidingQueue<NodeID>(num_nodes_));
+    }
+    #pragma omp parallel for
+    for (NodeID n = 0; n < num_nodes_; n++) {
+      parent_[n] = -1;
+      spa_[n] = -1;
+    }
+    parent_[source] = source;
+    x_idx_->reset();
+  }
+
+  pvector<NodeID>& parent() { return parent_; }
+  pvector<NodeID>& spa() { return spa_; }
+  WordBitmap& x_bits() { return x_bits_; }
+  WordBitmap& y_bits() { return y_bits_; }
+  SlidingQueue<NodeID>& x_idx() { return *x_idx_; }
+
+ private:
+  int64_t num_nodes_;
+  pvector<NodeID> parent_;
+  pvector<NodeID> spa_;
+  WordBitmap x_bits_;
+  WordBitmap y_bits_;
+  std::unique_ptr<SlidingQueue<NodeID>> x_idx_;
+};
+
+// y = A^T x .* !mask with x sparse; y's pattern replaces x's in x_idx,
+// values land in parent. Returns the out-degree sum of y (next scout count).
+template <typename Semiring>
+int64_t MaskedSpMSpV(const Graph &g, SpMSpVWorkspace &ws,
+                     int64_t &edges_visited) {
+  pvector<NodeID> &parent = ws.parent();
+  pvector<NodeID> &spa = ws.spa();
+  SlidingQueue<NodeID> &x_idx = ws.x_idx();
+  int64_t edges = 0;
+  // Multiply and accumulate
+  #pragma omp parallel reduction(+ : edges)
+  {
+    QueueBuffer<NodeID> y_idx(x_idx);
+    #pragma omp for nowait schedule(dynamic, 64)
+    for (auto q_iter = x_idx.begin(); q_iter < x_idx.end(); q_iter++) {
+      NodeID u = *q_iter;
+      NodeID product = Semiring::Multiply(u);
+      for (NodeID v : g.out_neigh(u)) {
+        edges++;
+        if (parent[v] != -1)
+          continue;
+        if (Semiring::AtomicAdd(spa[v], product))
+          y_idx.push_back(v);
+      }
+    }
+    y_idx.flush();
+  }
+  x_idx.slide_window();
+  // Apply: p += y, clear the accumulator
+  int64_t scout_count = 0;
+  #pragma omp parallel for reduction(+ : scout_count)
+  for (auto q_iter = x_idx.begin(); q_iter < x_idx.end(); q_iter++) {
+    NodeID v = *q_iter;
+    parent[v] = spa[v];
+    spa[v] = -1;
+    scout_count += g.out_degree(v);
+  }
+  edges_visited += edges;
+  return scout_count;
+}
+
+// y = A^T x .* !mask with x dense (x_bits); y's pattern goes to y_bits,
+// values to parent. Returns nnz(y).
+template <typename Semiring>
+int64_t MaskedSpMV(const Graph &g, SpMSpVWorkspace &ws,
+                   int64_t &edges_visited) {
+  pvector<NodeID> &parent = ws.parent();
+  const WordBitmap &x = ws.x_bits();
+  WordBitmap &y = ws.y_bits();
+  int64_t awake_count = 0;
+  int64_t edges = 0;
+  y.reset();
+  #pragma omp parallel for reduction(+ : awake_count, edges) \
+      schedule(dynamic, 1024)
+  for (NodeID v = 0; v < g.num_nodes(); v++) {
+    if (parent[v] != -1)
+      continue;
+    NodeID acc = -1;
+    for (NodeID u : g.in_neigh(v)) {
+      edges++;
+      if (x.get_bit(u)) {
+        acc = Semiring::Add(acc, Semiring::Multiply(u));
+        if (Semiring::kAnnihilates)
+          break;
+      }
+    }
+    if (acc != -1) {
+      parent[v] = acc;
+      y.set_bit_atomic(v);
+      awake_count++;
+    }
+  }
+  edges_visited += edges;
+  return awake_count;
+}
+
+template <typename Semiring>
+const pvector<NodeID>& SpMSpVBFS(const Graph &g, NodeID source,
+                                 bool logging_enabled, const BFSOptions &opts,
+                                 SpMSpVWorkspace &ws) {
+  if (logging_enabled) PrintStep("Source", static_cast<int64_t>(source));
+  Timer t;
+  t.Start();
+  ws.Reset(g, source);
+  t.Stop();
+  if (logging_enabled) PrintStep("i", t.Seconds());
+
+  Timer t_total;
+  t_total.Start();
+  int64_t traversed_edges = 0;
+  SlidingQueue<NodeID> &x_idx = ws.x_idx();
+  x_idx.push_back(source);
+  x_idx.slide_window();
+  int64_t edges_to_check = g.num_edges_directed();
+  int64_t scout_count = g.out_degree(source);
+  while (!x_idx.empty()) {
+    if (scout_count > edges_to_check / opts.alpha) {
+      int64_t awake_count, old_awake_count;
+      ws.x_bits().reset();
+      TIME_OP(t, QueueToBitmap<kMetricsNone>(x_idx, ws.x_bits()));
+      if (logging_enabled) PrintStep("e", t.Seconds());
+      awake_count = x_idx.size();
+      x_idx.slide_window();
+      do {
+        t.Start();
+        old_awake_count = awake_count;
+        awake_count = MaskedSpMV<Semiring>(g, ws, traversed_edges);
+        ws.x_bits().swap(ws.y_bits());
+        t.Stop();
+        if (logging_enabled) PrintStep("pull", t.Seconds(), awake_count);
+      } while ((awake_count >= old_awake_count) ||
+               (awake_count > g.num_nodes() / opts.beta));
+      TIME_OP(t, BitmapToQueue<kMetricsNone>(ws.x_bits(), x_idx));
+      if (logging_enabled) PrintStep("c", t.Seconds());
+      scout_count = 1;
+    } else {
+      t.Start();
+      edges_to_check -= scout_count;
+      scout_count = MaskedSpMSpV<Semiring>(g, ws, traversed_edges);
+      t.Stop();
+      if (logging_enabled) PrintStep("push", t.Seconds(), x_idx.size());
+    }
+  }
+  t_total.Stop();
+  g_traversed_edges = traversed_edges;
+  g_bfs_time_sec    = t_total.Seconds();
+  return ws.parent();
+}
+
+#endif  // BFS_SPMSPV_H_
@@ -0,0 +1,257 @@
+#ifndef BFS_TRACE_H_
+#define BFS_TRACE_H_
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "benchmark.h"
+#include "bfs_metrics.h"
+
+/*
+Per-step BFS trace (--trace=FILE)
+
+Every point that calls PrintStep in DOBFS ("i", "e", "td", "bu", "c") also
+hands TraceWriter one record: trial, step index, kind, source, frontier
+size after the step, edges examined, seconds, the g_metrics delta over the
+step and, with counters on, deltas of three hardware counters. g_metrics
+only has per-step deltas under --metrics=full; at the other levels the
+td/bu columns stay zero and the trial totals land on the trial's last
+record.
+
+Records are 128 bytes and collect in memory. They are written to disk when
+the trial ends, after its timer has stopped, so writing is never timed.
+A FILE ending in .csv gets one header line and one row per record. Any
+other name gets a 64-byte header followed by raw records, which load with
+numpy (see README.md):
+
+  magic "BFSTRC1\0", u32 version, u32 record bytes, u32 counters valid
+
+Counters come from perf_event_open for the calling thread, user space
+only: cycles, instructions, cache misses. Under OpenMP only the master
+thread's share is counted. If the kernel refuses the events, the columns
+are -1.
+
+With no --trace, each hook is one untaken branch per step.
+*/
+
+struct TraceRecord {
+  int32_t trial;
+  int32_t step;
+  char kind[4];
+  int32_t source;
+  int64_t frontier;
+  int64_t edges;
+  double seconds;
+  BfsMemMetrics mem;
+  int64_t counters[3];
+};
+
+static_assert(sizeof(TraceRecord) == 128, "trace record layout changed");
+
+class PerfCounters {
+ public:
+  static const int kNum = 3;
+
+  PerfCounters() { for (int i = 0; i < kNum; i++) fd_[i] = -1; }
+  ~PerfCounters() { Close(); }
+  PerfCounters(const PerfCounters &) = delete;
+  PerfCounters &operator=(const PerfCounters &) = delete;
+
+  static const char* Name(int i) {
+    static const char* names[kNum] = {"cycles", "instructions",
+                                      "cache_misses"};
+    return names[i];
+  }
+
+  // True if at least one counter could be opened
+  bool Open() {
+    const uint64_t events[kNum] = {PERF_COUNT_HW_CPU_CYCLES,
+                                   PERF_COUNT_HW_INSTRUCTIONS,
+                                   PERF_COUNT_HW_CACHE_MISSES};
+    bool any = false;
+    for (int i = 0; i < kNum; i++) {
+      perf_event_attr attr;
+      memset(&attr, 0, sizeof(attr));
+      attr.size = sizeof(attr);
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.config = events[i];
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      fd_[i] = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+      if (fd_[i] >= 0) {
+        ioctl(fd_[i], PERF_EVENT_IOC_ENABLE, 0);
+        any = true;
+      }
+    }
+    return any;
+  }
+
+  void Close() {
+    for (int i = 0; i < kNum; i++) {
+      if (fd_[i] >= 0) close(fd_[i]);
+      fd_[i] = -1;
+    }
+  }
+
+  // Current values, -1 for counters that are not open
+  void Read(int64_t *values) const {
+    for (int i = 0; i < kNum; i++) {
+      uint64_t v;
+      if (fd_[i] >= 0 && read(fd_[i], &v, sizeof(v)) == sizeof(v))
+        values[i] = v;
+      else
+        values[i] = -1;
+    }
+  }
+
+ private:
+  int fd_[kNum];
+};
+
+class TraceWriter {
+ public:
+  static const uint32_t kVersion = 1;
+  static const size_t kHeaderBytes = 64;
+
+  TraceWriter() : file_(nullptr), csv_(false), counters_on_(false) {}
+  ~TraceWriter() { Close(); }
+  TraceWriter(const TraceWriter &) = delete;
+  TraceWriter &operator=(const TraceWriter &) = delete;
+
+  bool Open(const std::string &path, bool counters) {
+    file_ = fopen(path.c_str(), "w");
+    if (file_ == nullptr)
+      return false;
+    csv_ = path.size() >= 4 && path.compare(path.size() - 4, 4, ".csv") == 0;
+    counters_on_ = counters && perf_.Open();
+    if (counters && !counters_on_)
+      fprintf(stderr, "trace: hardware counters unavailable\n");
+    if (csv_) {
+      fprintf(file_, "trial,step,kind,source,frontier,edges,seconds,"
+              "col_ind_reads,parent_reads,parent_writes,frontier_pushes,"
+              "bitmap_reads,bitmap_writes,visited_byte_reads,"
+              "visited_byte_writes");
+      for (int i = 0; i < PerfCounters::kNum; i++)
+        fprintf(file_, ",%s", PerfCounters::Name(i));
+      fprintf(file_, "\n");
+    } else {
+      char header[kHeaderBytes];
+      memset(header, 0, sizeof(header));
+      memcpy(header, "BFSTRC1", 8);
+      uint32_t fields[3] = {kVersion, sizeof(TraceRecord),
+                            counters_on_ ? 1u : 0u};
+      memcpy(header + 8, fields, sizeof(fields));
+      fwrite(header, 1, sizeof(header), file_);
+    }
+    return true;
+  }
+
+  void Close() {
+    if (file_ == nullptr)
+      return;
+    Flush();
+    fclose(file_);
+    file_ = nullptr;
+    perf_.Close();
+  }
+
+  bool enabled() const { return file_ != nullptr; }
+
+  void BeginTrial(NodeID source) {
+    if (!enabled()) return;
+    source_ = source;
+    step_ = 0;
+  }
+
+  // Snapshot taken before each step
+  void BeginStep(const BfsMemMetrics &metrics) {
+    if (!enabled()) return;
+    before_ = metrics;
+    if (counters_on_) perf_.Read(counters_before_);
+  }
+
+  void EndStep(const char *kind, double seconds, int64_t frontier,
+               int64_t edges, const BfsMemMetrics &metrics) {
+    if (!enabled()) return;
+    TraceRecord r = TraceRecord();
+    r.trial = trial_;
+    r.step = step_++;
+    memcpy(r.kind, kind, std::min(strlen(kind), sizeof(r.kind)));
+    r.source = source_;
+    r.frontier = frontier;
+    r.edges = edges;
+    r.seconds = seconds;
+    r.mem = metrics;
+    r.mem.AddScaled(before_, -1);
+    if (counters_on_) {
+      perf_.Read(r.counters);
+      for (int i = 0; i < PerfCounters::kNum; i++)
+        r.counters[i] = r.counters[i] < 0 || counters_before_[i] < 0
+                          ? -1 : r.counters[i] - counters_before_[i];
+    } else {
+      for (int i = 0; i < PerfCounters::kNum; i++)
+        r.counters[i] = -1;
+    }
+    records_.push_back(r);
+  }
+
+  // Attributes whatever reached metrics after the last step (trial-end
+  // merges) to that step, then writes the trial out
+  void EndTrial(const BfsMemMetrics &metrics) {
+    if (!enabled()) return;
+    if (!records_.empty() && records_.back().trial == trial_) {
+      BfsMemMetrics late = metrics;
+      late.AddScaled(before_, -1);
+      late.AddScaled(records_.back().mem, -1);
+      records_.back().mem.AddScaled(late, 1);
+    }
+    trial_++;
+    Flush();
+  }
+
+ private:
+  void Flush() {
+    if (records_.empty())
+      return;
+    if (!csv_) {
+      fwrite(records_.data(), sizeof(TraceRecord), records_.size(), file_);
+    } else {
+      for (const TraceRecord &r : records_) {
+        char kind[5] = {0};
+        memcpy(kind, r.kind, 4);
+        const BfsMemMetrics &m = r.mem;
+        fprintf(file_, "%d,%d,%s,%d,%" PRId64 ",%" PRId64 ",%.9f,%" PRId64
+                ",%" PRId64 ",%" PRId64 ",%" PRId64 ",%" PRId64 ",%" PRId64
+                ",%" PRId64 ",%" PRId64 ",%" PRId64 ",%" PRId64 ",%" PRId64
+                "\n", r.trial, r.step, kind, r.source, r.frontier, r.edges,
+                r.seconds, m.col_ind_reads, m.parent_reads, m.parent_writes,
+                m.frontier_pushes, m.bitmap_reads, m.bitmap_writes,
+                m.visited_byte_reads, m.visited_byte_writes, r.counters[0],
+                r.counters[1], r.counters[2]);
+      }
+    }
+    records_.clear();
+  }
+
+  FILE *file_;
+  bool csv_;
+  bool counters_on_;
+  PerfCounters perf_;
+  std::vector<TraceRecord> records_;
+  int32_t trial_ = 0;
+  int32_t step_ = 0;
+  NodeID source_ = -1;
+  BfsMemMetrics before_;
+  int64_t counters_before_[PerfCounters::kNum] = {-1, -1, -1};
+};
+
+#endif  // BFS_TRACE_H_
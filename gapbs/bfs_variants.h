@@ -0,0 +1,186 @@
+#ifndef BFS_VARIANTS_H_
+#define BFS_VARIANTS_H_
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "benchmark.h"
+#include "bfs_baseline.h"
+#include "bfs_kernel.h"
+#include "bfs_metrics.h"
+#include "bfs_numa.h"
+#include "bfs_spmspv.h"
+#include "pvector.h"
+
+/*
+Registry of BFS variants for the in-process A/B runner (bfs_ab.cc)
+
+A variant is a name, a one-line description and a function that runs one
+BFS from a given source and reports what it did. The built-in variants are
+the configurations we used to keep as separate copies of bfs.cc:
+
+  baseline      the bfs_treps.cc kernel itself (bfs_baseline.h)
+  plain         DOBFS with every option off: the baseline loops plus the
+                reused workspace and word-level frontier conversions
+  counters      bfs_ipc.cc: plain + memory-event counters
+  visited-byte  baseline + visited-byte fast path
+  prefetch      visited-byte + software prefetch
+  improved      bfs_improved.cc defaults: visited-byte + counters
+  adaptive      visited-byte + cost-model direction switching
+  parallel      OpenMP steps (serial unless built with -fopenmp)
+  balanced      parallel, with edge-balanced td steps (edge_balance.h)
+  spmspv        masked SpMSpV/SpMV levels, any-parent semiring
+                (bfs_spmspv.h)
+  spmspv-min    the same with the (min, select-first) semiring
+  numa          partitioned per NUMA node, batched cross-node updates
+                (bfs_numa.h; g_numa sets the partition count)
+
+Adding a variant is one RegisterBFSVariant() call in
+RegisterBuiltinBFSVariants(); anything that can produce a parent array can
+be registered, not only DOBFS configurations.
+*/
+
+struct BFSRun {
+  pvector<NodeID> parent;
+  int64_t traversed_edges = 0;
+  double seconds = 0;
+  bool has_metrics = false;       // metrics is meaningful
+  BfsMemMetrics metrics;
+};
+
+typedef std::function<BFSRun(const Graph&, NodeID, bool)> BFSVariantFunc;
+
+struct BFSVariant {
+  std::string name;
+  std::string description;
+  BFSVariantFunc run;
+};
+
+inline std::vector<BFSVariant>& BFSVariants() {
+  static std::vector<BFSVariant> variants;
+  return variants;
+}
+
+inline void RegisterBFSVariant(const std::string &name,
+                               const std::string &description,
+                               BFSVariantFunc run) {
+  BFSVariants().push_back(BFSVariant{name, description, run});
+}
+
+inline const BFSVariant* FindBFSVariant(const std::string &name) {
+  for (const BFSVariant &v : BFSVariants())
+    if (v.name == name) return &v;
+  return nullptr;
+}
+
+// Wraps one DOBFS configuration; metrics are the delta of this run only.
+// Each variant keeps its own BfsWorkspace, so the parent copy handed back
+// in BFSRun happens after the timed region.
+template <MetricsLevel kLevel>
+BFSVariantFunc DOBFSVariant(BFSOptions opts) {
+  std::shared_ptr<BfsWorkspace> ws = std::make_shared<BfsWorkspace>();
+  return [opts, ws] (const Graph &g, NodeID source, bool logging_enabled) {
+    BfsMemMetrics before = g_metrics;
+    BFSRun run;
+    const pvector<NodeID> &parent =
+        DOBFS<kLevel>(g, source, logging_enabled, opts, *ws);
+    run.parent = pvector<NodeID>(parent.begin(), parent.end());
+    run.traversed_edges = g_traversed_edges;
+    run.seconds = g_bfs_time_sec;
+    run.has_metrics = kLevel != kMetricsNone;
+    run.metrics = g_metrics;
+    run.metrics.AddScaled(before, -1);
+    return run;
+  };
+}
+
+// The bfs_treps.cc kernel; allocates its own state every trial, as it
+// always has
+inline BFSVariantFunc BaselineVariant() {
+  return [] (const Graph &g, NodeID source, bool logging_enabled) {
+    BFSRun run;
+    run.parent = BaselineDOBFS(g, source, logging_enabled,
+                               run.traversed_edges, run.seconds);
+    return run;
+  };
+}
+
+// Wraps SpMSpVBFS with one semiring, in the same form as DOBFSVariant
+template <typename Semiring>
+BFSVariantFunc SpMSpVVariant(BFSOptions opts) {
+  std::shared_ptr<SpMSpVWorkspace> ws = std::make_shared<SpMSpVWorkspace>();
+  return [opts, ws] (const Graph &g, NodeID source, bool logging_enabled) {
+    BFSRun run;
+    const pvector<NodeID> &parent =
+        SpMSpVBFS<Semiring>(g, source, logging_enabled, opts, *ws);
+    run.parent = pvector<NodeID>(parent.begin(), parent.end());
+    run.traversed_edges = g_traversed_edges;
+    run.seconds = g_bfs_time_sec;
+    return run;
+  };
+}
+
+// Partitions on first use; g_numa is read then, so drivers set it first
+inline BFSVariantFunc NumaVariant(BFSOptions opts) {
+  std::shared_ptr<NumaGraph> ng = std::make_shared<NumaGraph>();
+  return [opts, ng] (const Graph &g, NodeID source, bool logging_enabled) {
+    ng->Prepare(g, g_numa);
+    BFSRun run;
+    const pvector<NodeID> &parent =
+        ng->BFS(source, logging_enabled, opts, g_numa.bind);
+    run.parent = pvector<NodeID>(parent.begin(), parent.end());
+    run.traversed_edges = g_traversed_edges;
+    run.seconds = g_bfs_time_sec;
+    return run;
+  };
+}
+
+inline void RegisterBuiltinBFSVariants() {
+  if (!BFSVariants().empty()) return;
+  BFSOptions base;
+  base.visited = false;
+
+  BFSOptions visited = base;
+  visited.visited = true;
+
+  BFSOptions prefetch = visited;
+  prefetch.prefetch = true;
+
+  BFSOptions adaptive = visited;
+  adaptive.adaptive = true;
+
+  BFSOptions parallel = base;
+  parallel.parallel = true;
+
+  BFSOptions balanced = parallel;
+  balanced.balanced = true;
+
+  RegisterBFSVariant("baseline", "bfs_treps.cc kernel (bfs_baseline.h)",
+                     BaselineVariant());
+  RegisterBFSVariant("plain", "DOBFS, every option off",
+                     DOBFSVariant<kMetricsNone>(base));
+  RegisterBFSVariant("counters", "plain + memory-event counters",
+                     DOBFSVariant<kMetricsCounts>(base));
+  RegisterBFSVariant("visited-byte", "visited-byte fast path in td",
+                     DOBFSVariant<kMetricsNone>(visited));
+  RegisterBFSVariant("prefetch", "visited-byte + software prefetch",
+                     DOBFSVariant<kMetricsNone>(prefetch));
+  RegisterBFSVariant("improved", "bfs_improved.cc defaults (counted)",
+                     DOBFSVariant<kMetricsCounts>(visited));
+  RegisterBFSVariant("adaptive", "visited-byte + cost-model switching",
+                     DOBFSVariant<kMetricsNone>(adaptive));
+  RegisterBFSVariant("parallel", "OpenMP td/bu steps",
+                     DOBFSVariant<kMetricsNone>(parallel));
+  RegisterBFSVariant("balanced", "OpenMP steps, edge-balanced td",
+                     DOBFSVariant<kMetricsNone>(balanced));
+  RegisterBFSVariant("spmspv", "masked SpMSpV, any-parent semiring",
+                     SpMSpVVariant<AnySemiring>(base));
+  RegisterBFSVariant("spmspv-min", "masked SpMSpV, (min, first) semiring",
+                     SpMSpVVariant<MinSemiring>(base));
+  RegisterBFSVariant("numa", "NUMA-partitioned, batched remote updates",
+                     NumaVariant(base));
+}
+
+#endif  // BFS_VARIANTS_H_
@@ -0,0 +1,334 @@
+#ifndef BFS_VERIFY_H_
+#define BFS_VERIFY_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cinttypes>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "benchmark.h"
+#include "graph.h"
+#include "platform_atomics.h"
+#include "pvector.h"
+#include "sliding_queue.h"
+
+/*
+BFS tree verification: serial, parallel and sampled
+
+  serial    the original BFSVerifier: serial reference BFS, then every
+            vertex's parent edge and depth checked in one pass
+  parallel  the same checks; the reference depths come from a parallel
+            level-synchronous BFS (CAS on depth, QueueBuffer per thread)
+            and the per-vertex pass is an OpenMP loop that stops claiming
+            work once any thread has found an error
+  sampled   no reference BFS. K random vertices (plus the source) are
+            checked against the Graph500 tree rules, using levels read off
+            the parent chains:
+              - the chain from u reaches the source within n steps
+              - (parent[u], u) is an edge and level(u) = level(parent) + 1
+              - every in-neighbor v of u has level(u) <= level(v) + 1,
+                and u is reached if v is
+            Together over all vertices these rules imply a correct BFS
+            tree, so if a fraction f of vertices break one, K clean samples
+            happen with probability at most (1 - f)^K. The report gives the
+            f that bound rules out at the requested confidence.
+
+A sampled check costs about K * (in-degree + 1) * depth and touches no
+per-vertex arrays, so it suits soak runs on graphs where a full
+verification would take longer than the kernel.
+*/
+
+enum VerifyMode {
+  kVerifySerial,
+  kVerifyParallel,
+  kVerifySampled
+};
+
+struct VerifyOptions {
+  VerifyMode mode = kVerifyParallel;
+  int64_t samples = 10000;
+  double confidence = 0.99;
+};
+
+// Verifier settings for drivers that call BFSVerifier, one copy shared by
+// every translation unit
+inline VerifyOptions& BfsVerifyOptions() { static VerifyOptions v; return v; }
+static VerifyOptions &g_verify = BfsVerifyOptions();
+
+inline bool ParseVerifyMode(const std::string &name, VerifyMode &mode) {
+  if (name == "serial") mode = kVerifySerial;
+  else if (name == "parallel") mode = kVerifyParallel;
+  else if (name == "sampled") mode = kVerifySampled;
+  else return false;
+  return true;
+}
+
+// --verify=serial|parallel|sampled, --verify-samples=K,
+// --verify-confidence=C; returns false if a is not a verify flag
+inline bool ParseVerifyArg(const std::string &a, VerifyOptions &opts) {
+  if (a.compare(0, 9, "--verify=") == 0) {
+    if (!ParseVerifyMode(a.substr(9), opts.mode))
+      std::cout << "Unknown verify mode " << a.substr(9) << std::endl;
+  } else if (a.compare(0, 17, "--verify-samples=") == 0) {
+    opts.samples = atol(a.c_str() + 17);
+  } else if (a.compare(0, 20, "--verify-confidence=") == 0) {
+    opts.confidence = atof(a.c_str() + 20);
+  } else {
+    return false;
+  }
+  return true;
+}
+
+inline bool SerialBFSVerifier(const Graph &g, NodeID source,
+                              const pvector<NodeID> &parent) {
+  using std::cout;
+  using std::endl;
+  pvector<int> depth(g.num_nodes(), -1);
+  depth[source] = 0;
+  std::vector<NodeID> to_visit;
+  to_visit.reserve(g.num_nodes());
+  to_visit.push_back(source);
+  for (auto it = to_visit.begin(); it != to_visit.end(); it++) {
+    NodeID u = *it;
+    for (NodeID v : g.out_neigh(u)) {
+      if (depth[v] == -1) {
+        depth[v] = depth[u] + 1;
+        to_visit.push_back(v);
+      }
+    }
+  }
+  for (NodeID u : g.vertices()) {
+    if ((depth[u] != -1) && (parent[u] != -1)) {
+      if (u == source) {
+        if (!((parent[u] == u) && (depth[u] == 0))) {
+          cout << "Source wrong" << endl;
+          return false;
+        }
+        continue;
+      }
+      bool parent_found = false;
+      for (NodeID v : g.in_neigh(u)) {
+        if (v == parent[u]) {
+          if (depth[v] != depth[u] - 1) {
+            cout << "Wrong depths for " << u << " & " << v << endl;
+            return false;
+          }
+          parent_found = true;
+          break;
+        }
+      }
+      if (!parent_found) {
+        cout << "Couldn't find edge from " << parent[u] << " to " << u << endl;
+        return false;
+      }
+    } else if (depth[u] != parent[u]) {
+      cout << "Reachability mismatch" << endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+// Level-synchronous reference depths, -1 for unreached
+inline pvector<int> ParallelDepths(const Graph &g, NodeID source) {
+  pvector<int> depth(g.num_nodes());
+  #pragma omp parallel for
+  for (NodeID n = 0; n < g.num_nodes(); n++)
+    depth[n] = -1;
+  depth[source] = 0;
+  SlidingQueue<NodeID> queue(g.num_nodes());
+  queue.push_back(source);
+  queue.slide_window();
+  for (int level = 1; !queue.empty(); level++) {
+    #pragma omp parallel
+    {
+      QueueBuffer<NodeID> lqueue(queue);
+      #pragma omp for schedule(dynamic, 64) nowait
+      for (auto q_iter = queue.begin(); q_iter < queue.end(); q_iter++) {
+        for (NodeID v : g.out_neigh(*q_iter)) {
+          if (depth[v] == -1 && compare_and_swap(depth[v], -1, level))
+            lqueue.push_back(v);
+        }
+      }
+      lqueue.flush();
+    }
+    queue.slide_window();
+  }
+  return depth;
+}
+
+// First error reported by any thread; later ones are dropped
+class VerifyFailure {
+ public:
+  VerifyFailure() : failed_(false) {}
+
+  bool failed() const { return failed_.load(std::memory_order_relaxed); }
+
+  void Fail(const std::string &msg) {
+    #pragma omp critical(verify_failure)
+    {
+      if (!failed_.load(std::memory_order_relaxed)) {
+        msg_ = msg;
+        failed_.store(true, std::memory_order_relaxed);
+      }
+    }
+  }
+
+  const std::string& message() const { return msg_; }
+
+ private:
+  std::atomic<bool> failed_;
+  std::string msg_;
+};
+
+inline bool ParallelBFSVerifier(const Graph &g, NodeID source,
+                                const pvector<NodeID> &parent) {
+  pvector<int> depth = ParallelDepths(g, source);
+  VerifyFailure failure;
+  #pragma omp parallel for schedule(dynamic, 1024)
+  for (NodeID u = 0; u < g.num_nodes(); u++) {
+    if (failure.failed())
+      continue;
+    if ((depth[u] != -1) && (parent[u] != -1)) {
+      if (u == source) {
+        if (!((parent[u] == u) && (depth[u] == 0)))
+          failure.Fail("Source wrong");
+        continue;
+      }
+      bool parent_found = false;
+      for (NodeID v : g.in_neigh(u)) {
+        if (v == parent[u]) {
+          if (depth[v] != depth[u] - 1) {
+            std::ostringstream msg;
+            msg << "Wrong depths for " << u << " & " << v;
+            failure.Fail(msg.str());
+          }
+          parent_found = true;
+          break;
+        }
+      }
+      if (!parent_found) {
+        std::ostringstream msg;
+        msg << "Couldn't find edge from " << parent[u] << " to " << u;
+        failure.Fail(msg.str());
+      }
+    } else if (depth[u] != parent[u]) {
+      failure.Fail("Reachability mismatch");
+    }
+  }
+  if (failure.failed())
+    std::cout << failure.message() << std::endl;
+  return !failure.failed();
+}
+
+// Tree level of u from its parent chain: -1 unreached, -2 broken chain
+// (cycle, out-of-range parent, or a chain that misses the source)
+inline int64_t ChainLevel(const pvector<NodeID> &parent, NodeID source,
+                          NodeID u) {
+  const int64_t n = parent.size();
+  if (parent[u] == -1)
+    return -1;
+  int64_t level = 0;
+  for (NodeID x = u; x != source; x = parent[x]) {
+    if (parent[x] < 0 || parent[x] >= n || parent[x] == x || ++level > n)
+      return -2;
+  }
+  return level;
+}
+
+// Smallest violating fraction that K clean samples rule out at confidence c
+inline double SampledBound(int64_t samples, double confidence) {
+  if (samples <= 0)
+    return 1;
+  return 1 - std::pow(1 - confidence, 1.0 / samples);
+}
+
+inline bool SampledBFSVerifier(const Graph &g, NodeID source,
+                               const pvector<NodeID> &parent,
+                               const VerifyOptions &opts) {
+  const int64_t n = g.num_nodes();
+  const int64_t k = std::min<int64_t>(opts.samples, n);
+  std::vector<NodeID> picks(k);
+  std::mt19937_64 rng(27491095 + source);
+  std::uniform_int_distribution<NodeID> any_node(0, n - 1);
+  for (int64_t i = 0; i < k; i++)
+    picks[i] = any_node(rng);
+  if (k > 0) picks[0] = source;
+
+  if (parent[source] != source) {
+    std::cout << "Source wrong" << std::endl;
+    return false;
+  }
+  VerifyFailure failure;
+  #pragma omp parallel for schedule(dynamic, 16)
+  for (int64_t i = 0; i < k; i++) {
+    if (failure.failed())
+      continue;
+    NodeID u = picks[i];
+    std::ostringstream msg;
+    int64_t level = ChainLevel(parent, source, u);
+    if (level == -2) {
+      msg << "Parent chain from " << u << " does not reach the source";
+      failure.Fail(msg.str());
+      continue;
+    }
+    if (level > 0) {
+      bool parent_found = false;
+      for (NodeID v : g.in_neigh(u)) {
+        if (v == parent[u]) {
+          parent_found = true;
+          break;
+        }
+      }
+      if (!parent_found) {
+        msg << "Couldn't find edge from " << parent[u] << " to " << u;
+        failure.Fail(msg.str());
+        continue;
+      }
+    }
+    for (NodeID v : g.in_neigh(u)) {
+      int64_t v_level = ChainLevel(parent, source, v);
+      if (v_level == -2) {
+        msg << "Parent chain from " << v << " does not reach the source";
+        failure.Fail(msg.str());
+        break;
+      }
+      if (v_level >= 0 && (level < 0 || level > v_level + 1)) {
+        if (level < 0)
+          msg << "Reachability mismatch: " << u << " unreached, in-neighbor "
+              << v << " reached";
+        else
+          msg << "Wrong depths for " << u << " & " << v;
+        failure.Fail(msg.str());
+        break;
+      }
+    }
+  }
+  if (failure.failed()) {
+    std::cout << failure.message() << std::endl;
+    return false;
+  }
+  std::cout << "Sampled " << k << " vertices: at " << opts.confidence * 100
+            << "% confidence under " << SampledBound(k, opts.confidence) * 100
+            << "% violate the BFS tree rules" << std::endl;
+  return true;
+}
+
+inline bool VerifyBFSTree(const Graph &g, NodeID source,
+                          const pvector<NodeID> &parent,
+                          const VerifyOptions &opts) {
+  switch (opts.mode) {
+    case kVerifySerial:   return SerialBFSVerifier(g, source, parent);
+    case kVerifyParallel: return ParallelBFSVerifier(g, source, parent);
+    case kVerifySampled:
+      return SampledBFSVerifier(g, source, parent, opts);
+  }
+  return false;
+}
+
+#endif  // BFS_VERIFY_H_
@@ -0,0 +1,344 @@
+#ifndef CACHE_SIM_H_
+#define CACHE_SIM_H_
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/*
+Trace-driven cache hierarchy model
+
+The BFS byte model (BfsMemMetrics::BytesEstimate) charges every access the
+size of its element, so a neighbor index costs 4 bytes whether or not its
+line was just fetched. CacheHierarchy replays the addresses of the same
+accesses instead and counts what a cache would have to fetch:
+
+  levels    any number (normally L1/L2/L3), each with its own size and
+            associativity; 64-byte lines, true LRU within a set
+  fills     a demand miss looks up the next level and installs the line in
+            every level it missed (non-inclusive, no back-invalidation)
+  writes    write-allocate, write-back: dirty lines are written to the next
+            level on eviction, and from the last level to DRAM
+  prefetch  optional next-line prefetch: an L1 demand miss on line X also
+            brings X+1 into every level that lacks it. Prefetched lines
+            that are later hit by demand accesses count as useful
+
+Per level it reports demand accesses, misses, fill bytes (lines brought in
+from below, prefetches included) and write-back bytes, and DRAM read and
+write bytes for the whole hierarchy. Those compare directly with perf's
+l1d/l2/LLC miss and memory traffic counters.
+
+Configurations are "host" (sizes and ways from sysfs, cpu0) or an explicit
+list "48K/12,2M/16,32M/16" of size/ways per level. One hierarchy models one
+core. Multi-threaded callers keep one per thread and add the stats up, so a
+shared last-level cache is modeled as private to each thread.
+*/
+
+struct CacheLevelConfig {
+  int64_t size_bytes;
+  int ways;
+};
+
+struct CacheSimConfig {
+  static const int kLineBytes = 64;
+
+  std::vector<CacheLevelConfig> levels;
+  bool prefetch = true;
+
+  // Falls back to 32K/8, 1M/16, 32M/16 if sysfs has no cache info
+  static CacheSimConfig Host() {
+    CacheSimConfig config;
+    for (int index = 0; index < 8; index++) {
+      std::string dir = "/sys/devices/system/cpu/cpu0/cache/index" +
+                        std::to_string(index) + "/";
+      std::ifstream level_in(dir + "level"), type_in(dir + "type"),
+                    size_in(dir + "size"), ways_in(dir + "ways_of_associativity");
+      int level, ways;
+      std::string type, size;
+      if (!(level_in >> level >> std::ws) || !(type_in >> type) ||
+          !(size_in >> size) || !(ways_in >> ways))
+        continue;
+      if (type == "Instruction" || level < 1)
+        continue;
+      if (static_cast<int>(config.levels.size()) < level)
+        config.levels.resize(level, CacheLevelConfig{0, 0});
+      config.levels[level - 1] = CacheLevelConfig{ParseSize(size), ways};
+    }
+    bool complete = !config.levels.empty();
+    for (const CacheLevelConfig &l : config.levels)
+      complete &= l.size_bytes > 0 && l.ways > 0;
+    if (!complete)
+      Parse("32K/8,1M/16,32M/16", config);
+    return config;
+  }
+
+  // "host" or "SIZE/WAYS,..." with K/M/G suffixes; false if malformed
+  static bool Parse(const std::string &spec, CacheSimConfig &config) {
+    if (spec == "host" || spec.empty()) {
+      bool prefetch = config.prefetch;
+      config = Host();
+      config.prefetch = prefetch;
+      return true;
+    }
+    std::vector<CacheLevelConfig> levels;
+    std::stringstream ss(spec);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+      size_t slash = item.find('/');
+      if (slash == std::string::npos)
+        return false;
+      CacheLevelConfig l{ParseSize(item.substr(0, slash)),
+                         atoi(item.c_str() + slash + 1)};
+      if (l.size_bytes < kLineBytes || l.ways <= 0 ||
+          l.size_bytes / kLineBytes < l.ways)
+        return false;
+      levels.push_back(l);
+    }
+    if (levels.empty())
+      return false;
+    config.levels = levels;
+    return true;
+  }
+
+  static int64_t ParseSize(const std::string &s) {
+    char *end;
+    int64_t n = strtoll(s.c_str(), &end, 10);
+    switch (*end) {
+      case 'K': case 'k': return n << 10;
+      case 'M': case 'm': return n << 20;
+      case 'G': case 'g': return n << 30;
+    }
+    return n;
+  }
+
+  std::string Describe() const {
+    std::ostringstream out;
+    for (size_t i = 0; i < levels.size(); i++) {
+      int64_t kb = levels[i].size_bytes >> 10;
+      out << (i == 0 ? "" : ", ") << "L" << i + 1 << " ";
+      if (kb >= 1024 && kb % 1024 == 0)
+        out << kb / 1024 << "M";
+      else
+        out << kb << "K";
+      out << "/" << levels[i].ways;
+    }
+    out << ", " << kLineBytes << "B lines, LRU"
+        << (prefetch ? ", next-line prefetch" : "");
+    return out.str();
+  }
+};
+
+struct CacheLevelStats {
+  int64_t accesses = 0;          // demand lookups reaching this level
+  int64_t misses = 0;
+  int64_t fills = 0;             // lines fetched from below (incl. prefetch)
+  int64_t writebacks = 0;        // dirty lines evicted to the next level
+  int64_t prefetches = 0;        // lines installed by the prefetcher
+  int64_t useful_prefetches = 0; // of those, later hit by demand
+
+  void Add(const CacheLevelStats &o) {
+    accesses += o.accesses;
+    misses += o.misses;
+    fills += o.fills;
+    writebacks += o.writebacks;
+    prefetches += o.prefetches;
+    useful_prefetches += o.useful_prefetches;
+  }
+};
+
+struct CacheSimStats {
+  std::vector<CacheLevelStats> levels;
+  int64_t dram_reads = 0;        // lines
+  int64_t dram_writes = 0;
+
+  void Add(const CacheSimStats &o) {
+    if (levels.size() < o.levels.size())
+      levels.resize(o.levels.size());
+    for (size_t i = 0; i < o.levels.size(); i++)
+      levels[i].Add(o.levels[i]);
+    dram_reads += o.dram_reads;
+    dram_writes += o.dram_writes;
+  }
+
+  double dram_bytes() const {
+    return double(dram_reads + dram_writes) * CacheSimConfig::kLineBytes;
+  }
+
+  void Print(std::ostream &out) const {
+    const int line = CacheSimConfig::kLineBytes;
+    const std::ios::fmtflags flags = out.flags();
+    const std::streamsize precision = out.precision();
+    out << std::left << std::setw(7) << "  level" << std::right
+        << std::setw(14) << "accesses" << std::setw(14) << "misses"
+        << std::setw(9) << "miss%" << std::setw(16) << "fill bytes"
+        << std::setw(16) << "wb bytes" << std::setw(10) << "pf use%"
+        << std::endl;
+    for (size_t i = 0; i < levels.size(); i++) {
+      const CacheLevelStats &s = levels[i];
+      out << "  L" << std::left << std::setw(4) << i + 1 << std::right
+          << std::setw(14) << s.accesses << std::setw(14) << s.misses
+          << std::fixed << std::setprecision(2) << std::setw(9)
+          << (s.accesses > 0 ? 100.0 * s.misses / s.accesses : 0.0)
+          << std::setw(16) << s.fills * line
+          << std::setw(16) << s.writebacks * line << std::setw(10)
+          << (s.prefetches > 0 ? 100.0 * s.useful_prefetches / s.prefetches
+                               : 0.0)
+          << std::endl;
+    }
+    out << "  DRAM  read bytes " << dram_reads * line << "  write bytes "
+        << dram_writes * line << std::endl;
+    out.flags(flags);
+    out.precision(precision);
+  }
+};
+
+class CacheHierarchy {
+ public:
+  explicit CacheHierarchy(const CacheSimConfig &config)
+      : prefetch_(config.prefetch), clock_(0) {
+    for (const CacheLevelConfig &c : config.levels)
+      levels_.push_back(Level(c));
+    stats_.levels.resize(levels_.size());
+  }
+
+  // Every line of [p, p + bytes) is one demand access
+  void Access(const void *p, size_t bytes, bool write) {
+    uint64_t addr = reinterpret_cast<uintptr_t>(p);
+    uint64_t first = addr / CacheSimConfig::kLineBytes;
+    uint64_t last = (addr + (bytes > 0 ? bytes - 1 : 0)) /
+                    CacheSimConfig::kLineBytes;
+    for (uint64_t line = first; line <= last; line++)
+      AccessLine(line, write);
+  }
+
+  const CacheSimStats& stats() const { return stats_; }
+
+ private:
+  static const uint8_t kDirty = 1;
+  static const uint8_t kPrefetched = 2;
+
+  struct Level {
+    explicit Level(const CacheLevelConfig &c)
+        : ways(c.ways),
+          sets(std::max<int64_t>(1, c.size_bytes /
+                                    CacheSimConfig::kLineBytes / c.ways)),
+          tags(sets * ways, 0), stamps(sets * ways, 0),
+          flags(sets * ways, 0) {}
+
+    // Slot of line in its set, or -1
+    int64_t Find(uint64_t line) const {
+      int64_t base = (line % sets) * ways;
+      for (int w = 0; w < ways; w++) {
+        if (tags[base + w] == line + 1)
+          return base + w;
+      }
+      return -1;
+    }
+
+    // LRU (or empty) slot of line's set
+    int64_t Victim(uint64_t line) const {
+      int64_t base = (line % sets) * ways;
+      int64_t victim = base;
+      for (int w = 0; w < ways; w++) {
+        if (tags[base + w] == 0)
+          return base + w;
+        if (stamps[base + w] < stamps[victim])
+          victim = base + w;
+      }
+      return victim;
+    }
+
+    int ways;
+    int64_t sets;
+    std::vector<uint64_t> tags;    // line + 1, 0 for empty
+    std::vector<uint64_t> stamps;
+    std::vector<uint8_t> flags;
+  };
+
+  void AccessLine(uint64_t line, bool write) {
+    size_t hit = levels_.size();
+    for (size_t l = 0; l < levels_.size(); l++) {
+      stats_.levels[l].accesses++;
+      int64_t slot = levels_[l].Find(line);
+      if (slot >= 0) {
+        levels_[l].stamps[slot] = ++clock_;
+        if (levels_[l].flags[slot] & kPrefetched) {
+          stats_.levels[l].useful_prefetches++;
+          levels_[l].flags[slot] &= ~kPrefetched;
+        }
+        if (write && l == 0)
+          levels_[l].flags[slot] |= kDirty;
+        hit = l;
+        break;
+      }
+      stats_.levels[l].misses++;
+    }
+    if (hit == levels_.size())
+      stats_.dram_reads++;
+    for (size_t l = hit; l-- > 0; )
+      Install(l, line, write && l == 0 ? kDirty : 0);
+    if (prefetch_ && hit > 0)
+      Prefetch(line + 1);
+  }
+
+  void Prefetch(uint64_t line) {
+    size_t found = levels_.size();
+    for (size_t l = 0; l < levels_.size(); l++) {
+      if (levels_[l].Find(line) >= 0) {
+        found = l;
+        break;
+      }
+    }
+    if (found == 0)
+      return;
+    if (found == levels_.size())
+      stats_.dram_reads++;
+    for (size_t l = found; l-- > 0; ) {
+      stats_.levels[l].prefetches++;
+      Install(l, line, kPrefetched);
+    }
+  }
+
+  // from_below: a fill (demand or prefetch) rather than a write-back
+  void Install(size_t l, uint64_t line, uint8_t flags,
+               bool from_below = true) {
+    Level &level = levels_[l];
+    int64_t slot = level.Victim(line);
+    if (level.tags[slot] != 0 && (level.flags[slot] & kDirty))
+      WriteBack(l, level.tags[slot] - 1);
+    level.tags[slot] = line + 1;
+    level.stamps[slot] = ++clock_;
+    level.flags[slot] = flags;
+    if (from_below)
+      stats_.levels[l].fills++;
+  }
+
+  // Dirty line evicted from level l goes to l + 1 (or DRAM)
+  void WriteBack(size_t l, uint64_t line) {
+    stats_.levels[l].writebacks++;
+    if (l + 1 == levels_.size()) {
+      stats_.dram_writes++;
+      return;
+    }
+    Level &below = levels_[l + 1];
+    int64_t slot = below.Find(line);
+    if (slot >= 0) {
+      below.flags[slot] |= kDirty;
+      return;
+    }
+    Install(l + 1, line, kDirty, false);
+  }
+
+  std::vector<Level> levels_;
+  bool prefetch_;
+  uint64_t clock_;
+  CacheSimStats stats_;
+};
+
+#endif  // CACHE_SIM_H_
@@ -0,0 +1,370 @@
+#include <iostream>
+#include <vector>
+#include <iomanip>
+#include <algorithm>
+#include <cinttypes>
+#include <random>
+#include <string>
+#include <unordered_map>
+
+#include "benchmark.h"
+#include "builder.h"
+#include "command_line.h"
+#include "graph.h"
+#include "graph_snapshot.h"
+#include "platform_atomics.h"
+#include "pvector.h"
+#include "timer.h"
+
+/*
+Weakly connected components on the BFS harness
+
+Two kernels over the same Graph/Builder/BenchmarkKernel setup as the BFS
+drivers, both producing comp[v] = a representative vertex of v's component:
+
+  afforest  Sutton et al.'s subgraph sampling: link along the first
+            --neighbor-rounds edges of every vertex, compress, sample the
+            most frequent label (almost always the giant component), then
+            link the remaining edges of every vertex outside it. Most of
+            the graph's edges are never looked at.
+  sv        Shiloach-Vishkin: hook the larger label under the smaller along
+            every edge, compress with pointer jumping, repeat until a pass
+            changes nothing. Every edge is visited every round.
+
+Both count the edges they examine and the comp[] reads and writes, and
+report edges/s and a byte estimate (4 bytes per neighbor index and per
+comp[] access) in the style of bfs_improved. The verifier labels
+components with a serial BFS over out- and in-edges and checks that two
+vertices share a label exactly when they share a component.
+
+Extra flags (stripped before CLApp sees them):
+  --algo=afforest|sv       kernel (default afforest)
+  --neighbor-rounds=K      afforest sampling rounds (default 2)
+  --snapshot=F, --snapshot-prefault=none|populate|background
+*/
+
+using namespace std;
+
+static string g_algo = "afforest";
+static int g_neighbor_rounds = 2;
+
+// Graph snapshot (graph_snapshot.h): mmap if present, else build and save
+static string g_snapshot = "";
+static SnapshotPrefault g_prefault = kPrefaultNone;
+
+static void StripCustomArgs(int& argc, char** argv) {
+  int out = 1;
+  for (int i = 1; i < argc; ++i) {
+    string a = argv[i];
+    if (a.compare(0, 7, "--algo=") == 0) g_algo = a.substr(7);
+    else if (a.compare(0, 18, "--neighbor-rounds=") == 0)
+      g_neighbor_rounds = atoi(a.c_str() + 18);
+    else if (a.compare(0, 11, "--snapshot=") == 0) g_snapshot = a.substr(11);
+    else if (a.compare(0, 20, "--snapshot-prefault=") == 0) {
+      if (!ParseSnapshotPrefault(a.substr(20), g_prefault))
+        cout << "Unknown prefault mode " << a.substr(20) << endl;
+    }
+    else argv[out++] = argv[i];
+  }
+  argc = out;
+}
+
+// Totals for the report, summed over trials
+struct CCStats {
+  int64_t edges = 0;          // neighbor indices read
+  int64_t comp_reads = 0;
+  int64_t comp_writes = 0;
+  int64_t rounds = 0;         // sv passes or afforest link phases
+  double seconds = 0;
+
+  double BytesEstimate() const {
+    return 4.0 * (edges + comp_reads + comp_writes);
+  }
+};
+
+static CCStats g_cc;
+
+// Hooks the trees of u and v together, larger root under smaller
+static void Link(NodeID u, NodeID v, pvector<NodeID> &comp,
+                 int64_t &reads, int64_t &writes) {
+  NodeID p1 = comp[u];
+  NodeID p2 = comp[v];
+  reads += 2;
+  while (p1 != p2) {
+    NodeID high = p1 > p2 ? p1 : p2;
+    NodeID low = p1 + (p2 - high);
+    NodeID p_high = comp[high];
+    reads++;
+    if ((p_high == low) ||
+        (p_high == high && compare_and_swap(comp[high], high, low))) {
+      writes++;
+      break;
+    }
+    p1 = comp[comp[high]];
+    p2 = comp[low];
+    reads += 3;
+  }
+}
+
+// Pointer jumping until every vertex points at its root
+static void Compress(const Graph &g, pvector<NodeID> &comp, int64_t &reads,
+                     int64_t &writes) {
+  int64_t r = 0, w = 0;
+  #pragma omp parallel for schedule(dynamic, 16384) reduction(+ : r, w)
+  for (NodeID n = 0; n < g.num_nodes(); n++) {
+    while (comp[n] != comp[comp[n]]) {
+      comp[n] = comp[comp[n]];
+      r += 3;
+      w++;
+    }
+    r += 2;
+  }
+  reads += r;
+  writes += w;
+}
+
+// Most frequent label among num_samples random vertices
+static NodeID SampleFrequentElement(const pvector<NodeID> &comp,
+                                    int64_t num_samples = 1024) {
+  unordered_map<NodeID, int> sample_counts(32);
+  mt19937 gen;
+  uniform_int_distribution<NodeID> distribution(0, comp.size() - 1);
+  for (int64_t i = 0; i < num_samples; i++)
+    sample_counts[comp[distribution(gen)]]++;
+  auto most_frequent = max_element(
+      sample_counts.begin(), sample_counts.end(),
+      [](const pair<NodeID, int> &a, const pair<NodeID, int> &b) {
+        return a.second < b.second;
+      });
+  return most_frequent->first;
+}
+
+pvector<NodeID> Afforest(const Graph &g, bool logging_enabled,
+                         int neighbor_rounds) {
+  Timer t;
+  pvector<NodeID> comp(g.num_nodes());
+  int64_t edges = 0, reads = 0, writes = 0;
+
+  Timer t_total;
+  t_total.Start();
+  #pragma omp parallel for
+  for (NodeID n = 0; n < g.num_nodes(); n++)
+    comp[n] = n;
+  writes += g.num_nodes();
+
+  // Sampling phase: the first neighbor_rounds edges of every vertex
+  for (int r = 0; r < neighbor_rounds; ++r) {
+    t.Start();
+    #pragma omp parallel for schedule(dynamic, 16384) \
+        reduction(+ : edges, reads, writes)
+    for (NodeID u = 0; u < g.num_nodes(); u++) {
+      for (NodeID v : g.out_neigh(u, r)) {
+        edges++;
+        Link(u, v, comp, reads, writes);
+        break;
+      }
+    }
+    Compress(g, comp, reads, writes);
+    t.Stop();
+    if (logging_enabled) PrintStep("s", t.Seconds());
+  }
+
+  // The largest intermediate component is very likely the final giant one;
+  // its vertices need no further edges
+  NodeID c = SampleFrequentElement(comp);
+  t.Start();
+  if (!g.directed()) {
+    #pragma omp parallel for schedule(dynamic, 16384) \
+        reduction(+ : edges, reads, writes)
+    for (NodeID u = 0; u < g.num_nodes(); u++) {
+      reads++;
+      if (comp[u] == c)
+        continue;
+      for (NodeID v : g.out_neigh(u, neighbor_rounds)) {
+        edges++;
+        Link(u, v, comp, reads, writes);
+      }
+    }
+  } else {
+    // Out-edges only reach forward, so in-edges are linked too; the
+    // sampled prefix of out-edges is already linked
+    #pragma omp parallel for schedule(dynamic, 16384) \
+        reduction(+ : edges, reads, writes)
+    for (NodeID u = 0; u < g.num_nodes(); u++) {
+      reads++;
+      if (comp[u] == c)
+        continue;
+      for (NodeID v : g.out_neigh(u, neighbor_rounds)) {
+        edges++;
+        Link(u, v, comp, reads, writes);
+      }
+      for (NodeID v : g.in_neigh(u)) {
+        edges++;
+        Link(u, v, comp, reads, writes);
+      }
+    }
+  }
+  Compress(g, comp, reads, writes);
+  t.Stop();
+  t_total.Stop();
+  if (logging_enabled) PrintStep("f", t.Seconds());
+
+  g_cc.edges += edges;
+  g_cc.comp_reads += reads;
+  g_cc.comp_writes += writes;
+  g_cc.rounds += neighbor_rounds + 1;
+  g_cc.seconds += t_total.Seconds();
+  return comp;
+}
+
+pvector<NodeID> ShiloachVishkin(const Graph &g, bool logging_enabled) {
+  Timer t;
+  pvector<NodeID> comp(g.num_nodes());
+  int64_t edges = 0, reads = 0, writes = 0;
+
+  Timer t_total;
+  t_total.Start();
+  #pragma omp parallel for
+  for (NodeID n = 0; n < g.num_nodes(); n++)
+    comp[n] = n;
+  writes += g.num_nodes();
+
+  bool change = true;
+  int rounds = 0;
+  while (change) {
+    t.Start();
+    change = false;
+    rounds++;
+    #pragma omp parallel for schedule(dynamic, 16384) \
+        reduction(+ : edges, reads, writes)
+    for (NodeID u = 0; u < g.num_nodes(); u++) {
+      for (NodeID v : g.out_neigh(u)) {
+        NodeID comp_u = comp[u];
+        NodeID comp_v = comp[v];
+        edges++;
+        reads += 2;
+        if (comp_u == comp_v) continue;
+        // Hooking condition so lower component ID wins independent of
+        // direction
+        NodeID high_comp = comp_u > comp_v ? comp_u : comp_v;
+        NodeID low_comp = comp_u + (comp_v - high_comp);
+        reads++;
+        if (high_comp == comp[high_comp]) {
+          change = true;
+          comp[high_comp] = low_comp;
+          writes++;
+        }
+      }
+    }
+    Compress(g, comp, reads, writes);
+    t.Stop();
+    if (logging_enabled) PrintStep("sv", t.Seconds());
+  }
+  t_total.Stop();
+
+  g_cc.edges += edges;
+  g_cc.comp_reads += reads;
+  g_cc.comp_writes += writes;
+  g_cc.rounds += rounds;
+  g_cc.seconds += t_total.Seconds();
+  return comp;
+}
+
+void PrintCompStats(const Graph &g, const pvector<NodeID> &comp) {
+  unordered_map<NodeID, NodeID> count;
+  for (NodeID comp_i : comp)
+    count[comp_i] += 1;
+  NodeID largest = 0;
+  for (const auto &kv : count)
+    largest = max(largest, kv.second);
+  cout << count.size() << " components, largest has " << largest
+       << " nodes (" << fixed << setprecision(1)
+       << 100.0 * largest / g.num_nodes() << "%)" << endl;
+}
+
+// Labels from a serial BFS over both edge directions; comp must induce the
+// same partition
+bool CCVerifier(const Graph &g, const pvector<NodeID> &comp) {
+  unordered_map<NodeID, NodeID> label_to_source;
+  for (NodeID l : comp)
+    label_to_source[l] = -1;
+  pvector<bool> visited(g.num_nodes(), false);
+  vector<NodeID> frontier;
+  frontier.reserve(g.num_nodes());
+  for (NodeID u : g.vertices()) {
+    if (visited[u])
+      continue;
+    // A second BFS root with the same label: two components merged
+    NodeID &owner = label_to_source[comp[u]];
+    if (owner != -1) {
+      cout << "Components of " << owner << " and " << u
+           << " share label " << comp[u] << endl;
+      return false;
+    }
+    owner = u;
+    frontier.clear();
+    frontier.push_back(u);
+    visited[u] = true;
+    for (size_t i = 0; i < frontier.size(); i++) {
+      NodeID x = frontier[i];
+      if (comp[x] != comp[u]) {
+        cout << "Component of " << u << " split: " << x << " has label "
+             << comp[x] << ", expected " << comp[u] << endl;
+        return false;
+      }
+      for (NodeID y : g.out_neigh(x)) {
+        if (!visited[y]) {
+          visited[y] = true;
+          frontier.push_back(y);
+        }
+      }
+      if (g.directed()) {
+        for (NodeID y : g.in_neigh(x)) {
+          if (!visited[y]) {
+            visited[y] = true;
+            frontier.push_back(y);
+          }
+        }
+      }
+    }
+  }
+  return true;
+}
+
+int main(int argc, char* argv[]) {
+  StripCustomArgs(argc, argv);
+  if (g_algo != "afforest" && g_algo != "sv") {
+    cout << "--algo must be afforest or sv" << endl;
+    return -1;
+  }
+  CLApp cli(argc, argv, "connected-components");
+  if (!cli.ParseArgs()) return -1;
+
+  GraphProvider provider;
+  const Graph &g = provider.Get(cli, g_snapshot, g_prefault);
+  auto CCBound = [&cli] (const Graph &g) {
+    if (g_algo == "sv")
+      return ShiloachVishkin(g, cli.logging_en());
+    return Afforest(g, cli.logging_en(), g_neighbor_rounds);
+  };
+  BenchmarkKernel(cli, g, CCBound, PrintCompStats, CCVerifier);
+
+  const int trials = cli.num_trials();
+  const double bytes_est = g_cc.BytesEstimate() / trials;
+  const int64_t edges = g_cc.edges / trials;
+  cout << "Algorithm: " << g_algo << endl;
+  cout << "Traversed edges: " << edges << " ("
+       << fixed << setprecision(1) << 100.0 * edges / g.num_edges_directed()
+       << "% of the graph, " << g_cc.rounds / trials << " rounds)" << endl;
+  cout << "CC Time (s): " << setprecision(6) << g_cc.seconds / trials << endl;
+  cout << "Estimated bytes: " << setprecision(0) << bytes_est << endl;
+  cout << "Edges per byte (Ie): " << setprecision(6)
+       << (bytes_est > 0 ? edges / bytes_est : 0.0) << endl;
+  cout << "TEPS: " << setprecision(3)
+       << (g_cc.seconds > 0 ? g_cc.edges / g_cc.seconds : 0.0) << endl;
+  // Comparable across algorithms that skip different numbers of edges
+  cout << "Graph edges per second: "
+       << (g_cc.seconds > 0 ? g.num_edges_directed() * trials / g_cc.seconds
+                            : 0.0) << endl;
+  return 0;
+}
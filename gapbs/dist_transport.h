@@ -0,0 +1,280 @@
+#ifndef DIST_TRANSPORT_H_
+#define DIST_TRANSPORT_H_
+
+#include <sched.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+/*
+Message transport for the multi-process BFS (bfs_dist.cc)
+
+Transport is the interface the BFS is written against: every rank calls
+Exchange at the same point with its own group (a grid row, a grid column
+or everyone), hands one byte buffer per group member and gets one back
+from each. Collectives (allgather, allreduce, broadcast, gather) are thin
+wrappers over Exchange. Another transport (sockets, MPI) only has to
+provide Exchange.
+
+ShmTransport is the local implementation: one MAP_SHARED anonymous region
+created before fork(), holding a P x P grid of fixed-size slots and a
+sense-reversing barrier. An exchange runs in rounds: every rank writes up
+to one slot's worth to each destination, all ranks meet at the barrier,
+read what was addressed to them and meet again. A shared counter says
+whether any rank still has data, so messages larger than a slot simply
+take more rounds. The barrier spins with sched_yield, which keeps it
+usable when there are more ranks than cores.
+
+A rank that dies would leave the others spinning, so every kCheckSpins
+yields the barrier checks its peers. Rank 0 reaps the children passed to
+WatchChildren without blocking. If one has exited, it kills the rest and
+exits. The other ranks exit once the process that created the transport
+is gone.
+
+Sent bytes (payload to other ranks only, a rank's message to itself is a
+local copy) are counted per rank, which is what the BFS reports as
+communication volume.
+*/
+
+class Transport {
+ public:
+  virtual ~Transport() {}
+  virtual int rank() const = 0;
+  virtual int size() const = 0;
+
+  // send[k] goes to group[k]; recv[k] is what group[k] sent here. Every
+  // rank must call this the same number of times, whatever its group.
+  virtual void Exchange(const std::vector<int> &group,
+                        const std::vector<std::vector<uint8_t>> &send,
+                        std::vector<std::vector<uint8_t>> &recv) = 0;
+
+  int64_t bytes_sent() const { return bytes_sent_; }
+
+  void Barrier() {
+    std::vector<int> self(1, rank());
+    std::vector<std::vector<uint8_t>> send(1), recv;
+    Exchange(self, send, recv);
+  }
+
+  // recv[k] is group[k]'s data
+  void AllGather(const std::vector<int> &group,
+                 const std::vector<uint8_t> &data,
+                 std::vector<std::vector<uint8_t>> &recv) {
+    std::vector<std::vector<uint8_t>> send(group.size(), data);
+    Exchange(group, send, recv);
+  }
+
+  // Element-wise sum over all ranks
+  void AllReduceSum(std::vector<int64_t> &values) {
+    std::vector<uint8_t> bytes(values.size() * sizeof(int64_t));
+    memcpy(bytes.data(), values.data(), bytes.size());
+    std::vector<std::vector<uint8_t>> recv;
+    AllGather(World(), bytes, recv);
+    std::fill(values.begin(), values.end(), 0);
+    for (const std::vector<uint8_t> &r : recv) {
+      const int64_t *v = reinterpret_cast<const int64_t*>(r.data());
+      for (size_t i = 0; i < values.size(); i++)
+        values[i] += v[i];
+    }
+  }
+
+  int64_t AllReduceSum(int64_t value) {
+    std::vector<int64_t> values(1, value);
+    AllReduceSum(values);
+    return values[0];
+  }
+
+  // Rank 0's data to everyone
+  std::vector<uint8_t> Broadcast(const std::vector<uint8_t> &data) {
+    std::vector<std::vector<uint8_t>> send(size());
+    if (rank() == 0)
+      send.assign(size(), data);
+    std::vector<std::vector<uint8_t>> recv;
+    Exchange(World(), send, recv);
+    return recv[0];
+  }
+
+  // Everyone's data to rank 0 (empty elsewhere)
+  std::vector<std::vector<uint8_t>> Gather(const std::vector<uint8_t> &data) {
+    std::vector<std::vector<uint8_t>> send(size());
+    send[0] = data;
+    std::vector<std::vector<uint8_t>> recv;
+    Exchange(World(), send, recv);
+    return recv;
+  }
+
+  std::vector<int> World() const {
+    std::vector<int> all(size());
+    for (int r = 0; r < size(); r++)
+      all[r] = r;
+    return all;
+  }
+
+ protected:
+  int64_t bytes_sent_ = 0;
+};
+
+class ShmTransport : public Transport {
+ public:
+  // Maps the shared region; call before fork(), then SetRank in each process
+  ShmTransport(int num_ranks, size_t slot_bytes)
+      : num_ranks_(num_ranks), rank_(0), slot_bytes_(slot_bytes),
+        owner_(getpid()), sense_(0), round_(0) {
+    region_bytes_ = kHeaderBytes + size_t(num_ranks) * num_ranks * SlotStride();
+    void *p = mmap(nullptr, region_bytes_, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    region_ = p == MAP_FAILED ? nullptr : static_cast<uint8_t*>(p);
+    if (region_ != nullptr)
+      memset(region_, 0, kHeaderBytes);
+  }
+
+  ~ShmTransport() {
+    if (region_ != nullptr)
+      munmap(region_, region_bytes_);
+  }
+
+  ShmTransport(const ShmTransport &) = delete;
+  ShmTransport &operator=(const ShmTransport &) = delete;
+
+  bool ok() const { return region_ != nullptr; }
+  void SetRank(int rank) { rank_ = rank; }
+
+  // Rank 0 only: children[k] is rank k + 1
+  void WatchChildren(const std::vector<pid_t> &children) {
+    children_ = children;
+    exited_.assign(children.size(), false);
+  }
+  int rank() const override { return rank_; }
+  int size() const override { return num_ranks_; }
+
+  void Exchange(const std::vector<int> &group,
+                const std::vector<std::vector<uint8_t>> &send,
+                std::vector<std::vector<uint8_t>> &recv) override {
+    const size_t n = group.size();
+    recv.assign(n, std::vector<uint8_t>());
+    std::vector<size_t> offset(n, 0);
+    bool more;
+    do {
+      int64_t *pending = Counter(round_ % 3);
+      if (rank_ == 0)
+        *Counter((round_ + 1) % 3) = 0;
+      bool mine = false;
+      for (size_t k = 0; k < n; k++) {
+        if (group[k] == rank_) {
+          if (offset[k] == 0)
+            recv[k] = send[k];
+          offset[k] = send[k].size();
+          continue;
+        }
+        Slot s = GetSlot(rank_, group[k]);
+        size_t len = std::min(slot_bytes_, send[k].size() - offset[k]);
+        memcpy(s.data, send[k].data() + offset[k], len);
+        *s.len = len;
+        offset[k] += len;
+        bytes_sent_ += len;
+        mine |= offset[k] < send[k].size();
+      }
+      if (mine)
+        __atomic_fetch_add(pending, 1, __ATOMIC_SEQ_CST);
+      WorldBarrier();
+      for (size_t k = 0; k < n; k++) {
+        if (group[k] == rank_) continue;
+        Slot s = GetSlot(group[k], rank_);
+        recv[k].insert(recv[k].end(), s.data, s.data + *s.len);
+        *s.len = 0;
+      }
+      more = __atomic_load_n(pending, __ATOMIC_SEQ_CST) != 0;
+      round_++;
+      WorldBarrier();
+    } while (more);
+  }
+
+ private:
+  static const size_t kHeaderBytes = 4096;
+  static const int64_t kCheckSpins = 1024;
+
+  struct Slot {
+    uint64_t *len;
+    uint8_t *data;
+  };
+
+  size_t SlotStride() const { return (slot_bytes_ + 64 + 63) / 64 * 64; }
+
+  Slot GetSlot(int from, int to) {
+    uint8_t *base = region_ + kHeaderBytes +
+                    (size_t(from) * num_ranks_ + to) * SlotStride();
+    return Slot{reinterpret_cast<uint64_t*>(base), base + 64};
+  }
+
+  int64_t* Counter(int i) {
+    return reinterpret_cast<int64_t*>(region_ + 64 + 64 * i);
+  }
+
+  // Sense-reversing barrier over all ranks
+  void WorldBarrier() {
+    int32_t *count = reinterpret_cast<int32_t*>(region_);
+    int32_t *sense = reinterpret_cast<int32_t*>(region_ + 32);
+    sense_ = 1 - sense_;
+    if (__atomic_add_fetch(count, 1, __ATOMIC_SEQ_CST) == num_ranks_) {
+      __atomic_store_n(count, 0, __ATOMIC_SEQ_CST);
+      __atomic_store_n(sense, sense_, __ATOMIC_SEQ_CST);
+    } else {
+      for (int64_t spins = 1;
+           __atomic_load_n(sense, __ATOMIC_SEQ_CST) != sense_; spins++) {
+        sched_yield();
+        if (spins % kCheckSpins == 0)
+          CheckPeers();
+      }
+    }
+  }
+
+  // Ranks only exit after the last collective, so a peer that is gone
+  // while this rank waits means the barrier can never complete
+  void CheckPeers() {
+    if (rank_ != 0) {
+      if (getppid() != owner_)
+        _exit(1);
+      return;
+    }
+    int dead = -1;
+    for (size_t k = 0; k < children_.size(); k++) {
+      if (!exited_[k] && waitpid(children_[k], nullptr, WNOHANG) ==
+                         children_[k])
+        exited_[k] = true;
+      if (exited_[k] && dead < 0)
+        dead = k + 1;
+    }
+    if (dead < 0)
+      return;
+    std::cout << "Rank " << dead << " exited during a collective, stopping"
+              << std::endl;
+    for (size_t k = 0; k < children_.size(); k++) {
+      if (!exited_[k]) {
+        kill(children_[k], SIGKILL);
+        waitpid(children_[k], nullptr, 0);
+      }
+    }
+    exit(1);
+  }
+
+  int num_ranks_;
+  int rank_;
+  size_t slot_bytes_;
+  size_t region_bytes_;
+  uint8_t *region_;
+  pid_t owner_;                        // process that mapped the region
+  std::vector<pid_t> children_;
+  std::vector<bool> exited_;
+  int32_t sense_;
+  int64_t round_;
+};
+
+#endif  // DIST_TRANSPORT_H_
@@ -0,0 +1,192 @@
+#include <iostream>
+#include <vector>
+#include <iomanip>
+#include <cstdint>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <utility>
+
+#include "benchmark.h"
+#include "bfs_kernel.h"
+#include "builder.h"
+#include "command_line.h"
+#include "dynamic_bfs.h"
+#include "graph.h"
+#include "pvector.h"
+#include "timer.h"
+
+/*
+Incremental BFS driver (dynamic_bfs.h)
+
+Builds the graph, runs one BFS from the source, then applies -n batches of
+random edge updates. Each batch is repaired in place and timed against what
+a static pipeline would do: fold the updates into a fresh CSR
+(Materialize + MakeGraphFromEL) and run DOBFS (bfs_kernel.h) on it. Both
+ratios are printed, repair against DOBFS alone and against rebuild plus
+DOBFS. With -v the repaired tree is checked by BFSVerifier on that CSR and
+its depths against a full DynamicBFS::Recompute.
+
+Half of the deletes (by default) hit tree edges, since deleting a non-tree
+edge never needs repair and would make the comparison look better than it
+is.
+
+Extra flags (stripped before CLApp sees them):
+  --batch=K            updates per batch (default 100)
+  --delete-frac=F      fraction of updates that are deletes (default 0.5)
+  --tree-delete-frac=F fraction of deletes taken from the BFS tree (0.5)
+  --verify=serial|parallel|sampled, --verify-samples=K  -v checker
+                      (bfs_verify.h, default parallel)
+*/
+
+using namespace std;
+
+typedef EdgePair<NodeID, NodeID> Edge;
+typedef pvector<Edge> EdgeList;
+typedef vector<pair<NodeID, NodeID>> UpdateList;
+
+static int g_batch = 100;
+static double g_delete_frac = 0.5;
+static double g_tree_delete_frac = 0.5;
+
+static void StripCustomArgs(int& argc, char** argv) {
+  int out = 1;
+  for (int i = 1; i < argc; ++i) {
+    string a = argv[i];
+    if (a.compare(0, 8, "--batch=") == 0) g_batch = atoi(a.c_str() + 8);
+    else if (a.compare(0, 14, "--delete-frac=") == 0)
+      g_delete_frac = atof(a.c_str() + 14);
+    else if (a.compare(0, 19, "--tree-delete-frac=") == 0)
+      g_tree_delete_frac = atof(a.c_str() + 19);
+    else if (ParseVerifyArg(a, g_verify)) continue;
+    else argv[out++] = argv[i];
+  }
+  argc = out;
+}
+
+// Applies one random batch to dg; deleted/inserted get the updates that
+// took effect
+static void MakeBatch(DynamicGraph &dg, const DynamicBFS &bfs, mt19937 &rng,
+                      UpdateList &deleted, UpdateList &inserted) {
+  uniform_int_distribution<NodeID> any_node(0, dg.num_nodes() - 1);
+  uniform_real_distribution<double> coin(0, 1);
+  deleted.clear();
+  inserted.clear();
+  for (int i = 0; i < g_batch; i++) {
+    if (coin(rng) >= g_delete_frac) {
+      NodeID u = any_node(rng), v = any_node(rng);
+      if (dg.InsertEdge(u, v)) inserted.push_back(make_pair(u, v));
+      continue;
+    }
+    // Delete: a tree edge into a random reached vertex, or a random edge
+    for (int tries = 0; tries < 64; tries++) {
+      NodeID v = any_node(rng);
+      NodeID u = -1;
+      if (coin(rng) < g_tree_delete_frac) {
+        if (bfs.parent()[v] >= 0 && bfs.parent()[v] != v) u = bfs.parent()[v];
+      } else {
+        vector<NodeID> neighs;
+        dg.ForEachIn(v, [&](NodeID x) { neighs.push_back(x); });
+        if (!neighs.empty()) u = neighs[rng() % neighs.size()];
+      }
+      if (u >= 0 && dg.DeleteEdge(u, v)) {
+        deleted.push_back(make_pair(u, v));
+        break;
+      }
+    }
+  }
+}
+
+// Folds the overlay into a new CSR, as a static pipeline would per batch
+static Graph Rebuild(const CLApp &cli, const DynamicGraph &dg) {
+  EdgeList el = dg.Materialize();
+  Builder b(cli);
+  return b.MakeGraphFromEL(el);
+}
+
+static bool VerifyAgainstRebuild(const Graph &rebuilt, const DynamicGraph &dg,
+                                 const DynamicBFS &bfs) {
+  // The builder sizes the graph by the largest endpoint, so trailing
+  // isolated vertices may be missing; they must be unreached
+  pvector<NodeID> parent(rebuilt.num_nodes());
+  for (NodeID v = 0; v < dg.num_nodes(); v++) {
+    if (v < rebuilt.num_nodes()) parent[v] = bfs.parent()[v];
+    else if (bfs.parent()[v] != -1 && v != bfs.source()) return false;
+  }
+  if (bfs.source() >= rebuilt.num_nodes())
+    return true;
+  return BFSVerifier(rebuilt, bfs.source(), parent);
+}
+
+int main(int argc, char* argv[]) {
+  StripCustomArgs(argc, argv);
+  CLApp cli(argc, argv, "incremental breadth-first search");
+  if (!cli.ParseArgs()) return -1;
+
+  Builder b(cli);
+  Graph g = b.MakeGraph();
+  g.PrintStats();
+  SourcePicker<Graph> sp(g, cli.start_vertex());
+  NodeID source = sp.PickNext();
+
+  DynamicGraph dg(g);
+  Timer t;
+  t.Start();
+  DynamicBFS bfs(dg, source);
+  t.Stop();
+  PrintStep("Source", static_cast<int64_t>(source));
+  PrintTime("Initial BFS", t.Seconds());
+
+  // Depth reference for -v only; runs on its own copy so it cannot help
+  // the repair
+  DynamicBFS scratch(dg, source);
+  BFSOptions opts;
+  mt19937 rng(27491095);
+  UpdateList deleted, inserted;
+  double repair_total = 0, rebuild_total = 0, dobfs_total = 0;
+  int failures = 0;
+  for (int trial = 0; trial < cli.num_trials(); trial++) {
+    MakeBatch(dg, bfs, rng, deleted, inserted);
+    t.Start();
+    bfs.Repair(deleted, inserted);
+    t.Stop();
+    double repair = t.Seconds();
+    t.Start();
+    Graph rebuilt = Rebuild(cli, dg);
+    t.Stop();
+    double rebuild = t.Seconds();
+    // DOBFS time is the traversal only (g_bfs_time_sec), not its setup
+    double dobfs = 0;
+    if (source < rebuilt.num_nodes()) {
+      DOBFS<kMetricsNone>(rebuilt, source, false, opts);
+      dobfs = g_bfs_time_sec;
+    }
+    repair_total += repair;
+    rebuild_total += rebuild;
+    dobfs_total += dobfs;
+    cout << "batch " << setw(3) << trial << ": -" << deleted.size() << " +"
+         << inserted.size() << " edges, touched " << bfs.touched()
+         << "  repair " << fixed << setprecision(6) << repair
+         << " s  DOBFS " << dobfs << " s  rebuild " << rebuild << " s  ("
+         << setprecision(1) << (repair > 0 ? dobfs / repair : 0) << "x, "
+         << (repair > 0 ? (rebuild + dobfs) / repair : 0) << "x)" << endl;
+    if (cli.do_verify()) {
+      scratch.Recompute();
+      bool ok = VerifyAgainstRebuild(rebuilt, dg, bfs);
+      for (NodeID v = 0; ok && v < dg.num_nodes(); v++)
+        ok = bfs.depth()[v] == scratch.depth()[v];
+      PrintLabel("Verification", ok ? "PASS" : "FAIL");
+      if (!ok) failures++;
+    }
+  }
+  PrintTime("Average Repair", repair_total / cli.num_trials());
+  PrintTime("Average DOBFS", dobfs_total / cli.num_trials());
+  PrintTime("Average Rebuild", rebuild_total / cli.num_trials());
+  if (repair_total > 0) {
+    cout << "Speedup vs DOBFS: " << fixed << setprecision(1)
+         << dobfs_total / repair_total << "x" << endl;
+    cout << "Speedup vs rebuild + DOBFS: "
+         << (rebuild_total + dobfs_total) / repair_total << "x" << endl;
+  }
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,354 @@
+#ifndef DYNAMIC_BFS_H_
+#define DYNAMIC_BFS_H_
+
+#include <algorithm>
+#include <cinttypes>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "benchmark.h"
+#include "graph.h"
+#include "pvector.h"
+
+/*
+BFS tree maintenance under edge insertions and deletions
+
+DynamicGraph is a CSR Graph plus an update overlay: per-vertex lists of
+inserted neighbors and a set of deleted base edges. Undirected graphs keep
+both directions of every update, so in_neigh and out_neigh stay mirrors.
+The base CSR is never modified; Materialize() produces an edge list of the
+current graph for MakeGraphFromEL (verification, or folding the overlay
+back into a fresh CSR once it grows large).
+
+DynamicBFS keeps parent and depth from one source and repairs them after
+each batch instead of recomputing:
+
+  inserts   an edge (u, v) with depth[u] + 1 < depth[v] lowers v; lowered
+            vertices are relaxed outward level by level (bucketed by depth)
+            until no neighbor improves
+  deletes   only deleting a tree edge (parent[v], v) can change anything.
+            Broken vertices are handled in depth order: one that still has
+            an in-neighbor one level up is re-parented on the spot; otherwise
+            its subtree (vertices whose parent chain passes through it) is
+            invalidated and re-attached from the frontier of valid vertices
+            around it, again relaxing level by level
+
+A batch applies its deletes first, then its inserts. Work is proportional to
+the vertices whose depth or parent changes plus their neighborhoods, which
+for small batches is a tiny fraction of a full BFS.
+*/
+
+class DynamicGraph {
+ public:
+  explicit DynamicGraph(const Graph &g)
+      : g_(g), added_out_(g.num_nodes()), deleted_count_(g.num_nodes(), 0) {
+    if (g.directed())
+      added_in_.resize(g.num_nodes());
+  }
+
+  int64_t num_nodes() const { return g_.num_nodes(); }
+  bool directed() const { return g_.directed(); }
+
+  bool HasEdge(NodeID u, NodeID v) const {
+    const std::vector<NodeID> &added = added_out_[u];
+    if (std::find(added.begin(), added.end(), v) != added.end())
+      return true;
+    return InBase(u, v) && !IsDeleted(u, v);
+  }
+
+  // Returns false if the edge is a self loop or already present
+  bool InsertEdge(NodeID u, NodeID v) {
+    if (u == v || HasEdge(u, v))
+      return false;
+    if (InBase(u, v)) {
+      Undelete(u, v);
+      if (!directed()) Undelete(v, u);
+    } else {
+      added_out_[u].push_back(v);
+      if (directed()) added_in_[v].push_back(u);
+      else added_out_[v].push_back(u);
+      num_added_++;
+    }
+    return true;
+  }
+
+  // Returns false if the edge is not present
+  bool DeleteEdge(NodeID u, NodeID v) {
+    if (RemoveAdded(added_out_[u], v)) {
+      if (directed()) RemoveAdded(added_in_[v], u);
+      else RemoveAdded(added_out_[v], u);
+      num_added_--;
+      return true;
+    }
+    if (!InBase(u, v) || IsDeleted(u, v))
+      return false;
+    MarkDeleted(u, v);
+    if (!directed()) MarkDeleted(v, u);
+    return true;
+  }
+
+  template <typename F>
+  void ForEachOut(NodeID u, F f) const {
+    if (deleted_count_[u] == 0) {
+      for (NodeID v : g_.out_neigh(u)) f(v);
+    } else {
+      for (NodeID v : g_.out_neigh(u))
+        if (!IsDeleted(u, v)) f(v);
+    }
+    for (NodeID v : added_out_[u]) f(v);
+  }
+
+  template <typename F>
+  void ForEachIn(NodeID v, F f) const {
+    if (!directed()) {
+      ForEachOut(v, f);
+      return;
+    }
+    if (deleted_count_[v] == 0) {
+      for (NodeID u : g_.in_neigh(v)) f(u);
+    } else {
+      for (NodeID u : g_.in_neigh(v))
+        if (!IsDeleted(u, v)) f(u);
+    }
+    for (NodeID u : added_in_[v]) f(u);
+  }
+
+  // Current edges, each undirected edge once per direction
+  pvector<EdgePair<NodeID, NodeID>> Materialize() const {
+    std::vector<EdgePair<NodeID, NodeID>> edges;
+    for (NodeID u = 0; u < num_nodes(); u++)
+      ForEachOut(u, [&](NodeID v) {
+        edges.push_back(EdgePair<NodeID, NodeID>(u, v));
+      });
+    pvector<EdgePair<NodeID, NodeID>> el(edges.size());
+    std::copy(edges.begin(), edges.end(), el.begin());
+    return el;
+  }
+
+  size_t overlay_size() const { return num_added_ + deleted_.size(); }
+
+ private:
+  static uint64_t Key(NodeID u, NodeID v) {
+    return (static_cast<uint64_t>(static_cast<uint32_t>(u)) << 32) |
+           static_cast<uint32_t>(v);
+  }
+
+  // Base neighborhoods are sorted by the builder
+  bool InBase(NodeID u, NodeID v) const {
+    auto neigh = g_.out_neigh(u);
+    return std::binary_search(neigh.begin(), neigh.end(), v);
+  }
+
+  // Deleted (u, v) is tracked at both ends of a directed edge: u for
+  // out_neigh and v for in_neigh
+  bool IsDeleted(NodeID u, NodeID v) const {
+    return deleted_.count(Key(u, v)) != 0;
+  }
+
+  void MarkDeleted(NodeID u, NodeID v) {
+    deleted_.insert(Key(u, v));
+    deleted_count_[u]++;
+    if (directed()) deleted_count_[v]++;
+  }
+
+  void Undelete(NodeID u, NodeID v) {
+    if (deleted_.erase(Key(u, v)) == 0) return;
+    deleted_count_[u]--;
+    if (directed()) deleted_count_[v]--;
+  }
+
+  bool RemoveAdded(std::vector<NodeID> &list, NodeID v) {
+    auto it = std::find(list.begin(), list.end(), v);
+    if (it == list.end()) return false;
+    *it = list.back();
+    list.pop_back();
+    return true;
+  }
+
+  const Graph &g_;
+  std::vector<std::vector<NodeID>> added_out_;
+  std::vector<std::vector<NodeID>> added_in_;       // directed graphs only
+  std::vector<int32_t> deleted_count_;
+  std::unordered_set<uint64_t> deleted_;
+  size_t num_added_ = 0;
+};
+
+class DynamicBFS {
+ public:
+  DynamicBFS(const DynamicGraph &dg, NodeID source)
+      : dg_(dg), source_(source), parent_(dg.num_nodes()),
+        depth_(dg.num_nodes()), mark_(dg.num_nodes(), 0) {
+    Recompute();
+  }
+
+  const pvector<NodeID>& parent() const { return parent_; }
+  const pvector<int32_t>& depth() const { return depth_; }
+  NodeID source() const { return source_; }
+
+  // Parent/depth writes made by the last Repair
+  int64_t touched() const { return touched_; }
+
+  // Repairs after one batch; the edges must already be applied to the
+  // DynamicGraph. An edge both inserted and deleted within the batch is
+  // judged by whether it is present at the end.
+  void Repair(const std::vector<std::pair<NodeID, NodeID>> &deleted,
+              const std::vector<std::pair<NodeID, NodeID>> &inserted) {
+    touched_ = 0;
+    RepairDeletes(deleted);
+    RepairInserts(inserted);
+  }
+
+  // Serial BFS over the current graph; the from-scratch baseline
+  void Recompute() {
+    std::fill(parent_.begin(), parent_.end(), -1);
+    std::fill(depth_.begin(), depth_.end(), -1);
+    parent_[source_] = source_;
+    depth_[source_] = 0;
+    std::vector<NodeID> queue(1, source_);
+    for (size_t i = 0; i < queue.size(); i++) {
+      NodeID u = queue[i];
+      dg_.ForEachOut(u, [&](NodeID v) {
+        if (depth_[v] < 0) {
+          depth_[v] = depth_[u] + 1;
+          parent_[v] = u;
+          queue.push_back(v);
+        }
+      });
+    }
+  }
+
+ private:
+  void RepairDeletes(const std::vector<std::pair<NodeID, NodeID>> &deleted) {
+    std::vector<NodeID> broken;
+    for (const auto &e : deleted) {
+      if (dg_.HasEdge(e.first, e.second))
+        continue;
+      if (parent_[e.second] == e.first && e.second != source_)
+        broken.push_back(e.second);
+      if (!dg_.directed() && parent_[e.first] == e.second &&
+          e.first != source_)
+        broken.push_back(e.first);
+    }
+    std::sort(broken.begin(), broken.end(), [this](NodeID a, NodeID b) {
+      return depth_[a] < depth_[b];
+    });
+    ++epoch_;
+    std::vector<NodeID> invalid;
+    for (NodeID b : broken) {
+      if (mark_[b] == epoch_)
+        continue;                       // inside an invalidated subtree
+      // Another in-neighbor one level up keeps every depth unchanged
+      NodeID alt = -1;
+      dg_.ForEachIn(b, [&](NodeID x) {
+        if (alt < 0 && mark_[x] != epoch_ && depth_[x] == depth_[b] - 1)
+          alt = x;
+      });
+      if (alt >= 0) {
+        parent_[b] = alt;
+        touched_++;
+        continue;
+      }
+      InvalidateSubtree(b, invalid);
+    }
+    if (invalid.empty())
+      return;
+
+    // Best valid in-neighbor for each invalidated vertex seeds the buckets
+    Buckets buckets;
+    for (NodeID w : invalid) {
+      depth_[w] = -1;
+      parent_[w] = -1;
+    }
+    for (NodeID w : invalid) {
+      dg_.ForEachIn(w, [&](NodeID x) {
+        if (mark_[x] != epoch_ && depth_[x] >= 0 &&
+            (depth_[w] < 0 || depth_[x] + 1 < depth_[w])) {
+          depth_[w] = depth_[x] + 1;
+          parent_[w] = x;
+        }
+      });
+      if (depth_[w] >= 0)
+        buckets.Push(w, depth_[w]);
+    }
+    touched_ += invalid.size();
+    Relax(buckets);
+  }
+
+  void RepairInserts(const std::vector<std::pair<NodeID, NodeID>> &inserted) {
+    ++epoch_;
+    Buckets buckets;
+    auto Lower = [&](NodeID u, NodeID v) {
+      if (depth_[u] >= 0 && (depth_[v] < 0 || depth_[u] + 1 < depth_[v])) {
+        depth_[v] = depth_[u] + 1;
+        parent_[v] = u;
+        buckets.Push(v, depth_[v]);
+        touched_++;
+      }
+    };
+    for (const auto &e : inserted) {
+      if (!dg_.HasEdge(e.first, e.second))
+        continue;
+      Lower(e.first, e.second);
+      if (!dg_.directed()) Lower(e.second, e.first);
+    }
+    Relax(buckets);
+  }
+
+  // Vertices waiting at each tentative depth
+  struct Buckets {
+    std::vector<std::vector<NodeID>> level;
+    void Push(NodeID v, int32_t d) {
+      if ((int32_t) level.size() <= d) level.resize(d + 1);
+      level[d].push_back(v);
+    }
+  };
+
+  // Level-ordered relaxation from the queued vertices. Not limited to the
+  // invalidated subtrees: the graph already holds the batch's inserts, so a
+  // re-attached vertex can end up shallower than before and lower valid
+  // neighbors that no inserted edge touches.
+  void Relax(Buckets &buckets) {
+    for (size_t d = 0; d < buckets.level.size(); d++) {
+      for (size_t i = 0; i < buckets.level[d].size(); i++) {
+        NodeID u = buckets.level[d][i];
+        if (depth_[u] != (int32_t) d)
+          continue;                     // stale entry, lowered since
+        dg_.ForEachOut(u, [&](NodeID v) {
+          if (depth_[v] < 0 || depth_[u] + 1 < depth_[v]) {
+            depth_[v] = depth_[u] + 1;
+            parent_[v] = u;
+            buckets.Push(v, depth_[v]);
+            touched_++;
+          }
+        });
+      }
+    }
+  }
+
+  // Marks b and every vertex whose tree path runs through b
+  void InvalidateSubtree(NodeID b, std::vector<NodeID> &invalid) {
+    size_t start = invalid.size();
+    mark_[b] = epoch_;
+    invalid.push_back(b);
+    for (size_t i = start; i < invalid.size(); i++) {
+      NodeID x = invalid[i];
+      dg_.ForEachOut(x, [&](NodeID w) {
+        if (mark_[w] != epoch_ && parent_[w] == x && w != source_) {
+          mark_[w] = epoch_;
+          invalid.push_back(w);
+        }
+      });
+    }
+  }
+
+  const DynamicGraph &dg_;
+  NodeID source_;
+  pvector<NodeID> parent_;
+  pvector<int32_t> depth_;
+  pvector<uint32_t> mark_;
+  uint32_t epoch_ = 0;
+  int64_t touched_ = 0;
+};
+
+#endif  // DYNAMIC_BFS_H_
@@ -0,0 +1,258 @@
+#ifndef EDGE_BALANCE_H_
+#define EDGE_BALANCE_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cinttypes>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <vector>
+
+#include "graph.h"
+#include "pvector.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/*
+Edge-balanced partitioning of a top-down frontier
+
+Splitting the frontier by vertex count (schedule(dynamic, 64) over the
+queue) gives each thread the same number of vertices, not the same number
+of edges; on Kronecker graphs one chunk holding a hub can take longer than
+the rest of the step. EdgeBalancer splits by edges instead:
+
+  1. prefix sums of out_degree over the frontier (parallel two-pass scan)
+  2. the frontier's edges, concatenated, are cut into chunks of about
+     grain edges; a chunk starts mid-list when a hub spans several chunks,
+     so no vertex is larger than a chunk
+  3. thread t starts out owning the contiguous chunks [t*C/T, (t+1)*C/T)
+     and takes them from the front; a thread that runs dry steals the back
+     half of the fullest other range (one CAS on a packed begin/end word)
+
+Per step it records the edges each thread examined. Imbalance is
+max/mean over threads, summed over steps as sum(max) / sum(mean), and is
+reported next to what a static split by vertex count would have given for
+the same frontiers.
+*/
+
+class EdgeBalancer {
+ public:
+  static const int64_t kMinGrain = 512;
+  static const int kChunksPerThread = 16;
+
+  EdgeBalancer() = default;
+  ~EdgeBalancer() { FreeRanges(); }
+  EdgeBalancer(const EdgeBalancer &) = delete;
+  EdgeBalancer &operator=(const EdgeBalancer &) = delete;
+
+  // Splits the frontier [begin, begin + count) for num_threads workers
+  template <typename GraphT>
+  void Plan(const GraphT &g, const NodeID *begin, int64_t count,
+            int num_threads) {
+    frontier_ = begin;
+    count_ = count;
+    if ((int64_t) prefix_.size() < count + 1)
+      prefix_ = pvector<int64_t>(std::max<int64_t>(count + 1, 1024));
+    Scan(g, num_threads);
+    total_ = prefix_[count];
+    grain_ = std::max(kMinGrain,
+                      total_ / (num_threads * kChunksPerThread) + 1);
+    num_chunks_ = (total_ + grain_ - 1) / grain_;
+    if (num_threads_ != num_threads) {
+      FreeRanges();
+      void *mem = nullptr;
+      if (posix_memalign(&mem, 64, num_threads * sizeof(Range)) != 0)
+        throw std::bad_alloc();
+      ranges_ = new (mem) Range[num_threads];
+      num_threads_ = num_threads;
+    }
+    for (int t = 0; t < num_threads; t++) {
+      uint64_t lo = num_chunks_ * t / num_threads;
+      uint64_t hi = num_chunks_ * (t + 1) / num_threads;
+      ranges_[t].word.store(Pack(lo, hi), std::memory_order_relaxed);
+    }
+    per_thread_.assign(num_threads, 0);
+  }
+
+  // Next chunk for thread tid, own range first, then stolen; false when
+  // every chunk has been claimed
+  bool Claim(int tid, int64_t &chunk) {
+    while (true) {
+      if (TakeFront(ranges_[tid], chunk))
+        return true;
+      if (!Steal(tid))
+        return false;
+    }
+  }
+
+  // Calls f(frontier index, first neighbor index, end neighbor index) for
+  // the pieces of each adjacency list that fall inside the chunk
+  template <typename F>
+  void ForEachInChunk(int64_t chunk, F f) const {
+    int64_t e = chunk * grain_;
+    int64_t e_end = std::min(e + grain_, total_);
+    int64_t i = std::upper_bound(prefix_.begin(), prefix_.begin() + count_ + 1,
+                                 e) - prefix_.begin() - 1;
+    while (e < e_end) {
+      int64_t list_end = std::min(prefix_[i + 1], e_end);
+      f(i, e - prefix_[i], list_end - prefix_[i]);
+      e = list_end;
+      i++;
+    }
+  }
+
+  // Edges examined by each thread in the current step
+  void AddThreadEdges(int tid, int64_t edges) { per_thread_[tid] += edges; }
+
+  // Folds the current step into the totals
+  void StepDone() {
+    if (num_threads_ <= 0 || total_ == 0)
+      return;
+    double mean = static_cast<double>(total_) / num_threads_;
+    int64_t busiest = *std::max_element(per_thread_.begin(),
+                                        per_thread_.end());
+    int64_t vertex_split = 0;
+    for (int t = 0; t < num_threads_; t++) {
+      int64_t lo = count_ * t / num_threads_;
+      int64_t hi = count_ * (t + 1) / num_threads_;
+      vertex_split = std::max(vertex_split, prefix_[hi] - prefix_[lo]);
+    }
+    steps_++;
+    sum_mean_ += mean;
+    sum_max_ += busiest;
+    sum_vertex_split_ += vertex_split;
+    worst_ = std::max(worst_, busiest / mean);
+  }
+
+  void ResetStats() {
+    steps_ = 0;
+    steals_ = 0;
+    sum_mean_ = sum_max_ = sum_vertex_split_ = worst_ = 0;
+  }
+
+  int64_t steps() const { return steps_; }
+  int64_t steals() const { return steals_; }
+  double imbalance() const { return sum_mean_ > 0 ? sum_max_ / sum_mean_ : 1; }
+  double worst_step() const { return worst_; }
+  double vertex_split_imbalance() const {
+    return sum_mean_ > 0 ? sum_vertex_split_ / sum_mean_ : 1;
+  }
+
+  void PrintStats(std::ostream &os) const {
+    const std::ios::fmtflags flags = os.flags();
+    const std::streamsize precision = os.precision();
+    os << "Load imbalance (max/mean edges): " << std::fixed
+       << std::setprecision(3) << imbalance() << " over "
+       << steps() << " td steps, worst " << worst_step() << ", "
+       << steals() << " steals; vertex split: " << vertex_split_imbalance()
+       << std::endl;
+    os.flags(flags);
+    os.precision(precision);
+  }
+
+ private:
+  struct alignas(64) Range {
+    std::atomic<uint64_t> word;
+  };
+
+  void FreeRanges() {
+    for (int t = 0; t < num_threads_; t++)
+      ranges_[t].~Range();
+    free(ranges_);
+    ranges_ = nullptr;
+    num_threads_ = 0;
+  }
+
+  static uint64_t Pack(uint64_t lo, uint64_t hi) { return (lo << 32) | hi; }
+  static uint64_t Lo(uint64_t w) { return w >> 32; }
+  static uint64_t Hi(uint64_t w) { return w & 0xffffffffu; }
+
+  bool TakeFront(Range &r, int64_t &chunk) {
+    uint64_t w = r.word.load(std::memory_order_relaxed);
+    while (Lo(w) < Hi(w)) {
+      if (r.word.compare_exchange_weak(w, Pack(Lo(w) + 1, Hi(w)))) {
+        chunk = Lo(w);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Moves the back half of the largest other range into tid's range
+  bool Steal(int tid) {
+    while (true) {
+      int victim = -1;
+      uint64_t most = 0, w = 0;
+      for (int t = 0; t < num_threads_; t++) {
+        uint64_t vw = ranges_[t].word.load(std::memory_order_relaxed);
+        if (t != tid && Lo(vw) < Hi(vw) && Hi(vw) - Lo(vw) > most) {
+          victim = t;
+          most = Hi(vw) - Lo(vw);
+          w = vw;
+        }
+      }
+      if (victim < 0)
+        return false;
+      uint64_t mid = Lo(w) + (Hi(w) - Lo(w)) / 2;
+      if (ranges_[victim].word.compare_exchange_strong(w, Pack(Lo(w), mid))) {
+        ranges_[tid].word.store(Pack(mid, Hi(w)));
+        #pragma omp atomic
+        steals_++;
+        return true;
+      }
+    }
+  }
+
+  template <typename GraphT>
+  void Scan(const GraphT &g, int num_threads) {
+    std::vector<int64_t> block_sums(num_threads + 1, 0);
+    const int64_t count = count_;
+    const NodeID *frontier = frontier_;
+    #pragma omp parallel num_threads(num_threads)
+    {
+      int t = 0, nt = 1;
+#ifdef _OPENMP
+      t = omp_get_thread_num();
+      nt = omp_get_num_threads();
+#endif
+      int64_t lo = count * t / nt, hi = count * (t + 1) / nt;
+      int64_t sum = 0;
+      for (int64_t i = lo; i < hi; i++) {
+        prefix_[i] = sum;
+        sum += g.out_degree(frontier[i]);
+      }
+      block_sums[t + 1] = sum;
+      #pragma omp barrier
+      #pragma omp single
+      for (int b = 1; b <= nt; b++)
+        block_sums[b] += block_sums[b - 1];
+      for (int64_t i = lo; i < hi; i++)
+        prefix_[i] += block_sums[t];
+      if (t == nt - 1)
+        prefix_[count] = block_sums[nt];
+    }
+  }
+
+  const NodeID *frontier_ = nullptr;
+  int64_t count_ = 0;
+  int64_t total_ = 0;
+  int64_t grain_ = kMinGrain;
+  int64_t num_chunks_ = 0;
+  int num_threads_ = 0;
+  pvector<int64_t> prefix_;
+  Range *ranges_ = nullptr;
+  std::vector<int64_t> per_thread_;
+
+  int64_t steps_ = 0;
+  int64_t steals_ = 0;
+  double sum_mean_ = 0;
+  double sum_max_ = 0;
+  double sum_vertex_split_ = 0;
+  double worst_ = 0;
+};
+
+#endif  // EDGE_BALANCE_H_
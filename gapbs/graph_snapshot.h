@@ -0,0 +1,438 @@
+#ifndef GRAPH_SNAPSHOT_H_
+#define GRAPH_SNAPSHOT_H_
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <new>
+#include <string>
+#include <thread>
+
+#include "benchmark.h"
+#include "builder.h"
+#include "command_line.h"
+#include "graph.h"
+#include "pvector.h"
+#include "timer.h"
+
+/*
+Memory-mapped CSR snapshots
+
+Regenerating a -g 25 Kronecker graph takes longer than the BFS trials we
+run on it. A snapshot stores the finished CSR so the next run can mmap it
+and start the first BFS almost immediately.
+
+File layout (all sections start on a 4 KiB boundary):
+
+  SnapshotHeader    magic, version, NodeID size, flags, counts, offsets,
+                    generator parameters (SnapshotSource)
+  out offsets       int64_t[num_nodes + 1]
+  out neighbors     NodeID[num_out]
+  in offsets        int64_t[num_nodes + 1]      directed graphs only
+  in neighbors      NodeID[num_in]              directed graphs only
+
+Neighbor arrays are used in place from the mapping; only the per-vertex
+pointer index that CSRGraph wants (num_nodes + 1 pointers per direction) is
+built at load time. CSRGraph frees its arrays with delete[], which must
+never happen to mapped memory, so MappedGraph constructs the Graph in its
+own storage and never runs its destructor. It releases the mapping and the
+index arrays itself.
+
+Opening a snapshot checks the header against the file size: every section
+has to lie inside the file, and each offsets array has to start at 0, end
+at its edge count and never decrease. Neighbor ids are not checked, since
+that would fault in the whole file. The header also records what the graph
+was built from (-g/-u/-k or the -f path, and -s). GraphProvider rebuilds
+and overwrites the snapshot if the current command line asks for another
+graph, so a stale file is never reused under a new GraphClassName.
+
+Prefault modes: kPrefaultNone leaves page-in to the first BFS, kPrefaultPopulate
+maps with MAP_POPULATE (load is slower, first BFS is not), and
+kPrefaultBackground returns at once and touches the pages from a helper
+thread after madvise(MADV_WILLNEED).
+*/
+
+enum SnapshotPrefault {
+  kPrefaultNone,
+  kPrefaultPopulate,
+  kPrefaultBackground
+};
+
+inline bool ParseSnapshotPrefault(const std::string &name,
+                                  SnapshotPrefault &mode) {
+  if (name == "none") mode = kPrefaultNone;
+  else if (name == "populate") mode = kPrefaultPopulate;
+  else if (name == "background") mode = kPrefaultBackground;
+  else return false;
+  return true;
+}
+
+// Command-line options a snapshot was built from
+struct SnapshotSource {
+  static const uint32_t kUniform = 1;
+  static const uint32_t kSymmetrize = 2;
+
+  int32_t scale;        // -g or -u, -1 when read from a file
+  int32_t degree;       // -k, 0 when read from a file
+  uint32_t flags;
+  uint32_t reserved;
+  char input[240];      // -f path, truncated, NUL-terminated
+
+  static SnapshotSource FromCLI(const CLBase &cli) {
+    SnapshotSource s;
+    memset(&s, 0, sizeof(s));
+    bool from_file = cli.filename() != "";
+    s.scale = from_file ? -1 : cli.scale();
+    s.degree = from_file ? 0 : cli.degree();
+    s.flags = (!from_file && cli.uniform() ? kUniform : 0) |
+              (cli.symmetrize() ? kSymmetrize : 0);
+    strncpy(s.input, cli.filename().c_str(), sizeof(s.input) - 1);
+    return s;
+  }
+
+  bool Matches(const SnapshotSource &o) const {
+    return scale == o.scale && degree == o.degree && flags == o.flags &&
+           strncmp(input, o.input, sizeof(input)) == 0;
+  }
+
+  std::string Describe() const {
+    std::string d;
+    if (scale >= 0) {
+      d = std::string(flags & kUniform ? "-u " : "-g ") +
+          std::to_string(scale) + " -k " + std::to_string(degree);
+    } else {
+      d = std::string("-f ") + std::string(input, strnlen(input, sizeof(input)));
+    }
+    return d + (flags & kSymmetrize ? " -s" : "");
+  }
+};
+
+struct SnapshotHeader {
+  static const uint32_t kVersion = 2;
+  static const uint32_t kDirected = 1;
+
+  char magic[8];
+  uint32_t version;
+  uint32_t node_bytes;
+  uint32_t flags;
+  uint32_t reserved;
+  int64_t num_nodes;
+  int64_t num_out;
+  int64_t num_in;
+  uint64_t out_offsets_pos;
+  uint64_t out_neigh_pos;
+  uint64_t in_offsets_pos;
+  uint64_t in_neigh_pos;
+  uint64_t file_size;
+  SnapshotSource source;
+
+  static const char* Magic() { return "GAPSNAP"; }
+};
+
+static const uint64_t kSnapshotAlign = 4096;
+
+inline uint64_t SnapshotAlignUp(uint64_t pos) {
+  return (pos + kSnapshotAlign - 1) & ~(kSnapshotAlign - 1);
+}
+
+namespace snapshot_detail {
+
+// count elements of elem bytes starting at pos end inside file_size
+inline bool SectionFits(uint64_t pos, int64_t count, size_t elem,
+                        uint64_t file_size) {
+  if (count < 0 || pos < sizeof(SnapshotHeader) || pos > file_size)
+    return false;
+  return static_cast<uint64_t>(count) <= (file_size - pos) / elem;
+}
+
+inline bool WriteAt(FILE *f, uint64_t pos, const void *data, size_t bytes) {
+  if (fseeko(f, pos, SEEK_SET) != 0) return false;
+  return bytes == 0 || fwrite(data, 1, bytes, f) == bytes;
+}
+
+inline bool WriteDirection(FILE *f, const Graph &g, bool in_graph,
+                           const pvector<SGOffset> &offsets,
+                           uint64_t offsets_pos, uint64_t neigh_pos) {
+  if (!WriteAt(f, offsets_pos, offsets.begin(),
+               offsets.size() * sizeof(int64_t)))
+    return false;
+  const NodeID *neighs = in_graph ? g.in_neigh(0).begin()
+                                  : g.out_neigh(0).begin();
+  return WriteAt(f, neigh_pos, neighs,
+                 offsets[g.num_nodes()] * sizeof(NodeID));
+}
+
+}  // namespace snapshot_detail
+
+// Header sanity against the real file size; on failure err says why
+inline bool CheckSnapshotHeader(const SnapshotHeader &h, uint64_t file_size,
+                                std::string &err) {
+  using snapshot_detail::SectionFits;
+  if (strncmp(h.magic, SnapshotHeader::Magic(), sizeof(h.magic)) != 0) {
+    err = "not a graph snapshot";
+    return false;
+  }
+  if (h.version != SnapshotHeader::kVersion) {
+    err = "snapshot version " + std::to_string(h.version) +
+          ", expected " + std::to_string(SnapshotHeader::kVersion);
+    return false;
+  }
+  if (h.node_bytes != sizeof(NodeID)) {
+    err = "snapshot NodeID size does not match this build";
+    return false;
+  }
+  if (h.file_size != file_size) {
+    err = "snapshot is truncated";
+    return false;
+  }
+  bool directed = h.flags & SnapshotHeader::kDirected;
+  if (h.num_nodes < 0 || h.num_nodes > std::numeric_limits<NodeID>::max() ||
+      !SectionFits(h.out_offsets_pos, h.num_nodes + 1, sizeof(int64_t),
+                   file_size) ||
+      !SectionFits(h.out_neigh_pos, h.num_out, sizeof(NodeID), file_size) ||
+      (directed &&
+       (!SectionFits(h.in_offsets_pos, h.num_nodes + 1, sizeof(int64_t),
+                     file_size) ||
+        !SectionFits(h.in_neigh_pos, h.num_in, sizeof(NodeID), file_size)))) {
+    err = "snapshot sections do not fit in the file";
+    return false;
+  }
+  return true;
+}
+
+// offsets[0] == 0, offsets[n] == num_edges and never decreasing, so every
+// neighbor range stays inside its section
+inline bool CheckSnapshotOffsets(const int64_t *offsets, int64_t n,
+                                 int64_t num_edges) {
+  if (offsets[0] != 0 || offsets[n] != num_edges)
+    return false;
+  int64_t bad = 0;
+  #pragma omp parallel for reduction(+ : bad)
+  for (int64_t v = 0; v < n; v++)
+    bad += offsets[v + 1] < offsets[v];
+  return bad == 0;
+}
+
+// Writes g to path; returns false (and leaves no partial file) on error
+inline bool WriteGraphSnapshot(const Graph &g, const std::string &path,
+                               const SnapshotSource &source) {
+  static_assert(sizeof(SGOffset) == sizeof(int64_t), "offset size");
+  SnapshotHeader h;
+  memset(&h, 0, sizeof(h));
+  strncpy(h.magic, SnapshotHeader::Magic(), sizeof(h.magic));
+  h.version = SnapshotHeader::kVersion;
+  h.node_bytes = sizeof(NodeID);
+  h.flags = g.directed() ? SnapshotHeader::kDirected : 0;
+  h.num_nodes = g.num_nodes();
+  pvector<SGOffset> out_offsets = g.VertexOffsets(false);
+  h.num_out = out_offsets[g.num_nodes()];
+  h.num_in = g.directed() ? g.num_edges() : 0;
+  uint64_t pos = SnapshotAlignUp(sizeof(h));
+  h.out_offsets_pos = pos;
+  pos = SnapshotAlignUp(pos + (h.num_nodes + 1) * sizeof(int64_t));
+  h.out_neigh_pos = pos;
+  pos = SnapshotAlignUp(pos + h.num_out * sizeof(NodeID));
+  if (g.directed()) {
+    h.in_offsets_pos = pos;
+    pos = SnapshotAlignUp(pos + (h.num_nodes + 1) * sizeof(int64_t));
+    h.in_neigh_pos = pos;
+    pos = SnapshotAlignUp(pos + h.num_in * sizeof(NodeID));
+  }
+  h.file_size = pos;
+  h.source = source;
+
+  std::string tmp = path + ".tmp";
+  FILE *f = fopen(tmp.c_str(), "wb");
+  if (f == nullptr) return false;
+  bool ok = snapshot_detail::WriteAt(f, 0, &h, sizeof(h)) &&
+            snapshot_detail::WriteDirection(f, g, false, out_offsets,
+                                            h.out_offsets_pos, h.out_neigh_pos);
+  if (ok && g.directed()) {
+    pvector<SGOffset> in_offsets = g.VertexOffsets(true);
+    ok = snapshot_detail::WriteDirection(f, g, true, in_offsets,
+                                         h.in_offsets_pos, h.in_neigh_pos);
+  }
+  ok = ok && ftruncate(fileno(f), h.file_size) == 0;
+  ok = (fclose(f) == 0) && ok;
+  if (ok) ok = rename(tmp.c_str(), path.c_str()) == 0;
+  if (!ok) remove(tmp.c_str());
+  return ok;
+}
+
+class MappedGraph {
+ public:
+  MappedGraph() : base_(nullptr), size_(0), out_index_(nullptr),
+                  in_index_(nullptr), header_(nullptr), graph_(nullptr) {}
+
+  ~MappedGraph() { Close(); }
+
+  MappedGraph(const MappedGraph &) = delete;
+  MappedGraph &operator=(const MappedGraph &) = delete;
+
+  // Maps path and wraps it as a Graph. On failure err says why. With expect
+  // set, a snapshot built from other options is refused.
+  bool Open(const std::string &path, SnapshotPrefault prefault,
+            std::string &err, const SnapshotSource *expect = nullptr) {
+    Close();
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      err = "cannot open " + path;
+      return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(SnapshotHeader)) {
+      close(fd);
+      err = path + " is too small to be a snapshot";
+      return false;
+    }
+    int flags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+    if (prefault == kPrefaultPopulate) flags |= MAP_POPULATE;
+#endif
+    void *base = mmap(nullptr, st.st_size, PROT_READ, flags, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+      err = "mmap failed for " + path;
+      return false;
+    }
+    base_ = static_cast<char*>(base);
+    size_ = st.st_size;
+    header_ = reinterpret_cast<const SnapshotHeader*>(base_);
+    if (!CheckSnapshotHeader(*header_, size_, err) ||
+        !CheckSections(err)) {
+      Close();
+      return false;
+    }
+    if (expect != nullptr && !header_->source.Matches(*expect)) {
+      err = "built from " + header_->source.Describe() + ", not " +
+            expect->Describe();
+      Close();
+      return false;
+    }
+
+    NodeID *out_neighs = Section<NodeID>(header_->out_neigh_pos);
+    out_index_ = BuildIndex(Section<int64_t>(header_->out_offsets_pos),
+                            out_neighs);
+    if (header_->flags & SnapshotHeader::kDirected) {
+      NodeID *in_neighs = Section<NodeID>(header_->in_neigh_pos);
+      in_index_ = BuildIndex(Section<int64_t>(header_->in_offsets_pos),
+                             in_neighs);
+      graph_ = new (storage_) Graph(header_->num_nodes, out_index_,
+                                    out_neighs, in_index_, in_neighs);
+    } else {
+      graph_ = new (storage_) Graph(header_->num_nodes, out_index_,
+                                    out_neighs);
+    }
+    if (prefault == kPrefaultBackground) {
+      madvise(base_, size_, MADV_WILLNEED);
+      prefault_thread_ = std::thread(TouchPages, base_, size_);
+    }
+    return true;
+  }
+
+  bool is_open() const { return graph_ != nullptr; }
+  const Graph& graph() const { return *graph_; }
+  size_t mapped_bytes() const { return size_; }
+
+ private:
+  void Close() {
+    if (prefault_thread_.joinable()) prefault_thread_.join();
+    graph_ = nullptr;                 // storage_ intentionally not destroyed
+    delete[] out_index_;
+    delete[] in_index_;
+    out_index_ = in_index_ = nullptr;
+    if (base_ != nullptr) munmap(base_, size_);
+    base_ = nullptr;
+    size_ = 0;
+    header_ = nullptr;
+  }
+
+  bool CheckSections(std::string &err) const {
+    const SnapshotHeader &h = *header_;
+    bool ok = CheckSnapshotOffsets(Section<int64_t>(h.out_offsets_pos),
+                                   h.num_nodes, h.num_out);
+    if (ok && (h.flags & SnapshotHeader::kDirected)) {
+      ok = CheckSnapshotOffsets(Section<int64_t>(h.in_offsets_pos),
+                                h.num_nodes, h.num_in);
+    }
+    if (!ok)
+      err = "snapshot offsets are corrupt";
+    return ok;
+  }
+
+  template <typename T>
+  T* Section(uint64_t pos) const {
+    return reinterpret_cast<T*>(base_ + pos);
+  }
+
+  NodeID** BuildIndex(const int64_t *offsets, NodeID *neighs) const {
+    const int64_t n = header_->num_nodes;
+    NodeID **index = new NodeID*[n + 1];
+    #pragma omp parallel for
+    for (int64_t v = 0; v <= n; v++)
+      index[v] = neighs + offsets[v];
+    return index;
+  }
+
+  static void TouchPages(const char *base, size_t size) {
+    volatile char sink = 0;
+    for (size_t pos = 0; pos < size; pos += kSnapshotAlign)
+      sink = sink + base[pos];
+  }
+
+  char *base_;
+  size_t size_;
+  NodeID **out_index_;
+  NodeID **in_index_;
+  const SnapshotHeader *header_;
+  Graph *graph_;
+  std::thread prefault_thread_;
+  alignas(Graph) unsigned char storage_[sizeof(Graph)];
+};
+
+// Gives a driver its Graph: mapped from a snapshot when one exists at path,
+// otherwise built from the command line (and saved to path for next time)
+class GraphProvider {
+ public:
+  const Graph& Get(const CLBase &cli, const std::string &snapshot_path,
+                   SnapshotPrefault prefault) {
+    Timer t;
+    t.Start();
+    SnapshotSource source = SnapshotSource::FromCLI(cli);
+    if (snapshot_path != "") {
+      std::string err;
+      if (mapped_.Open(snapshot_path, prefault, err, &source)) {
+        t.Stop();
+        PrintTime("Snapshot Map Time", t.Seconds());
+        return mapped_.graph();
+      }
+      std::cout << "Snapshot: " << err << ", building graph" << std::endl;
+    }
+    Builder b(cli);
+    built_ = b.MakeGraph();
+    t.Stop();
+    PrintTime("Graph Build Time", t.Seconds());
+    if (snapshot_path != "") {
+      Timer tw;
+      tw.Start();
+      bool ok = WriteGraphSnapshot(built_, snapshot_path, source);
+      tw.Stop();
+      if (ok) PrintTime("Snapshot Write Time", tw.Seconds());
+      else std::cout << "Could not write snapshot " << snapshot_path << std::endl;
+    }
+    return built_;
+  }
+
+ private:
+  MappedGraph mapped_;
+  Graph built_;
+};
+
+#endif  // GRAPH_SNAPSHOT_H_
@@ -0,0 +1,198 @@
+#ifndef MACHINE_PROFILE_H_
+#define MACHINE_PROFILE_H_
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <ostream>
+#include <sstream>
+#include <string>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/*
+Measured machine ceilings for roofline reports
+
+The profile is written by Characterize (top-level Characterize.cpp) and
+read by the matmul driver (Main.cpp) and the BFS drivers, which print how
+far a run is from the ceiling that bounds it. It replaces the hand-derived
+peak FLOPS and per-level bandwidth in the README with sustained numbers.
+
+Every ceiling is kept twice, for one core and for all cores:
+
+  peak_gflops    sustained FMA throughput (2 flops per lane per FMA)
+  read / write / copy GB/s per level (L1, L2, L3, DRAM), taken from a
+                 working-set sweep; copy counts source and destination
+
+The file is plain "key value" lines, e.g. "read.dram.all 41.7", so it can
+be edited or diffed by hand. Unknown keys are ignored and missing ones stay
+0, which the report helpers treat as "no ceiling". The path is taken from
+$MACHINE_PROFILE, falling back to machine.profile in the working directory.
+*/
+
+class MachineProfile {
+ public:
+  enum Level { kL1, kL2, kL3, kDRAM, kNumLevels };
+  enum Scope { kOneCore, kAllCores, kNumScopes };
+  enum Pattern { kRead, kWrite, kCopy, kNumPatterns };
+
+  MachineProfile() : loaded_(false), threads_(0) {
+    std::fill(gflops_, gflops_ + kNumScopes, 0.0);
+    std::fill(&gbs_[0][0][0],
+              &gbs_[0][0][0] + kNumPatterns * kNumLevels * kNumScopes, 0.0);
+  }
+
+  static std::string DefaultPath() {
+    const char *env = std::getenv("MACHINE_PROFILE");
+    return (env != nullptr && env[0] != '\0') ? env : "machine.profile";
+  }
+
+  static const char* LevelName(int level) {
+    static const char *names[] = {"l1", "l2", "l3", "dram"};
+    return names[level];
+  }
+
+  static const char* ScopeName(int scope) {
+    return scope == kOneCore ? "1" : "all";
+  }
+
+  static const char* PatternName(int pattern) {
+    static const char *names[] = {"read", "write", "copy"};
+    return names[pattern];
+  }
+
+  // Profile scope that matches a run with the given thread count
+  static Scope ScopeFor(int threads) {
+    return threads > 1 ? kAllCores : kOneCore;
+  }
+
+  bool Load(const std::string &path) {
+    std::ifstream in(path.c_str());
+    if (!in)
+      return false;
+    std::string line;
+    while (std::getline(in, line)) {
+      std::istringstream fields(line);
+      std::string key;
+      double value;
+      if (!(fields >> key >> value) || key[0] == '#')
+        continue;
+      if (key == "threads") {
+        threads_ = static_cast<int>(value);
+        continue;
+      }
+      for (int s = 0; s < kNumScopes; s++) {
+        if (key == std::string("peak_gflops.") + ScopeName(s))
+          gflops_[s] = value;
+        for (int p = 0; p < kNumPatterns; p++) {
+          for (int l = 0; l < kNumLevels; l++) {
+            if (key == Key(p, l, s))
+              gbs_[p][l][s] = value;
+          }
+        }
+      }
+    }
+    loaded_ = true;
+    return true;
+  }
+
+  bool Save(const std::string &path) const {
+    std::ofstream out(path.c_str(), std::ios::trunc);
+    out << "# machine profile written by Characterize" << "\n";
+    out << std::fixed << std::setprecision(2);
+    out << "threads " << threads_ << "\n";
+    for (int s = 0; s < kNumScopes; s++)
+      out << "peak_gflops." << ScopeName(s) << " " << gflops_[s] << "\n";
+    for (int p = 0; p < kNumPatterns; p++) {
+      for (int l = 0; l < kNumLevels; l++) {
+        for (int s = 0; s < kNumScopes; s++)
+          out << Key(p, l, s) << " " << gbs_[p][l][s] << "\n";
+      }
+    }
+    return static_cast<bool>(out);
+  }
+
+  bool loaded() const { return loaded_; }
+  int threads() const { return threads_; }
+  void set_threads(int threads) { threads_ = threads; }
+
+  double peak_gflops(Scope s) const { return gflops_[s]; }
+  void set_peak_gflops(Scope s, double v) { gflops_[s] = v; }
+
+  double bandwidth_gbs(Pattern p, Level l, Scope s) const {
+    return gbs_[p][l][s];
+  }
+  void set_bandwidth_gbs(Pattern p, Level l, Scope s, double v) {
+    gbs_[p][l][s] = v;
+  }
+
+ private:
+  static std::string Key(int p, int l, int s) {
+    return std::string(PatternName(p)) + "." + LevelName(l) + "." +
+           ScopeName(s);
+  }
+
+  bool loaded_;
+  int threads_;
+  double gflops_[kNumScopes];
+  double gbs_[kNumPatterns][kNumLevels][kNumScopes];
+};
+
+// Threads a parallel region will use, to pick the profile scope
+inline int ProfileThreads() {
+#ifdef _OPENMP
+  return omp_get_max_threads();
+#else
+  return 1;
+#endif
+}
+
+// Compute roof for a dense kernel: achieved GFLOPS and its share of peak
+inline void PrintComputeRoofline(std::ostream &out,
+                                 const MachineProfile &profile,
+                                 double flops, double seconds, int threads) {
+  if (seconds <= 0)
+    return;
+  double gflops = flops / seconds / 1e9;
+  const std::ios::fmtflags flags = out.flags();
+  const std::streamsize precision = out.precision();
+  out << "GFLOPS: " << std::fixed << std::setprecision(3) << gflops;
+  MachineProfile::Scope s = MachineProfile::ScopeFor(threads);
+  double peak = profile.peak_gflops(s);
+  if (peak > 0) {
+    out << " (" << std::setprecision(1) << 100.0 * gflops / peak
+        << "% of " << std::setprecision(2) << peak << " peak, "
+        << (s == MachineProfile::kOneCore ? "1 core" : "all cores") << ")";
+  }
+  out << std::endl;
+  out.flags(flags);
+  out.precision(precision);
+}
+
+// Memory roof for a traversal: with Ie edges per byte moved from DRAM, the
+// ceiling is Ie * DRAM read bandwidth edges per second
+inline void PrintTraversalRoofline(std::ostream &out,
+                                   const MachineProfile &profile,
+                                   double edges_per_byte, double teps,
+                                   int threads) {
+  MachineProfile::Scope s = MachineProfile::ScopeFor(threads);
+  double gbs = profile.bandwidth_gbs(MachineProfile::kRead,
+                                     MachineProfile::kDRAM, s);
+  if (gbs <= 0 || edges_per_byte <= 0)
+    return;
+  double ceiling = edges_per_byte * gbs * 1e9;
+  const std::ios::fmtflags flags = out.flags();
+  const std::streamsize precision = out.precision();
+  out << "Roofline TEPS (DRAM " << std::fixed << std::setprecision(2) << gbs
+      << " GB/s, " << (s == MachineProfile::kOneCore ? "1 core" : "all cores")
+      << "): " << std::setprecision(3) << ceiling << " ("
+      << std::setprecision(1) << 100.0 * teps / ceiling << "% attained)"
+      << std::endl;
+  out.flags(flags);
+  out.precision(precision);
+}
+
+#endif  // MACHINE_PROFILE_H_
@@ -0,0 +1,215 @@
+#include <iostream>
+#include <vector>
+#include <iomanip>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+
+#include "benchmark.h"
+#include "bfs_verify.h"
+#include "builder.h"
+#include "command_line.h"
+#include "graph.h"
+#include "graph_snapshot.h"
+#include "pvector.h"
+#include "timer.h"
+#include "msbfs.h"
+
+/*
+Batched multi-source BFS driver
+
+Each trial picks a batch of sources from SourcePicker and runs them together
+with MultiSourceBFS (msbfs.h). With -v, --verify-sources of them (spread
+over the batch) record a depth array, get a parent array rebuilt from it and
+are checked by the same BFSVerifier as the single-source drivers. Depths are
+4 bytes per vertex per checked source, so a full 256-source batch is only
+checked when asked for and the graph is small enough.
+
+Extra flags (stripped before CLApp sees them):
+  --width=64|256   source-set width (1 or 4 words per vertex)
+  --batch=K        sources per trial, default = width
+  --verify-sources=K  sources per batch checked by -v, default 4
+                      (0 = all)
+  --snapshot=F     mmap graph snapshot F (built and written if missing)
+  --snapshot-prefault=none|populate|background
+  --verify=serial|parallel|sampled, --verify-samples=K  -v checker
+                      (bfs_verify.h, default parallel)
+
+Reported TEPS is the batch aggregate: for every source, the out-degrees of
+the vertices it reached (what a separate DOBFS would count) summed over the
+batch and divided by batch time. Edges actually examined are printed next to
+it to show how much adjacency traffic the batch shared.
+*/
+
+using namespace std;
+
+static const int32_t kUnreached = -1;
+
+static int g_width = 64;
+static int g_batch = -1;
+static int g_verify_sources = 4;
+
+// Graph snapshot (graph_snapshot.h): mmap if present, else build and save
+static string g_snapshot = "";
+static SnapshotPrefault g_prefault = kPrefaultNone;
+
+static int64_t g_equiv_edges = 0;     // per-source edge counts, summed
+static int64_t g_examined_edges = 0;  // adjacency entries actually read
+static int64_t g_num_sources = 0;
+static double  g_bfs_time_sec = 0.0;
+
+static void StripCustomArgs(int& argc, char** argv) {
+  int out = 1;
+  for (int i = 1; i < argc; ++i) {
+    string a = argv[i];
+    if (a.compare(0, 8, "--width=") == 0) g_width = atoi(a.c_str() + 8);
+    else if (a.compare(0, 8, "--batch=") == 0) g_batch = atoi(a.c_str() + 8);
+    else if (a.compare(0, 17, "--verify-sources=") == 0)
+      g_verify_sources = atoi(a.c_str() + 17);
+    else if (a.compare(0, 11, "--snapshot=") == 0) g_snapshot = a.substr(11);
+    else if (a.compare(0, 20, "--snapshot-prefault=") == 0) {
+      if (!ParseSnapshotPrefault(a.substr(20), g_prefault))
+        cout << "Unknown prefault mode " << a.substr(20) << endl;
+    }
+    else if (ParseVerifyArg(a, g_verify)) continue;
+    else argv[out++] = argv[i];
+  }
+  argc = out;
+}
+
+struct MSBFSResult {
+  vector<NodeID> sources;
+  vector<int> checked;                // batch indices with a depth array
+  vector<pvector<int32_t>> depths;    // one per checked source
+};
+
+template <int kWords>
+MSBFSResult RunBatch(const Graph &g, const vector<NodeID> &sources,
+                     bool keep_depths, bool logging_enabled) {
+  MSBFSResult result;
+  result.sources = sources;
+  // slot[s] indexes depths for checked batch entries, -1 otherwise
+  vector<int> slot(sources.size(), -1);
+  if (keep_depths) {
+    int k = static_cast<int>(sources.size());
+    if (g_verify_sources > 0 && g_verify_sources < k)
+      k = g_verify_sources;
+    for (int i = 0; i < k; i++) {
+      int s = static_cast<int>(int64_t(i) * sources.size() / k);
+      slot[s] = i;
+      result.checked.push_back(s);
+      result.depths.emplace_back(g.num_nodes(), kUnreached);
+    }
+  }
+  int64_t equiv_edges = 0;
+  auto visit = [&](NodeID v, const SourceSet<kWords> &fresh, int depth) {
+    equiv_edges += static_cast<int64_t>(fresh.count()) * g.out_degree(v);
+    if (keep_depths) {
+      ForEachSource(fresh, [&](int s) {
+        if (slot[s] >= 0)
+          result.depths[slot[s]][v] = depth;
+      });
+    }
+  };
+  Timer t;
+  t.Start();
+  int64_t examined = MultiSourceBFS<kWords>(g, sources, visit, logging_enabled);
+  t.Stop();
+  g_equiv_edges += equiv_edges;
+  g_examined_edges += examined;
+  g_num_sources += sources.size();
+  g_bfs_time_sec += t.Seconds();
+  return result;
+}
+
+// Any in-neighbor one level closer is a valid BFS parent
+pvector<NodeID> ParentsFromDepths(const Graph &g, NodeID source,
+                                  const pvector<int32_t> &depth) {
+  pvector<NodeID> parent(g.num_nodes(), -1);
+  #pragma omp parallel for
+  for (NodeID v = 0; v < g.num_nodes(); v++) {
+    if (depth[v] == kUnreached)
+      continue;
+    if (v == source) {
+      parent[v] = v;
+      continue;
+    }
+    for (NodeID u : g.in_neigh(v)) {
+      if (depth[u] + 1 == depth[v]) {
+        parent[v] = u;
+        break;
+      }
+    }
+  }
+  return parent;
+}
+
+void PrintMSBFSStats(const Graph &g, const MSBFSResult &result) {
+  cout << "Batch of " << result.sources.size() << " sources" << endl;
+  for (size_t i = 0; i < result.depths.size(); i++) {
+    int64_t reached = 0;
+    for (NodeID n : g.vertices())
+      if (result.depths[i][n] != kUnreached) reached++;
+    cout << "  source " << result.sources[result.checked[i]] << " reached "
+         << reached << " nodes" << endl;
+  }
+}
+
+// BFS verifier (bfs_verify.h), as in the single-source drivers
+bool BFSVerifier(const Graph &g, NodeID source,
+                 const pvector<NodeID> &parent) {
+  return VerifyBFSTree(g, source, parent, g_verify);
+}
+
+bool MSBFSVerifier(const Graph &g, const MSBFSResult &result) {
+  for (size_t i = 0; i < result.depths.size(); i++) {
+    int s = result.checked[i];
+    NodeID source = result.sources[s];
+    pvector<NodeID> parent = ParentsFromDepths(g, source, result.depths[i]);
+    if (!BFSVerifier(g, source, parent)) {
+      cout << "Batch source " << s << " (" << source << ") failed" << endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+int main(int argc, char* argv[]) {
+  StripCustomArgs(argc, argv);
+  if (g_width != 64 && g_width != 256) {
+    cout << "--width must be 64 or 256" << endl;
+    return -1;
+  }
+  if (g_batch <= 0 || g_batch > g_width)
+    g_batch = g_width;
+
+  CLApp cli(argc, argv, "multi-source breadth-first search");
+  if (!cli.ParseArgs()) return -1;
+
+  GraphProvider provider;
+  const Graph &g = provider.Get(cli, g_snapshot, g_prefault);
+  SourcePicker<Graph> sp(g, cli.start_vertex());
+  auto MSBFSBound = [&sp, &cli] (const Graph &g) {
+    vector<NodeID> sources;
+    for (int i = 0; i < g_batch; i++)
+      sources.push_back(sp.PickNext());
+    if (g_width == 256)
+      return RunBatch<4>(g, sources, cli.do_verify(), cli.logging_en());
+    return RunBatch<1>(g, sources, cli.do_verify(), cli.logging_en());
+  };
+  BenchmarkKernel(cli, g, MSBFSBound, PrintMSBFSStats, MSBFSVerifier);
+
+  const double teps = (g_bfs_time_sec > 0.0)
+                        ? (double)g_equiv_edges / g_bfs_time_sec : 0.0;
+  const double sharing = (g_examined_edges > 0)
+                        ? (double)g_equiv_edges / g_examined_edges : 0.0;
+
+  cout << "Sources: " << g_num_sources << " (width " << g_width
+       << ", batch " << g_batch << ")" << endl;
+  cout << "Traversed edges (per-source sum): " << g_equiv_edges << endl;
+  cout << "Examined edges (shared): " << g_examined_edges << endl;
+  cout << "Sharing factor: " << fixed << setprecision(2) << sharing << endl;
+  cout << "BFS Time (s): " << setprecision(6) << g_bfs_time_sec << endl;
+  cout << "Aggregate TEPS: " << setprecision(3) << teps << endl;
+  return 0;
+}
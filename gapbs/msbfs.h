@@ -0,0 +1,206 @@
+#ifndef MSBFS_H_
+#define MSBFS_H_
+
+#include <algorithm>
+#include <cinttypes>
+#include <vector>
+
+#include "benchmark.h"
+#include "graph.h"
+#include "pvector.h"
+
+/*
+Multi-source bit-parallel BFS (MS-BFS, Then et al. VLDB'14)
+
+Runs up to 64 * kWords sources in one level-synchronous traversal. Every
+vertex carries three source sets (seen, frontier, next) with one bit per
+source, so one pass over an adjacency list advances every source in the
+batch that has that vertex on its frontier. kWords = 1 gives 64 sources in a
+plain uint64_t; kWords = 4 gives 256 sources and the per-word loops below are
+simple enough for the compiler to turn into AVX2 ops.
+
+Like DOBFS each level is either a push over the frontier (out_neigh) or a
+pull over unfinished vertices (in_neigh, with an early exit once every
+missing source bit has been found), chosen by the same alpha test on
+frontier edges.
+
+Callers get newly discovered (vertex, source set, depth) triples through a
+visitor, so depth arrays, parent reconstruction or plain counting are all
+decided at the call site and cost nothing when unused.
+
+Long-running callers (bfs_server.cc) pass an MSBFSWorkspace so the three
+per-vertex set arrays are allocated once, and can stop the traversal after
+max_depth levels.
+*/
+
+template <int kWords>
+struct SourceSet {
+  static const int kWidth = 64 * kWords;
+  uint64_t w[kWords];
+
+  void clear() {
+    for (int i = 0; i < kWords; i++) w[i] = 0;
+  }
+  bool any() const {
+    uint64_t acc = 0;
+    for (int i = 0; i < kWords; i++) acc |= w[i];
+    return acc != 0;
+  }
+  int count() const {
+    int c = 0;
+    for (int i = 0; i < kWords; i++) c += __builtin_popcountll(w[i]);
+    return c;
+  }
+  void set(int b) { w[b / 64] |= uint64_t(1) << (b % 64); }
+  bool get(int b) const { return (w[b / 64] >> (b % 64)) & 1; }
+  bool covers(const SourceSet &o) const {
+    for (int i = 0; i < kWords; i++)
+      if ((w[i] & o.w[i]) != o.w[i]) return false;
+    return true;
+  }
+};
+
+// Calls f(source_index) for every set bit, lowest first.
+template <int kWords, typename F>
+inline void ForEachSource(const SourceSet<kWords> &s, F f) {
+  for (int i = 0; i < kWords; i++) {
+    uint64_t bits = s.w[i];
+    while (bits != 0) {
+      f(i * 64 + __builtin_ctzll(bits));
+      bits &= bits - 1;
+    }
+  }
+}
+
+template <int kWords>
+inline void OrInto(SourceSet<kWords> &dst, const SourceSet<kWords> &src) {
+  for (int i = 0; i < kWords; i++) {
+#ifdef _OPENMP
+    if ((dst.w[i] & src.w[i]) != src.w[i])
+      __sync_fetch_and_or(&dst.w[i], src.w[i]);
+#else
+    dst.w[i] |= src.w[i];
+#endif
+  }
+}
+
+// Per-vertex source sets, kept between calls by long-running callers
+template <int kWords>
+struct MSBFSWorkspace {
+  pvector<SourceSet<kWords>> seen, frontier, next;
+
+  void Prepare(int64_t n) {
+    if ((int64_t) seen.size() == n)
+      return;
+    seen = pvector<SourceSet<kWords>>(n);
+    frontier = pvector<SourceSet<kWords>>(n);
+    next = pvector<SourceSet<kWords>>(n);
+  }
+};
+
+// visit(v, newly_reached, depth) is called once per vertex per level with
+// the set of sources that reached v for the first time at that depth
+// (including each source itself at depth 0). max_depth < 0 means no limit.
+// Returns edges examined.
+template <int kWords, typename VisitFunc>
+int64_t MultiSourceBFS(const Graph &g, const std::vector<NodeID> &sources,
+                       VisitFunc visit, MSBFSWorkspace<kWords> &ws,
+                       bool logging_enabled = false, int alpha = 15,
+                       int max_depth = -1) {
+  typedef SourceSet<kWords> Set;
+  const int64_t n = g.num_nodes();
+  ws.Prepare(n);
+  pvector<Set> &seen = ws.seen, &frontier = ws.frontier, &next = ws.next;
+  Set all;
+  all.clear();
+  #pragma omp parallel for
+  for (NodeID v = 0; v < n; v++) {
+    seen[v].clear();
+    frontier[v].clear();
+    next[v].clear();
+  }
+  for (size_t i = 0; i < sources.size() && i < (size_t) Set::kWidth; i++) {
+    all.set(i);
+    seen[sources[i]].set(i);
+    frontier[sources[i]].set(i);
+  }
+  int64_t frontier_edges = 0;
+  for (NodeID v = 0; v < n; v++) {
+    if (frontier[v].any()) {
+      visit(v, frontier[v], 0);
+      frontier_edges += g.out_degree(v);
+    }
+  }
+
+  int64_t edges_examined = 0;
+  Timer t;
+  for (int depth = 1; frontier_edges != 0; depth++) {
+    if (max_depth >= 0 && depth > max_depth)
+      break;
+    t.Start();
+    bool pull = frontier_edges > g.num_edges_directed() / alpha;
+    if (pull) {
+      #pragma omp parallel for reduction(+ : edges_examined) schedule(dynamic, 1024)
+      for (NodeID v = 0; v < n; v++) {
+        Set missing;
+        for (int i = 0; i < kWords; i++)
+          missing.w[i] = all.w[i] & ~seen[v].w[i];
+        if (!missing.any())
+          continue;
+        Set acc;
+        acc.clear();
+        for (NodeID u : g.in_neigh(v)) {
+          edges_examined++;
+          for (int i = 0; i < kWords; i++)
+            acc.w[i] |= frontier[u].w[i];
+          if (acc.covers(missing))
+            break;
+        }
+        for (int i = 0; i < kWords; i++)
+          next[v].w[i] = acc.w[i] & missing.w[i];
+      }
+    } else {
+      #pragma omp parallel for reduction(+ : edges_examined) schedule(dynamic, 1024)
+      for (NodeID u = 0; u < n; u++) {
+        if (!frontier[u].any())
+          continue;
+        for (NodeID v : g.out_neigh(u)) {
+          edges_examined++;
+          OrInto(next[v], frontier[u]);
+        }
+      }
+    }
+
+    // Keep only first discoveries, publish them and make them the frontier
+    frontier_edges = 0;
+    int64_t awake = 0;
+    for (NodeID v = 0; v < n; v++) {
+      Set fresh;
+      for (int i = 0; i < kWords; i++) {
+        fresh.w[i] = next[v].w[i] & ~seen[v].w[i];
+        seen[v].w[i] |= fresh.w[i];
+      }
+      next[v].clear();
+      frontier[v] = fresh;
+      if (fresh.any()) {
+        visit(v, fresh, depth);
+        frontier_edges += g.out_degree(v);
+        awake++;
+      }
+    }
+    t.Stop();
+    if (logging_enabled)
+      PrintStep(pull ? "bu" : "td", t.Seconds(), awake);
+  }
+  return edges_examined;
+}
+
+template <int kWords, typename VisitFunc>
+int64_t MultiSourceBFS(const Graph &g, const std::vector<NodeID> &sources,
+                       VisitFunc visit, bool logging_enabled = false,
+                       int alpha = 15) {
+  MSBFSWorkspace<kWords> ws;
+  return MultiSourceBFS<kWords>(g, sources, visit, ws, logging_enabled, alpha);
+}
+
+#endif  // MSBFS_H_
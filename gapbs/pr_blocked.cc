@@ -0,0 +1,498 @@
+#include <iostream>
+#include <vector>
+#include <iomanip>
+#include <memory>
+#include <algorithm>
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <utility>
+
+#include "benchmark.h"
+#include "builder.h"
+#include "command_line.h"
+#include "graph.h"
+#include "graph_snapshot.h"
+#include "pvector.h"
+#include "timer.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/*
+Cache-blocked PageRank
+
+Gauss-Jacobi PageRank (damping 0.85, stop when the L1 change of an
+iteration drops below -t or after -i iterations) in three layouts. They
+differ only in how the per-edge contributions reach the per-vertex sums:
+
+  pull       bfs-style pull over in_neigh: one contrib[] read per edge,
+             anywhere in the array
+  segmented  CSR segmenting: the source range is cut into slices of
+             --slice-kb of contrib[], and each slice gets its own small CSR
+             of (destination, in-neighbors in the slice). A pass over one
+             segment only reads that slice of contrib[]
+  pb         deterministic propagation blocking: each source pushes its
+             contribution into the bin of each out-neighbor's destination
+             slice (sequential writes), then each bin is added into its
+             slice of sums[]. Bin layout and destination ids are fixed
+             once at setup, so iterations only stream values
+
+Segments and bins are built once per graph ("Preprocess Time") and reused
+by every trial. Threads own contiguous, edge-balanced source ranges in pb
+and dynamic chunks of destinations everywhere else, so no step needs
+atomics.
+
+The report follows bfs_improved: edges per iteration times iterations as
+"Traversed edges", TEPS, and an estimated byte count per layout. Random
+bytes are the share of those that hit per-vertex arrays outside one slice,
+which is the traffic the blocking exists to remove. The verifier runs one
+more serial push iteration from the result and checks that it moves the
+scores by less than -t.
+
+Extra flags (stripped before CLApp sees them):
+  --algo=pull|segmented|pb   layout (default pb)
+  --slice-kb=K               score slice per segment or bin (default 256)
+  --snapshot=F, --snapshot-prefault=none|populate|background
+*/
+
+using namespace std;
+
+typedef float ScoreT;
+static const float kDamp = 0.85;
+
+static string g_algo = "pb";
+static int64_t g_slice_bytes = 256 << 10;
+
+// Graph snapshot (graph_snapshot.h): mmap if present, else build and save
+static string g_snapshot = "";
+static SnapshotPrefault g_prefault = kPrefaultNone;
+
+static void StripCustomArgs(int& argc, char** argv) {
+  int out = 1;
+  for (int i = 1; i < argc; ++i) {
+    string a = argv[i];
+    if (a.compare(0, 7, "--algo=") == 0) g_algo = a.substr(7);
+    else if (a.compare(0, 11, "--slice-kb=") == 0)
+      g_slice_bytes = atol(a.c_str() + 11) << 10;
+    else if (a.compare(0, 11, "--snapshot=") == 0) g_snapshot = a.substr(11);
+    else if (a.compare(0, 20, "--snapshot-prefault=") == 0) {
+      if (!ParseSnapshotPrefault(a.substr(20), g_prefault))
+        cout << "Unknown prefault mode " << a.substr(20) << endl;
+    }
+    else argv[out++] = argv[i];
+  }
+  argc = out;
+}
+
+static int MaxThreads() {
+#ifdef _OPENMP
+  return omp_get_max_threads();
+#else
+  return 1;
+#endif
+}
+
+// Totals for the report, summed over trials
+struct PRStats {
+  int64_t edges = 0;
+  int64_t iters = 0;
+  double bytes = 0;
+  double random_bytes = 0;
+  double seconds = 0;
+};
+
+static PRStats g_pr;
+
+// Per-edge contributions for the next iteration; sinks contribute nothing
+static void ComputeContrib(const Graph &g, const pvector<ScoreT> &scores,
+                           pvector<ScoreT> &contrib) {
+  #pragma omp parallel for schedule(dynamic, 16384)
+  for (NodeID n = 0; n < g.num_nodes(); n++)
+    contrib[n] = g.out_degree(n) != 0 ? scores[n] / g.out_degree(n) : 0;
+}
+
+// scores = base + kDamp * sums, sums cleared; returns the L1 change
+static double ApplySums(const Graph &g, pvector<ScoreT> &scores,
+                        pvector<ScoreT> &sums) {
+  const ScoreT base_score = (1.0f - kDamp) / g.num_nodes();
+  double error = 0;
+  #pragma omp parallel for reduction(+ : error) schedule(dynamic, 16384)
+  for (NodeID n = 0; n < g.num_nodes(); n++) {
+    ScoreT old_score = scores[n];
+    scores[n] = base_score + kDamp * sums[n];
+    error += fabs(scores[n] - old_score);
+    sums[n] = 0;
+  }
+  return error;
+}
+
+// Layout-specific part of one iteration: sums[v] += contrib of in-edges
+class PRLayout {
+ public:
+  virtual ~PRLayout() {}
+  virtual void Gather(const pvector<ScoreT> &contrib,
+                      pvector<ScoreT> &sums) = 0;
+  // Estimated bytes per iteration, total and outside one slice
+  virtual double Bytes() const = 0;
+  virtual double RandomBytes() const = 0;
+};
+
+class PullLayout : public PRLayout {
+ public:
+  explicit PullLayout(const Graph &g) : g_(g) {}
+
+  void Gather(const pvector<ScoreT> &contrib, pvector<ScoreT> &sums) override {
+    #pragma omp parallel for schedule(dynamic, 16384)
+    for (NodeID u = 0; u < g_.num_nodes(); u++) {
+      ScoreT incoming_total = 0;
+      for (NodeID v : g_.in_neigh(u))
+        incoming_total += contrib[v];
+      sums[u] = incoming_total;
+    }
+  }
+
+  // Per edge: neighbor index + contrib read; per vertex: offsets + sums
+  double Bytes() const override {
+    return g_.num_edges_directed() * (sizeof(NodeID) + sizeof(ScoreT)) +
+           g_.num_nodes() * (sizeof(SGOffset) + sizeof(ScoreT));
+  }
+  double RandomBytes() const override {
+    return g_.num_edges_directed() * sizeof(ScoreT);
+  }
+
+ private:
+  const Graph &g_;
+};
+
+// CSR segmenting: one (dest, in-neighbors) CSR per source slice
+class SegmentedLayout : public PRLayout {
+ public:
+  SegmentedLayout(const Graph &g, int64_t slice_nodes) : g_(g) {
+    const int64_t num_segments =
+        (g.num_nodes() + slice_nodes - 1) / slice_nodes;
+    const int num_threads = MaxThreads();
+    // Edge-balanced destination ranges, one per thread
+    const int64_t m = g.num_edges_directed();
+    vector<NodeID> dst_begin(num_threads + 1, g.num_nodes());
+    dst_begin[0] = 0;
+    int t = 1;
+    int64_t seen = 0;
+    for (NodeID v = 0; v < g.num_nodes() && t < num_threads; v++) {
+      seen += g.in_degree(v);
+      while (t < num_threads && seen >= m * t / num_threads)
+        dst_begin[t++] = v + 1;
+    }
+
+    // One pass over each in_neigh counts, a second fills. Builder sorts
+    // neighborhoods, so each slice's sources are one run and one pair.
+    // Thread t writes its part of segment s from pairs[t][s] and srcs[t][s]
+    vector<vector<int64_t>> pairs(num_threads,
+                                  vector<int64_t>(num_segments, 0));
+    vector<vector<int64_t>> srcs(num_threads,
+                                 vector<int64_t>(num_segments, 0));
+    #pragma omp parallel for schedule(static, 1)
+    for (int t = 0; t < num_threads; t++) {
+      for (NodeID v = dst_begin[t]; v < dst_begin[t + 1]; v++) {
+        int64_t last_s = -1;
+        for (NodeID u : g.in_neigh(v)) {
+          int64_t s = u / slice_nodes;
+          if (s != last_s) {
+            pairs[t][s]++;
+            last_s = s;
+          }
+          srcs[t][s]++;
+        }
+      }
+    }
+    segments_.resize(num_segments);
+    for (int64_t s = 0; s < num_segments; s++) {
+      int64_t num_pairs = 0, num_srcs = 0;
+      for (int t = 0; t < num_threads; t++) {
+        int64_t p = pairs[t][s], e = srcs[t][s];
+        pairs[t][s] = num_pairs;
+        srcs[t][s] = num_srcs;
+        num_pairs += p;
+        num_srcs += e;
+      }
+      Segment &seg = segments_[s];
+      seg.dests.resize(num_pairs);
+      seg.offsets.resize(num_pairs + 1);
+      seg.offsets[num_pairs] = num_srcs;
+      seg.srcs.resize(num_srcs);
+      num_pairs_ += num_pairs;
+    }
+    #pragma omp parallel for schedule(static, 1)
+    for (int t = 0; t < num_threads; t++) {
+      vector<int64_t> &pair = pairs[t], &src = srcs[t];
+      for (NodeID v = dst_begin[t]; v < dst_begin[t + 1]; v++) {
+        int64_t last_s = -1;
+        for (NodeID u : g.in_neigh(v)) {
+          int64_t s = u / slice_nodes;
+          Segment &seg = segments_[s];
+          if (s != last_s) {
+            seg.dests[pair[s]] = v;
+            seg.offsets[pair[s]++] = src[s];
+            last_s = s;
+          }
+          seg.srcs[src[s]++] = u;
+        }
+      }
+    }
+  }
+
+  void Gather(const pvector<ScoreT> &contrib, pvector<ScoreT> &sums) override {
+    for (const Segment &seg : segments_) {
+      const int64_t num_dests = seg.dests.size();
+      #pragma omp parallel for schedule(dynamic, 1024)
+      for (int64_t i = 0; i < num_dests; i++) {
+        ScoreT incoming_total = 0;
+        for (int64_t j = seg.offsets[i]; j < seg.offsets[i + 1]; j++)
+          incoming_total += contrib[seg.srcs[j]];
+        sums[seg.dests[i]] += incoming_total;
+      }
+    }
+  }
+
+  // Per edge: source index + contrib read (in slice); per (dest, segment)
+  // pair: dest id, offset, sums read-modify-write
+  double Bytes() const override {
+    return g_.num_edges_directed() * (sizeof(NodeID) + sizeof(ScoreT)) +
+           num_pairs_ * (sizeof(NodeID) + sizeof(int64_t) +
+                         2 * sizeof(ScoreT));
+  }
+  // sums[] is written in destination order, but over the whole array
+  double RandomBytes() const override {
+    return num_pairs_ * 2 * sizeof(ScoreT);
+  }
+
+  int64_t num_segments() const { return segments_.size(); }
+
+ private:
+  struct Segment {
+    vector<NodeID> dests;
+    vector<int64_t> offsets;
+    vector<NodeID> srcs;
+  };
+
+  const Graph &g_;
+  vector<Segment> segments_;
+  int64_t num_pairs_ = 0;
+};
+
+// Deterministic propagation blocking over destination slices
+class BlockedLayout : public PRLayout {
+ public:
+  BlockedLayout(const Graph &g, int64_t slice_nodes)
+      : g_(g), slice_nodes_(slice_nodes),
+        num_bins_((g.num_nodes() + slice_nodes - 1) / slice_nodes),
+        num_threads_(MaxThreads()),
+        bin_dest_(g.num_edges_directed()), bin_value_(g.num_edges_directed()) {
+    // Edge-balanced source ranges, one per thread
+    const int64_t m = g.num_edges_directed();
+    src_begin_.assign(num_threads_ + 1, g.num_nodes());
+    src_begin_[0] = 0;
+    int t = 1;
+    int64_t seen = 0;
+    for (NodeID u = 0; u < g.num_nodes() && t < num_threads_; u++) {
+      seen += g.out_degree(u);
+      while (t < num_threads_ && seen >= m * t / num_threads_)
+        src_begin_[t++] = u + 1;
+    }
+
+    // Thread t writes its part of bin b from cursor_start_[t][b]
+    vector<vector<int64_t>> counts(num_threads_,
+                                   vector<int64_t>(num_bins_, 0));
+    #pragma omp parallel for schedule(static, 1)
+    for (int t = 0; t < num_threads_; t++)
+      for (NodeID u = src_begin_[t]; u < src_begin_[t + 1]; u++)
+        for (NodeID v : g.out_neigh(u))
+          counts[t][v / slice_nodes_]++;
+    bin_start_.assign(num_bins_ + 1, 0);
+    cursor_start_.assign(num_threads_, vector<int64_t>(num_bins_, 0));
+    int64_t pos = 0;
+    for (int64_t b = 0; b < num_bins_; b++) {
+      bin_start_[b] = pos;
+      for (int t = 0; t < num_threads_; t++) {
+        cursor_start_[t][b] = pos;
+        pos += counts[t][b];
+      }
+    }
+    bin_start_[num_bins_] = pos;
+    #pragma omp parallel for schedule(static, 1)
+    for (int t = 0; t < num_threads_; t++) {
+      vector<int64_t> cursor = cursor_start_[t];
+      for (NodeID u = src_begin_[t]; u < src_begin_[t + 1]; u++)
+        for (NodeID v : g.out_neigh(u))
+          bin_dest_[cursor[v / slice_nodes_]++] = v;
+    }
+  }
+
+  void Gather(const pvector<ScoreT> &contrib, pvector<ScoreT> &sums) override {
+    // Binning: the destination is only needed to pick the bin
+    #pragma omp parallel for schedule(static, 1)
+    for (int t = 0; t < num_threads_; t++) {
+      vector<int64_t> cursor = cursor_start_[t];
+      for (NodeID u = src_begin_[t]; u < src_begin_[t + 1]; u++) {
+        ScoreT c = contrib[u];
+        for (NodeID v : g_.out_neigh(u))
+          bin_value_[cursor[v / slice_nodes_]++] = c;
+      }
+    }
+    // Accumulate: every bin covers its own slice of sums[]
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int64_t b = 0; b < num_bins_; b++)
+      for (int64_t i = bin_start_[b]; i < bin_start_[b + 1]; i++)
+        sums[bin_dest_[i]] += bin_value_[i];
+  }
+
+  // Per edge: neighbor index read, value write, dest + value read, sums
+  // read-modify-write (in slice); per source: offsets + contrib read
+  double Bytes() const override {
+    return g_.num_edges_directed() * (2 * sizeof(NodeID) +
+                                      4 * sizeof(ScoreT)) +
+           g_.num_nodes() * (sizeof(SGOffset) + sizeof(ScoreT));
+  }
+  double RandomBytes() const override { return 0; }
+
+  int64_t num_bins() const { return num_bins_; }
+
+ private:
+  const Graph &g_;
+  const int64_t slice_nodes_;
+  const int64_t num_bins_;
+  const int num_threads_;
+  vector<NodeID> src_begin_;
+  vector<int64_t> bin_start_;
+  vector<vector<int64_t>> cursor_start_;
+  pvector<NodeID> bin_dest_;
+  pvector<ScoreT> bin_value_;
+};
+
+pvector<ScoreT> PageRank(const Graph &g, PRLayout &layout, int max_iters,
+                         double epsilon, bool logging_enabled) {
+  const ScoreT init_score = 1.0f / g.num_nodes();
+  pvector<ScoreT> scores(g.num_nodes(), init_score);
+  pvector<ScoreT> contrib(g.num_nodes());
+  pvector<ScoreT> sums(g.num_nodes(), 0);
+  Timer t_total, t;
+  t_total.Start();
+  int iter;
+  for (iter = 0; iter < max_iters; iter++) {
+    t.Start();
+    ComputeContrib(g, scores, contrib);
+    layout.Gather(contrib, sums);
+    double error = ApplySums(g, scores, sums);
+    t.Stop();
+    if (logging_enabled)
+      printf("%5d%11.5lf%11.6lf\n", iter, t.Seconds(), error);
+    if (error < epsilon) {
+      iter++;
+      break;
+    }
+  }
+  t_total.Stop();
+  // ComputeContrib + ApplySums: score read, contrib write, sums and score
+  // read/write, per vertex
+  const double vertex_bytes = g.num_nodes() * 6.0 * sizeof(ScoreT);
+  g_pr.iters += iter;
+  g_pr.edges += g.num_edges_directed() * iter;
+  g_pr.bytes += (layout.Bytes() + vertex_bytes) * iter;
+  g_pr.random_bytes += layout.RandomBytes() * iter;
+  g_pr.seconds += t_total.Seconds();
+  return scores;
+}
+
+void PrintTopScores(const Graph &g, const pvector<ScoreT> &scores) {
+  vector<pair<NodeID, ScoreT>> score_pairs(g.num_nodes());
+  for (NodeID n = 0; n < g.num_nodes(); n++)
+    score_pairs[n] = make_pair(n, scores[n]);
+  int k = 5;
+  partial_sort(score_pairs.begin(), score_pairs.begin() + k,
+               score_pairs.end(),
+               [](const pair<NodeID, ScoreT> &a,
+                  const pair<NodeID, ScoreT> &b) {
+                 return a.second > b.second;
+               });
+  for (int i = 0; i < k; i++)
+    cout << score_pairs[i].first << ": " << score_pairs[i].second << endl;
+}
+
+// One more serial push iteration must move the scores by less than
+// target_error
+bool PRVerifier(const Graph &g, const pvector<ScoreT> &scores,
+                double target_error) {
+  const ScoreT base_score = (1.0f - kDamp) / g.num_nodes();
+  pvector<ScoreT> incoming_sums(g.num_nodes(), 0);
+  double error = 0;
+  for (NodeID u : g.vertices()) {
+    if (g.out_degree(u) == 0)
+      continue;
+    ScoreT outgoing_contrib = scores[u] / g.out_degree(u);
+    for (NodeID v : g.out_neigh(u))
+      incoming_sums[v] += outgoing_contrib;
+  }
+  for (NodeID n : g.vertices()) {
+    error += fabs(base_score + kDamp * incoming_sums[n] - scores[n]);
+    incoming_sums[n] = 0;
+  }
+  PrintTime("Total Error", error);
+  return error < target_error;
+}
+
+int main(int argc, char* argv[]) {
+  StripCustomArgs(argc, argv);
+  if (g_algo != "pull" && g_algo != "segmented" && g_algo != "pb") {
+    cout << "--algo must be pull, segmented or pb" << endl;
+    return -1;
+  }
+  CLPageRank cli(argc, argv, "pagerank", 1e-4, 20);
+  if (!cli.ParseArgs()) return -1;
+
+  GraphProvider provider;
+  const Graph &g = provider.Get(cli, g_snapshot, g_prefault);
+  const int64_t slice_nodes = max<int64_t>(g_slice_bytes / sizeof(ScoreT),
+                                           64);
+  Timer t;
+  t.Start();
+  unique_ptr<PRLayout> layout;
+  if (g_algo == "pull") {
+    layout.reset(new PullLayout(g));
+  } else if (g_algo == "segmented") {
+    SegmentedLayout *seg = new SegmentedLayout(g, slice_nodes);
+    cout << "Segments: " << seg->num_segments() << endl;
+    layout.reset(seg);
+  } else {
+    BlockedLayout *pb = new BlockedLayout(g, slice_nodes);
+    cout << "Bins: " << pb->num_bins() << endl;
+    layout.reset(pb);
+  }
+  t.Stop();
+  PrintTime("Preprocess Time", t.Seconds());
+
+  auto PRBound = [&cli, &layout] (const Graph &g) {
+    return PageRank(g, *layout, cli.max_iters(), cli.tolerance(),
+                    cli.logging_en());
+  };
+  auto VerifierBound = [&cli] (const Graph &g, const pvector<ScoreT> &scores) {
+    return PRVerifier(g, scores, cli.tolerance());
+  };
+  BenchmarkKernel(cli, g, PRBound, PrintTopScores, VerifierBound);
+
+  const int trials = cli.num_trials();
+  cout << "Layout: " << g_algo << " (slice " << (g_slice_bytes >> 10)
+       << " KiB)" << endl;
+  cout << "Iterations: " << fixed << setprecision(1)
+       << double(g_pr.iters) / trials << endl;
+  cout << "Traversed edges: " << g_pr.edges / trials << endl;
+  cout << "PR Time (s): " << setprecision(6) << g_pr.seconds / trials << endl;
+  cout << "Estimated bytes: " << setprecision(0) << g_pr.bytes / trials
+       << " (random " << g_pr.random_bytes / trials << ")" << endl;
+  cout << "Edges per byte (Ie): " << setprecision(6)
+       << (g_pr.bytes > 0 ? g_pr.edges / g_pr.bytes : 0.0) << endl;
+  cout << "TEPS: " << setprecision(3)
+       << (g_pr.seconds > 0 ? g_pr.edges / g_pr.seconds : 0.0) << endl;
+  return 0;
+}
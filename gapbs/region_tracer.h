@@ -0,0 +1,340 @@
+#ifndef REGION_TRACER_H_
+#define REGION_TRACER_H_
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/*
+Hierarchical region tracer
+
+TraceRegion names a stretch of one thread's execution. Regions nest by
+scope and close when they go out of scope, or earlier with End():
+
+  TraceRegion bfs("bfs");
+  {
+    TraceRegion step("td");
+    ...
+  }
+
+Timestamps are raw TSC reads (rdtsc, steady_clock on other targets). They
+are converted to nanoseconds with a ratio calibrated once against
+steady_clock over 20 ms, which assumes an invariant TSC. The calibration
+runs on the first NsPerTick call, so call it (or SetEnabled(true)) before
+the code being timed.
+
+Every thread that opens a region gets its own log, registered once under a
+lock. The log holds two things:
+
+  ring     the last kRingEvents closed regions (name, start, length,
+           depth); older events are overwritten and counted as dropped
+  stats    count, total, min and max per region name, never dropped
+
+Only the owning thread writes its log, so closing a region costs two TSC
+reads, a short search of the thread's name table and one release store.
+The tracer starts disabled: a region then still reads the TSC (so
+Seconds() works) but allocates and records nothing. Drivers turn it on
+for --regions with SetEnabled(true), which also calibrates and registers
+the calling thread, so neither happens inside a traced region.
+
+Regions are keyed by the name pointer, so names must be string literals.
+The readers (Summary, PrintSummary, WriteChromeTrace) merge the threads'
+logs by name and should run once the traced work is done. The Chrome trace
+has one "X" event per ring entry and one track per thread, and loads in
+chrome://tracing and ui.perfetto.dev.
+*/
+
+struct RegionEvent {
+  const char *name;
+  uint64_t start;              // ticks
+  uint64_t ticks;
+  int32_t depth;
+};
+
+struct RegionStats {
+  const char *name;
+  int depth;                   // shallowest nesting depth seen
+  int64_t count;
+  uint64_t total;              // ticks
+  uint64_t min;
+  uint64_t max;
+  uint64_t first;              // earliest start, orders parents first
+};
+
+class RegionTracer {
+ public:
+  static const size_t kRingEvents = 1 << 16;
+
+  struct ThreadLog {
+    explicit ThreadLog(int tid_) : tid(tid_), depth(0), ring(kRingEvents),
+                                   written(0) {}
+
+    int tid;
+    int depth;
+    std::vector<RegionEvent> ring;
+    std::atomic<uint64_t> written;
+    std::vector<RegionStats> stats;
+  };
+
+  static uint64_t Now() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+  }
+
+  static double NsPerTick() {
+    static const double ratio = Calibrate();
+    return ratio;
+  }
+
+  static bool enabled() {
+    return Enabled().load(std::memory_order_relaxed);
+  }
+
+  static void SetEnabled(bool on) {
+    if (on) {
+      NsPerTick();
+      Local();
+    }
+    Enabled().store(on, std::memory_order_relaxed);
+  }
+
+  // Calling thread's log, created on first use
+  static ThreadLog& Local() {
+    static thread_local ThreadLog *log = nullptr;
+    if (log == nullptr)
+      log = Register();
+    return *log;
+  }
+
+  static void Record(ThreadLog &log, const char *name, uint64_t start,
+                     uint64_t end, int depth) {
+    uint64_t ticks = end - start;
+    uint64_t w = log.written.load(std::memory_order_relaxed);
+    log.ring[w % kRingEvents] = RegionEvent{name, start, ticks, depth};
+    log.written.store(w + 1, std::memory_order_release);
+    for (RegionStats &s : log.stats) {
+      if (s.name == name) {
+        s.depth = std::min(s.depth, depth);
+        s.count++;
+        s.total += ticks;
+        s.min = std::min(s.min, ticks);
+        s.max = std::max(s.max, ticks);
+        s.first = std::min(s.first, start);
+        return;
+      }
+    }
+    log.stats.push_back(RegionStats{name, depth, 1, ticks, ticks, ticks, start});
+  }
+
+  // Per-name totals over every thread, in order of first start, so an
+  // enclosing region comes before the ones nested in it
+  static std::vector<RegionStats> Summary() {
+    std::vector<RegionStats> merged;
+    std::lock_guard<std::mutex> lock(RegistryLock());
+    for (const std::unique_ptr<ThreadLog> &log : Logs()) {
+      for (const RegionStats &s : log->stats) {
+        bool found = false;
+        for (RegionStats &m : merged) {
+          if (m.name == s.name || strcmp(m.name, s.name) == 0) {
+            m.depth = std::min(m.depth, s.depth);
+            m.count += s.count;
+            m.total += s.total;
+            m.min = std::min(m.min, s.min);
+            m.max = std::max(m.max, s.max);
+            m.first = std::min(m.first, s.first);
+            found = true;
+            break;
+          }
+        }
+        if (!found)
+          merged.push_back(s);
+      }
+    }
+    std::sort(merged.begin(), merged.end(),
+              [](const RegionStats &a, const RegionStats &b) {
+                return a.first < b.first;
+              });
+    return merged;
+  }
+
+  // Events lost to ring wrap-around, over every thread
+  static uint64_t Dropped() {
+    uint64_t dropped = 0;
+    std::lock_guard<std::mutex> lock(RegistryLock());
+    for (const std::unique_ptr<ThreadLog> &log : Logs()) {
+      uint64_t w = log->written.load(std::memory_order_acquire);
+      dropped += w > kRingEvents ? w - kRingEvents : 0;
+    }
+    return dropped;
+  }
+
+  static void PrintSummary(std::ostream &out) {
+    std::vector<RegionStats> stats = Summary();
+    if (stats.empty())
+      return;
+    double ns = NsPerTick();
+    const std::ios::fmtflags flags = out.flags();
+    const std::streamsize precision = out.precision();
+    out << std::left << std::setw(20) << "Region" << std::right
+        << std::setw(10) << "count" << std::setw(14) << "total ms"
+        << std::setw(14) << "mean us" << std::setw(14) << "min us"
+        << std::setw(14) << "max us" << std::endl;
+    out << std::fixed << std::setprecision(3);
+    for (const RegionStats &s : stats) {
+      std::string label = std::string(2 * s.depth, ' ') + s.name;
+      out << std::left << std::setw(20) << label << std::right
+          << std::setw(10) << s.count
+          << std::setw(14) << s.total * ns * 1e-6
+          << std::setw(14) << s.total * ns * 1e-3 / s.count
+          << std::setw(14) << s.min * ns * 1e-3
+          << std::setw(14) << s.max * ns * 1e-3 << std::endl;
+    }
+    uint64_t dropped = Dropped();
+    if (dropped > 0)
+      out << "(" << dropped << " oldest events dropped from the trace rings)"
+          << std::endl;
+    out.flags(flags);
+    out.precision(precision);
+  }
+
+  // Chrome trace-event JSON of the ring contents; false if unwritable
+  static bool WriteChromeTrace(const std::string &path) {
+    std::ofstream out(path.c_str(), std::ios::trunc);
+    if (!out)
+      return false;
+    double ns = NsPerTick();
+    std::lock_guard<std::mutex> lock(RegistryLock());
+    uint64_t origin = UINT64_MAX;
+    for (const std::unique_ptr<ThreadLog> &log : Logs()) {
+      ForEachEvent(*log, [&](const RegionEvent &e) {
+        origin = std::min(origin, e.start);
+      });
+    }
+    out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    bool first = true;
+    out << std::fixed << std::setprecision(3);
+    for (const std::unique_ptr<ThreadLog> &log : Logs()) {
+      out << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\","
+          << "\"pid\":1,\"tid\":" << log->tid << ",\"args\":{\"name\":\""
+          << (log->tid == 0 ? "main" : "thread " + std::to_string(log->tid))
+          << "\"}}";
+      first = false;
+      ForEachEvent(*log, [&](const RegionEvent &e) {
+        out << ",\n{\"name\":\"" << e.name << "\",\"ph\":\"X\",\"pid\":1,"
+            << "\"tid\":" << log->tid << ",\"ts\":"
+            << (e.start - origin) * ns * 1e-3 << ",\"dur\":"
+            << e.ticks * ns * 1e-3 << ",\"args\":{\"depth\":" << e.depth
+            << "}}";
+      });
+    }
+    out << "\n]}\n";
+    return static_cast<bool>(out);
+  }
+
+ private:
+  static std::atomic<bool>& Enabled() {
+    static std::atomic<bool> on(false);
+    return on;
+  }
+
+  static std::mutex& RegistryLock() {
+    static std::mutex lock;
+    return lock;
+  }
+
+  // Logs outlive their threads so a trace can be written after a join
+  static std::vector<std::unique_ptr<ThreadLog>>& Logs() {
+    static std::vector<std::unique_ptr<ThreadLog>> logs;
+    return logs;
+  }
+
+  static ThreadLog* Register() {
+    std::lock_guard<std::mutex> lock(RegistryLock());
+    std::vector<std::unique_ptr<ThreadLog>> &logs = Logs();
+    logs.emplace_back(new ThreadLog(static_cast<int>(logs.size())));
+    return logs.back().get();
+  }
+
+  template <typename Visitor>
+  static void ForEachEvent(const ThreadLog &log, Visitor visit) {
+    uint64_t w = log.written.load(std::memory_order_acquire);
+    uint64_t begin = w > kRingEvents ? w - kRingEvents : 0;
+    for (uint64_t i = begin; i < w; i++)
+      visit(log.ring[i % kRingEvents]);
+  }
+
+  static double Calibrate() {
+#if defined(__x86_64__) || defined(__i386__)
+    typedef std::chrono::steady_clock Clock;
+    Clock::time_point c0 = Clock::now();
+    uint64_t t0 = Now();
+    while (Clock::now() - c0 < std::chrono::milliseconds(20)) {}
+    uint64_t t1 = Now();
+    Clock::time_point c1 = Clock::now();
+    double ns = std::chrono::duration<double, std::nano>(c1 - c0).count();
+    return t1 > t0 ? ns / (t1 - t0) : 1.0;
+#else
+    return 1.0;
+#endif
+  }
+};
+
+class TraceRegion {
+ public:
+  explicit TraceRegion(const char *name)
+      : name_(name), log_(nullptr), depth_(0), end_(0) {
+    if (RegionTracer::enabled()) {
+      log_ = &RegionTracer::Local();
+      depth_ = log_->depth++;
+    }
+    start_ = RegionTracer::Now();
+  }
+
+  ~TraceRegion() { End(); }
+
+  TraceRegion(const TraceRegion&) = delete;
+  TraceRegion& operator=(const TraceRegion&) = delete;
+
+  // Closes the region early; later calls do nothing
+  void End() {
+    if (end_ != 0)
+      return;
+    end_ = RegionTracer::Now();
+    if (log_ != nullptr) {
+      log_->depth--;
+      RegionTracer::Record(*log_, name_, start_, end_, depth_);
+    }
+  }
+
+  // Length so far, or the final length once ended
+  double Seconds() const {
+    uint64_t end = end_ != 0 ? end_ : RegionTracer::Now();
+    return (end - start_) * RegionTracer::NsPerTick() * 1e-9;
+  }
+
+ private:
+  const char *name_;
+  RegionTracer::ThreadLog *log_;
+  int depth_;
+  uint64_t start_;
+  uint64_t end_;
+};
+
+#endif  // REGION_TRACER_H_
@@ -0,0 +1,279 @@
+#include <iostream>
+#include <vector>
+#include <iomanip>
+#include <algorithm>
+#include <cinttypes>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <string>
+#include <utility>
+
+#include "benchmark.h"
+#include "builder.h"
+#include "command_line.h"
+#include "graph.h"
+#include "platform_atomics.h"
+#include "pvector.h"
+#include "timer.h"
+
+/*
+Delta-stepping single-source shortest paths
+
+Weighted CSR from WeightedBuilder (generated graphs get weights in
+[1, 255]). Tentative distances live in one array updated with CAS; a
+vertex whose distance drops lands in bucket floor(dist / delta).
+
+Each thread keeps its own bins (a vector per bucket), so relaxing an edge
+never touches shared queue state. One step:
+  1. threads relax the out-edges of the shared frontier (the current
+     bucket), skipping entries whose distance has since fallen into an
+     earlier bucket
+  2. bucket fusion: while a thread's own copy of the current bucket is
+     non-empty and smaller than --fusion-threshold, it relaxes it on the
+     spot instead of waiting for the next barrier. Most steps on
+     low-diameter graphs are short, so this removes most barriers
+  3. threads agree on the smallest non-empty bucket and copy their bins
+     for it into the shared frontier
+A vertex can be queued more than once; the stale copies are the ones
+skipped in 1.
+
+Delta: -d sets it directly (default 1, as in the reference sssp).
+--auto-delta=1 picks max_weight / average out-degree instead, the
+Meyer-Sanders choice for random weights, which keeps the number of light
+edges per vertex near one.
+
+"Relaxed edges" counts every out-edge examined, including the re-relaxation
+caused by duplicates; that is the work measure the rate is reported for.
+Updates counts the CAS that lowered a distance.
+
+Extra flags (stripped before CLApp sees them):
+  --auto-delta=0|1        choose delta from the graph (default 0)
+  --fusion-threshold=N    largest local bucket relaxed without a barrier
+                          (default 1000, 0 disables fusion)
+*/
+
+using namespace std;
+
+const WeightT kDistInf = numeric_limits<WeightT>::max() / 2;
+const size_t kMaxBin = numeric_limits<size_t>::max() / 2;
+
+static bool g_auto_delta = false;
+static size_t g_fusion_threshold = 1000;
+
+static void StripCustomArgs(int& argc, char** argv) {
+  int out = 1;
+  for (int i = 1; i < argc; ++i) {
+    string a = argv[i];
+    if (a.compare(0, 13, "--auto-delta=") == 0)
+      g_auto_delta = atoi(a.c_str() + 13) != 0;
+    else if (a.compare(0, 19, "--fusion-threshold=") == 0)
+      g_fusion_threshold = atol(a.c_str() + 19);
+    else argv[out++] = argv[i];
+  }
+  argc = out;
+}
+
+// Totals for the report, summed over trials
+struct SSSPStats {
+  int64_t relaxed = 0;
+  int64_t updates = 0;
+  int64_t fused = 0;
+  int64_t steps = 0;
+  double seconds = 0;
+};
+
+static SSSPStats g_sssp;
+
+WeightT AutoDelta(const WGraph &g) {
+  WeightT max_weight = 0;
+  #pragma omp parallel for reduction(max : max_weight) schedule(dynamic, 16384)
+  for (NodeID u = 0; u < g.num_nodes(); u++) {
+    for (WNode wn : g.out_neigh(u))
+      max_weight = max(max_weight, wn.w);
+  }
+  double avg_degree = g.num_edges_directed() / double(g.num_nodes());
+  return max<WeightT>(1, max_weight / max(avg_degree, 1.0));
+}
+
+// Relaxes u's out-edges into local_bins; returns the number of updates
+inline int64_t RelaxEdges(const WGraph &g, NodeID u, WeightT delta,
+                          pvector<WeightT> &dist,
+                          vector<vector<NodeID>> &local_bins) {
+  int64_t updates = 0;
+  for (WNode wn : g.out_neigh(u)) {
+    WeightT old_dist = dist[wn.v];
+    WeightT new_dist = dist[u] + wn.w;
+    while (new_dist < old_dist) {
+      if (compare_and_swap(dist[wn.v], old_dist, new_dist)) {
+        size_t dest_bin = new_dist / delta;
+        if (dest_bin >= local_bins.size())
+          local_bins.resize(dest_bin + 1);
+        local_bins[dest_bin].push_back(wn.v);
+        updates++;
+        break;
+      }
+      old_dist = dist[wn.v];
+    }
+  }
+  return updates;
+}
+
+pvector<WeightT> DeltaStep(const WGraph &g, NodeID source, WeightT delta,
+                           bool logging_enabled = false) {
+  Timer t_total, t;
+  pvector<WeightT> dist(g.num_nodes(), kDistInf);
+  dist[source] = 0;
+  pvector<NodeID> frontier(g.num_edges_directed() + 1);
+  // Two copies of bucket index and frontier size, flipped every step so
+  // that resetting one never races with reads of the other
+  size_t shared_indexes[2] = {0, kMaxBin};
+  size_t frontier_tails[2] = {1, 0};
+  frontier[0] = source;
+  int64_t relaxed = 0, updates = 0, fused = 0, steps = 0;
+  if (logging_enabled) PrintStep("Source", static_cast<int64_t>(source));
+  t_total.Start();
+  t.Start();
+  #pragma omp parallel reduction(+ : relaxed, updates, fused)
+  {
+    vector<vector<NodeID>> local_bins(0);
+    size_t iter = 0;
+    while (shared_indexes[iter & 1] != kMaxBin) {
+      size_t &curr_bin_index = shared_indexes[iter & 1];
+      size_t &next_bin_index = shared_indexes[(iter + 1) & 1];
+      size_t &curr_frontier_tail = frontier_tails[iter & 1];
+      size_t &next_frontier_tail = frontier_tails[(iter + 1) & 1];
+      const WeightT bin_floor = delta * static_cast<WeightT>(curr_bin_index);
+      #pragma omp for nowait schedule(dynamic, 64)
+      for (size_t i = 0; i < curr_frontier_tail; i++) {
+        NodeID u = frontier[i];
+        if (dist[u] >= bin_floor) {
+          relaxed += g.out_degree(u);
+          updates += RelaxEdges(g, u, delta, dist, local_bins);
+        }
+      }
+      while (curr_bin_index < local_bins.size() &&
+             !local_bins[curr_bin_index].empty() &&
+             local_bins[curr_bin_index].size() < g_fusion_threshold) {
+        vector<NodeID> curr_bin_copy;
+        curr_bin_copy.swap(local_bins[curr_bin_index]);
+        for (NodeID u : curr_bin_copy) {
+          relaxed += g.out_degree(u);
+          fused += g.out_degree(u);
+          updates += RelaxEdges(g, u, delta, dist, local_bins);
+        }
+      }
+      for (size_t i = curr_bin_index; i < local_bins.size(); i++) {
+        if (!local_bins[i].empty()) {
+          #pragma omp critical
+          next_bin_index = min(next_bin_index, i);
+          break;
+        }
+      }
+      #pragma omp barrier
+      #pragma omp single nowait
+      {
+        t.Stop();
+        if (logging_enabled)
+          PrintStep(curr_bin_index, t.Seconds(), curr_frontier_tail);
+        t.Start();
+        steps++;
+        curr_bin_index = kMaxBin;
+        curr_frontier_tail = 0;
+      }
+      if (next_bin_index < local_bins.size()) {
+        size_t copy_start = fetch_and_add(next_frontier_tail,
+                                          local_bins[next_bin_index].size());
+        copy(local_bins[next_bin_index].begin(),
+             local_bins[next_bin_index].end(), frontier.data() + copy_start);
+        local_bins[next_bin_index].resize(0);
+      }
+      iter++;
+      #pragma omp barrier
+    }
+  }
+  t_total.Stop();
+  g_sssp.relaxed += relaxed;
+  g_sssp.updates += updates;
+  g_sssp.fused += fused;
+  g_sssp.steps += steps;
+  g_sssp.seconds += t_total.Seconds();
+  return dist;
+}
+
+void PrintSSSPStats(const WGraph &g, const pvector<WeightT> &dist) {
+  auto NotInf = [](WeightT d) { return d != kDistInf; };
+  int64_t num_reached = count_if(dist.begin(), dist.end(), NotInf);
+  cout << "SSSP Tree reaches " << num_reached << " of " << g.num_nodes()
+       << " nodes" << endl;
+}
+
+// Compares against serial Dijkstra
+bool SSSPVerifier(const WGraph &g, NodeID source,
+                  const pvector<WeightT> &dist_to_test) {
+  pvector<WeightT> oracle_dist(g.num_nodes(), kDistInf);
+  oracle_dist[source] = 0;
+  typedef pair<WeightT, NodeID> WN;
+  priority_queue<WN, vector<WN>, greater<WN>> mq;
+  mq.push(make_pair(0, source));
+  while (!mq.empty()) {
+    WeightT td = mq.top().first;
+    NodeID u = mq.top().second;
+    mq.pop();
+    if (td == oracle_dist[u]) {
+      for (WNode wn : g.out_neigh(u)) {
+        if (td + wn.w < oracle_dist[wn.v]) {
+          oracle_dist[wn.v] = td + wn.w;
+          mq.push(make_pair(td + wn.w, wn.v));
+        }
+      }
+    }
+  }
+  bool all_ok = true;
+  for (NodeID n : g.vertices()) {
+    if (dist_to_test[n] != oracle_dist[n]) {
+      cout << n << ": " << dist_to_test[n] << " != " << oracle_dist[n] << endl;
+      all_ok = false;
+    }
+  }
+  return all_ok;
+}
+
+int main(int argc, char* argv[]) {
+  StripCustomArgs(argc, argv);
+  CLDelta<WeightT> cli(argc, argv, "single-source shortest-path");
+  if (!cli.ParseArgs()) return -1;
+  WeightedBuilder b(cli);
+  WGraph g = b.MakeGraph();
+  WeightT delta = g_auto_delta ? AutoDelta(g) : cli.delta();
+  if (delta <= 0) {
+    cout << "delta must be positive" << endl;
+    return -1;
+  }
+  cout << "Delta: " << delta << (g_auto_delta ? " (auto)" : "") << endl;
+
+  SourcePicker<WGraph> sp(g, cli.start_vertex());
+  auto SSSPBound = [&sp, &cli, delta] (const WGraph &g) {
+    return DeltaStep(g, sp.PickNext(), delta, cli.logging_en());
+  };
+  SourcePicker<WGraph> vsp(g, cli.start_vertex());
+  auto VerifierBound = [&vsp] (const WGraph &g,
+                               const pvector<WeightT> &dist) {
+    return SSSPVerifier(g, vsp.PickNext(), dist);
+  };
+  BenchmarkKernel(cli, g, SSSPBound, PrintSSSPStats, VerifierBound);
+
+  const int trials = cli.num_trials();
+  cout << "Steps: " << g_sssp.steps / trials << endl;
+  cout << "Relaxed edges: " << g_sssp.relaxed / trials << " ("
+       << fixed << setprecision(1)
+       << 100.0 * g_sssp.fused / max<int64_t>(g_sssp.relaxed, 1)
+       << "% fused)" << endl;
+  cout << "Distance updates: " << g_sssp.updates / trials << endl;
+  cout << "SSSP Time (s): " << setprecision(6) << g_sssp.seconds / trials
+       << endl;
+  cout << "Relaxed edges per second: " << setprecision(3)
+       << (g_sssp.seconds > 0 ? g_sssp.relaxed / g_sssp.seconds : 0.0)
+       << endl;
+  return 0;
+}
@@ -0,0 +1,154 @@
+#ifndef SWITCH_TUNING_H_
+#define SWITCH_TUNING_H_
+
+#include <cinttypes>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "command_line.h"
+
+/*
+Adaptive direction switching for DOBFS
+
+The fixed heuristic switches top-down -> bottom-up when the frontier's edges
+exceed edges_to_check / alpha, and back when the awake count drops below
+num_nodes / beta. Both constants hide a cost ratio that depends on the graph
+and the machine. SwitchController measures that ratio instead:
+
+  c_td     seconds per edge examined in td steps
+  c_bu     seconds per edge examined in bu steps
+  bu_frac  edges examined by the first bu step of a phase, as a fraction of
+           the edges still unchecked when the phase started
+
+and predicts the cost of the next step both ways:
+
+  td -> bu when   scout_count * c_td  >  edges_to_check * bu_frac * c_bu
+  bu -> td when   last_bu_edges * c_bu > awake * avg_degree * c_td
+                  (and the frontier has stopped growing)
+
+Measurements are exponential moving averages that survive across trials, so
+the first trial runs on alpha/beta and later trials run on the model. Steps
+with very few edges are ignored because their timings are mostly noise.
+
+Offline calibration sweeps alpha/beta on a graph and stores the winner per
+graph class in a small text file, one "class alpha beta" line per class.
+Those values are also what the controller falls back to before it has
+measurements.
+*/
+
+class SwitchController {
+ public:
+  static const int64_t kMinEdgesToSample = 4096;
+
+  void RecordTopDown(int64_t edges, double seconds) {
+    if (edges < kMinEdgesToSample) return;
+    Update(c_td_, seconds / edges, have_td_);
+  }
+
+  void RecordBottomUp(int64_t edges, int64_t edges_to_check, double seconds,
+                      bool first_in_phase) {
+    if (edges < kMinEdgesToSample) return;
+    Update(c_bu_, seconds / edges, have_bu_);
+    if (first_in_phase && edges_to_check > 0) {
+      bool have_frac = have_frac_;
+      Update(bu_frac_, static_cast<double>(edges) / edges_to_check, have_frac);
+      have_frac_ = have_frac;
+    }
+  }
+
+  bool PreferBottomUp(int64_t scout_count, int64_t edges_to_check,
+                      int alpha) const {
+    if (!(have_td_ && have_bu_ && have_frac_))
+      return scout_count > edges_to_check / alpha;
+    double td_cost = scout_count * c_td_;
+    double bu_cost = edges_to_check * bu_frac_ * c_bu_;
+    return td_cost > bu_cost;
+  }
+
+  bool StayBottomUp(int64_t awake_count, int64_t old_awake_count,
+                    int64_t last_bu_edges, int64_t num_nodes,
+                    double avg_degree, int beta) const {
+    if (awake_count >= old_awake_count)
+      return true;
+    if (!(have_td_ && have_bu_))
+      return awake_count > num_nodes / beta;
+    double td_cost = awake_count * avg_degree * c_td_;
+    double bu_cost = last_bu_edges * c_bu_;
+    return bu_cost < td_cost;
+  }
+
+  bool calibrated() const { return have_td_ && have_bu_ && have_frac_; }
+  double td_ns_per_edge() const { return c_td_ * 1e9; }
+  double bu_ns_per_edge() const { return c_bu_ * 1e9; }
+  double bu_fraction() const { return bu_frac_; }
+
+ private:
+  static constexpr double kSmoothing = 0.3;
+
+  static void Update(double &avg, double sample, bool &have) {
+    avg = have ? (1 - kSmoothing) * avg + kSmoothing * sample : sample;
+    have = true;
+  }
+
+  double c_td_ = 0, c_bu_ = 0, bu_frac_ = 0;
+  bool have_td_ = false, have_bu_ = false, have_frac_ = false;
+};
+
+// Default class key: generator, scale and degree, or the input file name
+inline std::string GraphClassName(const CLBase &cli) {
+  std::ostringstream name;
+  if (cli.filename() != "") {
+    std::string f = cli.filename();
+    size_t slash = f.find_last_of('/');
+    name << (slash == std::string::npos ? f : f.substr(slash + 1));
+  } else {
+    name << (cli.uniform() ? "urand" : "kron") << "-g" << cli.scale()
+         << "-k" << cli.degree();
+  }
+  return name.str();
+}
+
+// Returns true and fills alpha/beta if the file has a line for graph_class
+inline bool LoadSwitchParams(const std::string &path,
+                             const std::string &graph_class,
+                             int &alpha, int &beta) {
+  std::ifstream in(path.c_str());
+  std::string line;
+  while (std::getline(in, line)) {
+    std::istringstream fields(line);
+    std::string name;
+    int a, b;
+    if ((fields >> name >> a >> b) && name == graph_class) {
+      alpha = a;
+      beta = b;
+      return true;
+    }
+  }
+  return false;
+}
+
+// Replaces (or appends) the line for graph_class, keeping all other classes
+inline bool SaveSwitchParams(const std::string &path,
+                             const std::string &graph_class,
+                             int alpha, int beta) {
+  std::vector<std::string> kept;
+  {
+    std::ifstream in(path.c_str());
+    std::string line;
+    while (std::getline(in, line)) {
+      std::istringstream fields(line);
+      std::string name;
+      if ((fields >> name) && name != graph_class)
+        kept.push_back(line);
+    }
+  }
+  std::ofstream out(path.c_str(), std::ios::trunc);
+  for (const std::string &line : kept)
+    out << line << "\n";
+  out << graph_class << " " << alpha << " " << beta << "\n";
+  return static_cast<bool>(out);
+}
+
+#endif  // SWITCH_TUNING_H_
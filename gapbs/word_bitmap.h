@@ -0,0 +1,78 @@
+#ifndef WORD_BITMAP_H_
+#define WORD_BITMAP_H_
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstddef>
+
+#include "platform_atomics.h"
+
+/*
+Drop-in replacement for gapbs' Bitmap that also exposes its 64-bit words.
+
+gapbs' Bitmap keeps its storage private, so anything that wants to scan a
+frontier a word at a time (skip empty words, pull set bits out with tzcnt)
+has to go through get_bit() once per vertex. WordBitmap keeps the same
+interface (reset/set_bit/set_bit_atomic/get_bit/swap) so the BFS steps do not
+change, and adds num_words()/word()/words() for the bulk conversions.
+*/
+
+class WordBitmap {
+ public:
+  static const uint64_t kBitsPerWord = 64;
+
+  explicit WordBitmap(size_t size) {
+    num_words_ = (size + kBitsPerWord - 1) / kBitsPerWord;
+    start_ = new uint64_t[num_words_];
+  }
+
+  ~WordBitmap() { delete[] start_; }
+
+  WordBitmap(const WordBitmap &) = delete;
+  WordBitmap &operator=(const WordBitmap &) = delete;
+
+  void reset() {
+    #pragma omp parallel for
+    for (int64_t w = 0; w < num_words_; w++)
+      start_[w] = 0;
+  }
+
+  void set_bit(size_t pos) {
+    start_[word_offset(pos)] |= ((uint64_t) 1l << bit_offset(pos));
+  }
+
+  void set_bit_atomic(size_t pos) {
+    uint64_t old_val, new_val;
+    do {
+      old_val = start_[word_offset(pos)];
+      new_val = old_val | ((uint64_t) 1l << bit_offset(pos));
+    } while (!compare_and_swap(start_[word_offset(pos)], old_val, new_val));
+  }
+
+  bool get_bit(size_t pos) const {
+    return (start_[word_offset(pos)] >> bit_offset(pos)) & 1l;
+  }
+
+  void swap(WordBitmap &other) {
+    std::swap(start_, other.start_);
+    std::swap(num_words_, other.num_words_);
+  }
+
+  int64_t num_words() const { return num_words_; }
+  uint64_t word(int64_t w) const { return start_[w]; }
+  uint64_t* words() { return start_; }
+  const uint64_t* words() const { return start_; }
+  // Word holding bit pos (addresses for the cache model, bfs_metrics.h)
+  const uint64_t* word_of(size_t pos) const {
+    return start_ + word_offset(pos);
+  }
+
+  static uint64_t word_offset(size_t n) { return n / kBitsPerWord; }
+  static uint64_t bit_offset(size_t n) { return n & (kBitsPerWord - 1); }
+
+ private:
+  uint64_t *start_;
+  int64_t num_words_;
+};
+
+#endif  // WORD_BITMAP_H_
@@ -1,21 +1,35 @@
 #pragma once
 
-void matmul_ijk(float** A, float** B, float** C, size_t N)
+// Element access hook. The default compiles away; Main.cpp passes a tracer
+// that replays every access into a cache model (gapbs/cache_sim.h)
+struct NoTrace
+{
+	void Read(const float*) {}
+	void Write(const float*) {}
+};
+
+template<typename Trace = NoTrace>
+void matmul_ijk(float** A, float** B, float** C, size_t N, Trace trace = Trace())
 {
 	for (int i = 0; i < N; ++i)
 	{
 		for (int j = 0; j < N; ++j)
 		{
 			A[i][j] = 0.0f;
+			trace.Write(&A[i][j]);
 			for (int k = 0; k < N; ++k)
 			{
 				A[i][j] += B[i][k] * C[k][j];
+				trace.Read(&B[i][k]);
+				trace.Read(&C[k][j]);
+				trace.Write(&A[i][j]);
 			}
 		}
 	}
 }
 
-void matmul_kij(float** A, float** B, float** C, size_t N)
+template<typename Trace = NoTrace>
+void matmul_kij(float** A, float** B, float** C, size_t N, Trace trace = Trace())
 {
 	for (int k = 0; k < N; ++k)
 	{
@@ -24,18 +38,23 @@ void matmul_kij(float** A, float** B, float** C, size_t N)
 			for (int j = 0; j < N; ++j)
 			{
 				A[i][j] += B[i][k] * C[k][j];
+				trace.Read(&B[i][k]);
+				trace.Read(&C[k][j]);
+				trace.Write(&A[i][j]);
 			}
 		}
 	}
 }
 
-void matmul_stride_ijk(float** A, float** B, float** C, size_t N, size_t b)
+template<typename Trace = NoTrace>
+void matmul_stride_ijk(float** A, float** B, float** C, size_t N, size_t b, Trace trace = Trace())
 {
 	for (size_t i = 0; i < N; i += b)
 	{
 		for (size_t j = 0; j < N; j += b)
 		{
 			A[i][j] = 0.0f;
+			trace.Write(&A[i][j]);
 			for (size_t k = 0; k < N; k += b)
 			{
 				for (size_t ii = i; ii < i + b; ++ii)
@@ -45,6 +64,9 @@ void matmul_stride_ijk(float** A, float** B, float** C, size_t N, size_t b)
 						for (size_t kk = k; kk < k + b; ++kk)
 						{
 							A[ii][jj] += B[ii][kk] * C[kk][jj];
+							trace.Read(&B[ii][kk]);
+							trace.Read(&C[kk][jj]);
+							trace.Write(&A[ii][jj]);
 						}
 					}
 				}
@@ -53,7 +75,8 @@ void matmul_stride_ijk(float** A, float** B, float** C, size_t N, size_t b)
 	}
 }
 
-void matmul_stride_kij(float** A, float** B, float** C, size_t N, size_t b)
+template<typename Trace = NoTrace>
+void matmul_stride_kij(float** A, float** B, float** C, size_t N, size_t b, Trace trace = Trace())
 {
 	for (size_t k = 0; k < N; k += b)
 	{
@@ -68,6 +91,9 @@ void matmul_stride_kij(float** A, float** B, float** C, size_t N, size_t b)
 						for (size_t kk = k; kk < k + b; ++kk)
 						{
 							A[ii][jj] += B[ii][kk] * C[kk][jj];
+							trace.Read(&B[ii][kk]);
+							trace.Read(&C[kk][jj]);
+							trace.Write(&A[ii][jj]);
 						}
 					}
 				}
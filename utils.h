@@ -3,6 +3,8 @@
 #include <chrono>
 #include <iostream>
 
+#include "gapbs/region_tracer.h"
+
 #define LOOP2D(i, j, N) for(size_t i = 0; i < N; ++i)\
 for(size_t j = 0; j < N; ++j)
 
@@ -92,23 +94,32 @@ unsigned int RandomArrayGenerator(std::vector<int>& array, int NUM)
 	return NUM;
 }
 
+// Scoped timer on the region tracer (gapbs/region_tracer.h): with --regions
+// the scope is also recorded as a region, so it shows up in
+// RegionTracer::PrintSummary and in Chrome traces. Timestamps are TSC ticks
+// converted to nanoseconds; the ratio is calibrated before the scope starts
 class Timer
 {
 public:
-	Timer()
+	explicit Timer(const char* name = "Timer") : m_region(Calibrated(name))
 	{
-		m_start = std::chrono::high_resolution_clock::now();
 	}
 	~Timer()
 	{
-		m_end = std::chrono::high_resolution_clock::now();
-		m_duration = m_end - m_start;
-
-		auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(m_duration).count(); // For milisec
-		std::cout << "Execution Time : " << ms << "ms" << std::endl;
+		m_region.End();
+		std::cout << "Execution Time : " << m_region.Seconds() * 1e3 << "ms" << std::endl;
+	}
+	// Elapsed so far, for rate reports inside the timed scope
+	double Seconds() const
+	{
+		return m_region.Seconds();
 	}
 private:
-	std::chrono::high_resolution_clock::time_point m_start, m_end;
-	std::chrono::duration<float> m_duration;
-};
+	static const char* Calibrated(const char* name)
+	{
+		RegionTracer::NsPerTick();
+		return name;
+	}
 
+	TraceRegion m_region;
+};